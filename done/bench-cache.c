@@ -0,0 +1,174 @@
+/**
+ * @file bench-cache.c
+ * @brief lookup throughput of the caches: scalar vs. vectorized way match
+ *        on the SoA tag blocks, and cache_hit() on both storage layouts.
+ *
+ * @date 2019
+ */
+
+#include "error.h"
+#include "cache_mng.h"
+#include "way_match.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define DEFAULT_LOOKUPS 20000000u
+
+// ======================================================================
+static double now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// ======================================================================
+static void report(const char* what, size_t lookups, size_t hits, double seconds)
+{
+    printf("%-28s %8.1f Mlookups/s  (%5.1f%% hits)\n", what,
+           lookups / seconds * 1e-6, 100.0 * hits / lookups);
+}
+
+// ======================================================================
+// Fills a cache with one line out of two of the address pool
+static int fill(void* cache, const cache_config_t* config, const uint32_t* pool, size_t pool_size)
+{
+    word_t buffer[(sizeof(cache_entry_t) + CACHE_MAX_LINE_SIZE) / sizeof(word_t)];
+    cache_entry_t* entry = (cache_entry_t*) buffer;
+    memset(buffer, 0, sizeof(buffer));
+    entry->v = 1;
+
+    uint8_t* next_way = calloc(config->lines, 1);
+    if (next_way == NULL) return ERR_MEM;
+    int err = ERR_NONE;
+    for (size_t i = 0; i < pool_size && err == ERR_NONE; i += 2) {
+        uint16_t line = (pool[i] >> config->line_bits) & (config->lines - 1u);
+        if (next_way[line] < config->ways) {
+            entry->tag = pool[i] >> config->tag_remaining_bits;
+            err = cache_insert(line, next_way[line]++, entry, cache, config);
+        }
+    }
+    free(next_way);
+    return err;
+}
+
+// ======================================================================
+// Way match of the build (WAY_MATCH_KERNEL), or scalar only
+static int find_way(const uint32_t* tags, const uint8_t* valids, uint8_t ways, uint32_t tag, int simd)
+{
+    uint8_t i = 0;
+#if WAY_MATCH_SIMD
+    if (simd) {
+        int way = way_match(tags, valids, ways, tag, &i);
+        if (way != -1) return way;
+    }
+#else
+    (void) simd;
+#endif
+    for (; i < ways; ++i) {
+        if (tags[i] == tag && valids[i]) return i;
+    }
+    return -1;
+}
+
+// ======================================================================
+static void bench_kernel(const char* what, const void* cache, const cache_config_t* config,
+                         const uint32_t* addrs, size_t lookups, int simd)
+{
+    size_t hits = 0;
+    double start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        uint32_t addr = addrs[i];
+        uint16_t line = (addr >> config->line_bits) & (config->lines - 1u);
+        uint32_t tag = addr >> config->tag_remaining_bits;
+        hits += (find_way(cache_soa_tags(cache, config, line), cache_soa_valids(cache, config, line),
+                          config->ways, tag, simd) != -1);
+    }
+    report(what, lookups, hits, now() - start);
+}
+
+// ======================================================================
+static void bench_cache_hit(const char* what, void* cache, const cache_config_t* config,
+                            const uint32_t* addrs, size_t lookups)
+{
+    size_t hits = 0;
+    const uint32_t* p_line;
+    uint8_t hit_way;
+    uint16_t hit_index;
+    double start = now();
+    for (size_t i = 0; i < lookups; ++i) {
+        phy_addr_t paddr = { .phy_page_num = addrs[i] >> PAGE_OFFSET,
+                             .page_offset = addrs[i] & (PAGE_SIZE - 1) };
+        cache_hit(NULL, cache, &paddr, &p_line, &hit_way, &hit_index, config, LRU);
+        hits += (hit_way != HIT_WAY_MISS);
+    }
+    report(what, lookups, hits, now() - start);
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    size_t lookups = argc > 1 ? strtoul(argv[1], NULL, 10) : DEFAULT_LOOKUPS;
+    unsigned int lines = argc > 2 ? strtoul(argv[2], NULL, 10) : L2_CACHE_LINES;
+    unsigned int ways = argc > 3 ? strtoul(argv[3], NULL, 10) : L2_CACHE_WAYS;
+    if (lookups == 0) {
+        fprintf(stderr, "usage: %s [lookups [lines [ways]]]\n", argv[0]);
+        return 1;
+    }
+
+    cache_config_t aos, soa;
+    if (cache_config_init(&aos, (uint16_t) lines, (uint8_t) ways, L2_CACHE_LINE, sizeof(word_t)) != ERR_NONE) {
+        fprintf(stderr, "invalid geometry %u lines x %u ways\n", lines, ways);
+        return 1;
+    }
+    soa = aos;
+    if (cache_config_set_layout(&soa, CACHE_LAYOUT_SOA) != ERR_NONE) {
+        fprintf(stderr, "invalid SoA geometry %u lines x %u ways\n", lines, ways);
+        return 1;
+    }
+
+    // twice as many distinct lines as the cache can hold
+    size_t pool_size = 2u * lines * ways;
+    uint32_t* pool = calloc(pool_size, sizeof(uint32_t));
+    uint32_t* addrs = calloc(lookups, sizeof(uint32_t));
+    void* aos_cache = NULL;
+    void* soa_cache = NULL;
+    int err = (pool == NULL || addrs == NULL) ? ERR_MEM : ERR_NONE;
+    if (err == ERR_NONE) {
+        srand(0x1c7);
+        for (size_t i = 0; i < pool_size; ++i) {
+            pool[i] = ((uint32_t) rand() << 4) & 0x0FFFFFF0u;
+        }
+        for (size_t i = 0; i < lookups; ++i) {
+            addrs[i] = pool[(size_t) rand() % pool_size];
+        }
+        err = cache_alloc(&aos_cache, &aos);
+    }
+    if (err == ERR_NONE) err = cache_alloc(&soa_cache, &soa);
+    if (err == ERR_NONE) err = fill(aos_cache, &aos, pool, pool_size);
+    if (err == ERR_NONE) err = fill(soa_cache, &soa, pool, pool_size);
+    if (err != ERR_NONE) {
+        fprintf(stderr, "cannot set the caches up: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+        free(aos_cache);
+        free(soa_cache);
+        free(pool);
+        free(addrs);
+        return 1;
+    }
+
+    printf("%u lines x %u ways, %zu lookups, way match kernel: %s\n",
+           lines, ways, lookups, WAY_MATCH_KERNEL);
+    bench_kernel("way match (scalar)", soa_cache, &soa, addrs, lookups, 0);
+    bench_kernel("way match (" WAY_MATCH_KERNEL ")", soa_cache, &soa, addrs, lookups, 1);
+    bench_cache_hit("cache_hit (aos)", aos_cache, &aos, addrs, lookups);
+    bench_cache_hit("cache_hit (soa)", soa_cache, &soa, addrs, lookups);
+
+    free(aos_cache);
+    free(soa_cache);
+    free(pool);
+    free(addrs);
+    return 0;
+}
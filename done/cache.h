@@ -10,6 +10,8 @@
 
 #include "addr.h" // for word_t
 #include <stdint.h>
+#include <stddef.h> // for size_t
+#include <string.h> // for memcpy()
 
 #define L1_ICACHE_WORDS_PER_LINE 4
 #define L1_ICACHE_LINE   16u // 16 bytes (4 words) per line
@@ -32,7 +34,17 @@
 #define L2_CACHE_TAG_REMAINING_BITS   13 // 2(select byte) + 2(select word) + 9(select line)
 #define L2_CACHE_TAG_BITS             19 // 32 - L1_ICACHE_TAG_REMAINING_BITS
 
+#define L3_CACHE_WORDS_PER_LINE L1_ICACHE_WORDS_PER_LINE
+#define L3_CACHE_LINE   L1_ICACHE_LINE
+#define L3_CACHE_WAYS   16u
+#define L3_CACHE_LINES  4096u
+#define L3_CACHE_TAG_REMAINING_BITS   16 // 2(select byte) + 2(select word) + 12(select line)
+#define L3_CACHE_TAG_BITS             16 // 32 - L3_CACHE_TAG_REMAINING_BITS
+
 /**
+ * Default (i7) geometry, see cache_config_default().
+ * Any other geometry can be described at runtime with cache_config_init().
+ *
  * L1 ICACHE, L1 DCACHE:
  *  - byte addressing
  *  - physically addressed
@@ -53,6 +65,15 @@
  *  - write-through policy (no dirty bit)
  *  - write-allocate on write miss
  *
+ * L3 CACHE (optional, see cache_attach_lower()):
+ *  - byte addressing
+ *  - physically addressed
+ *  - 16-way set-associative
+ *  - 4 words/way, where word = 4 bytes (=> 128 bits/way)
+ *  - 4096 sets (= 12 bits to index)
+ *  - total capacity = 1MiB
+ *  - sits between the L2 misses and memory
+ *
  *  Exclusive policy (https://en.wikipedia.org/wiki/Cache_inclusion_policy)
  *      Consider the case when L2 is exclusive of L1. Suppose there is a
  *      processor read request for block X. If the block is found in L1 cache,
@@ -69,43 +90,306 @@
 
 
 // --------------------------------------------------
-#define cache_cast(TYPE) ((TYPE *)cache)
+/**
+ * Limits of a runtime cache geometry (see cache_config_init()).
+ * CACHE_MAX_WAYS stays below HIT_WAY_MISS and CACHE_MAX_LINES below
+ * HIT_INDEX_MISS so that both sentinels remain unambiguous.
+ */
+#define CACHE_MAX_WAYS       128u
+#define CACHE_MAX_LINES      32768u
+#define CACHE_MAX_LINE_SIZE  128u
+#define CACHE_MAX_WORDS_PER_LINE (CACHE_MAX_LINE_SIZE / sizeof(word_t))
+#define CACHE_MIN_SECTOR_SIZE 8u // no command (see COMMAND_MAX_SIZE) spans more than two sectors
+#define CACHE_MAX_SECTORS     8u // one valid bit per sector in the valid byte of an entry
+
+typedef enum {L1_ICACHE, L1_DCACHE, L2_CACHE, L3_CACHE} cache_t;
+
+/**
+ * @brief Storage layout of a cache.
+ *
+ *  - CACHE_LAYOUT_AOS: one cache_entry_t (header + line) per way, the ways
+ *    of a set being contiguous;
+ *  - CACHE_LAYOUT_SOA: per set, a small tag block holding the tags, then
+ *    the valid bits, then the ages, then the dirty bits of all its ways
+ *    (so that a lookup only touches one host cache line for up to 9 ways);
+ *    the line payloads are stored apart, after all the tag blocks.
+ *
+ * Both layouts end with one 64-bit word of replacement state per set,
+ * then one byte per set holding its most recently used way (the way
+ * probed first by a lookup, see cache_way_hint()), followed by a
+ * cache_state_t.
+ *
+ * AoS is the default. SoA only makes the scan of a set cheaper, while
+ * fills and evictions touch its tag block and the line payload apart;
+ * and since the MRU way is probed first, most hits scan no set at all.
+ * cache_hit() on random addresses (bench-cache) is within about 15% either
+ * way depending on the build and host, and whole runs of test-cache take
+ * the same time with both layouts.
+ */
+typedef enum {CACHE_LAYOUT_AOS, CACHE_LAYOUT_SOA} cache_layout_t;
+
+/**
+ * @brief Inclusion policy of a cache with respect to the caches above it.
+ *
+ *  - CACHE_EXCLUSIVE: victim cache, see above (default);
+ *  - CACHE_INCLUSIVE: holds a copy of every line of the caches above;
+ *    lines filled from memory go in both levels, and a line dropped from
+ *    this cache is invalidated above it (back-invalidation);
+ *  - CACHE_NINE: non-inclusive non-exclusive; lines filled from memory go
+ *    in both levels, but each level evicts independently.
+ */
+typedef enum {CACHE_EXCLUSIVE, CACHE_INCLUSIVE, CACHE_NINE} cache_inclusion_t;
+
+#define CACHE_HOST_LINE 64u // host cache line size, for the SoA tag blocks
+
+/**
+ * @brief Runtime description of a cache geometry.
+ *
+ * The first four fields are given by the user, the remaining ones are
+ * derived from them by cache_config_init() and must not be set by hand.
+ * The layout is AoS unless changed with cache_config_set_layout().
+ *
+ * In tag-only mode (see cache_config_set_tag_only()), entries hold no
+ * line payload (payload_size is 0): only tags and replacement metadata
+ * are simulated, reads return 0 and no data is moved to or from memory.
+ *
+ * Caches are write-through unless write_back is set (see
+ * cache_config_set_write_back()).
+ *
+ * A sectored cache (see cache_config_set_sector_size()) allocates whole
+ * lines but fills, and tracks the validity of, each sector on its own:
+ * the valid byte of an entry is then a mask of its valid sectors (bit i
+ * for the sector i), a line being present as soon as one is valid. A
+ * cache that is not sectored has a single sector, the whole line.
+ */
+typedef struct {
+    uint16_t lines;          // number of sets (power of 2)
+    uint8_t  ways;           // associativity
+    uint8_t  line_size;      // bytes per line (power of 2)
+    uint8_t  word_size;      // bytes per word
+
+    uint8_t  words_per_line;
+    uint8_t  word_bits;      // log2(word_size)
+    uint8_t  line_bits;      // log2(line_size)
+    uint8_t  index_bits;     // log2(lines)
+    uint8_t  tag_remaining_bits; // line_bits + index_bits
+    uint8_t  tag_only;       // no line payloads
+    uint8_t  payload_size;   // bytes of payload per entry: line_size, 0 if tag_only
+    uint8_t  write_back;     // write-back (with dirty bits) instead of write-through
+    uint8_t  sector_size;    // bytes per sector: line_size unless sectored
+    uint8_t  sectors;        // sectors (valid bits) per line, 1 if not sectored
+    uint8_t  sector_bits;    // log2(sector_size)
+    cache_inclusion_t inclusion; // with respect to the upper caches
+    size_t   entry_size;     // bytes of one entry in the exchange (AoS) format
+
+    cache_layout_t layout;
+    size_t   set_size;       // SoA: bytes of the tag block of one set
+    size_t   data_offset;    // SoA: offset of the first line payload
+    size_t   meta_offset;    // offset of the per-set replacement state
+    size_t   hint_offset;    // offset of the per-set MRU way hints
+    size_t   state_offset;   // offset of the cache-wide state
+} cache_config_t;
+
+/**
+ * @brief Access statistics of one cache level.
+ */
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t sector_misses;  // misses on a present line whose sector is not valid
+    uint64_t mru_hits;       // hits on the way predicted by the MRU hint of the set
+    uint64_t evictions;      // valid lines replaced by an insertion
+    uint64_t promotions;     // lines moved from this (L2, L3) cache up
+    uint64_t victim_inserts; // victims of the level above inserted into this (L2, L3) cache
+    uint64_t fills;          // lines filled from memory into this cache
+    uint64_t invalidations;  // lines invalidated by the inclusion policy
+    uint64_t writebacks;     // dirty lines written back to memory
+    uint64_t mem_read_bytes; // memory traffic caused by this cache
+    uint64_t mem_write_bytes;
+} cache_stats_t;
+
+#define CACHE_MAX_UPPER 16u // caches that can be attached above another one
+
+/**
+ * @brief Cache-wide state, stored at the end of the cache storage.
+ */
+typedef struct {
+    cache_stats_t stats;
+    // caches attached above this one (inclusive back-invalidation)
+    void* upper[CACHE_MAX_UPPER];
+    const cache_config_t* upper_config[CACHE_MAX_UPPER];
+    uint8_t  nb_upper;
+    // cache attached below this one (L2 below L1, L3 below L2), NULL for memory
+    void* lower;
+    const cache_config_t* lower_config;
+    uint8_t  lower_replace; // replacement policy of the lower cache (cache_replace_t)
+    uint16_t psel;        // DRRIP policy selector (set dueling)
+    uint8_t  brrip_tick;  // BRRIP: counts insertions, to insert long once in a while
+    void* classifier;     // miss_class_t observing the accesses, NULL for none
+    void* heat;           // heat_level_t counting the events per set, NULL for none
+} cache_state_t;
+
+/**
+ * @brief One way of a cache line. The line payload has
+ * config->words_per_line words, hence the flexible array member:
+ * entries are config->entry_size bytes apart in memory.
+ * This is both the AoS storage format and the format exchanged through
+ * cache_entry_init() and cache_insert() whatever the layout.
+ */
+typedef struct {
+    uint8_t  v;    // valid sectors (1 if the cache is not sectored)
+    uint8_t  age;  // used for LRU (RRPV for RRIP policies)
+    uint8_t  d;    // dirty, write-back caches only
+    uint32_t tag;
+    word_t   line[];
+} cache_entry_t;
 
 // --------------------------------------------------
-#define cache_entry(TYPE, WAYS, LINE_INDEX, WAY) \
-        (cache_cast(TYPE) + (LINE_INDEX) * (WAYS) + (WAY))
+// AoS layout only
+#define cache_entry(CACHE, CONFIG, LINE_INDEX, WAY) \
+        ((cache_entry_t *)((byte_t *)(CACHE) + \
+            ((size_t)(LINE_INDEX) * (CONFIG)->ways + (WAY)) * (CONFIG)->entry_size))
 
 // --------------------------------------------------
-#define cache_valid(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->v
+// SoA layout only
+#define cache_soa_tags(CACHE, CONFIG, LINE_INDEX) \
+        ((uint32_t *)((byte_t *)(CACHE) + (size_t)(LINE_INDEX) * (CONFIG)->set_size))
+
+#define cache_soa_valids(CACHE, CONFIG, LINE_INDEX) \
+        ((uint8_t *)(cache_soa_tags(CACHE, CONFIG, LINE_INDEX) + (CONFIG)->ways))
+
+#define cache_soa_ages(CACHE, CONFIG, LINE_INDEX) \
+        (cache_soa_valids(CACHE, CONFIG, LINE_INDEX) + (CONFIG)->ways)
+
+#define cache_soa_dirties(CACHE, CONFIG, LINE_INDEX) \
+        (cache_soa_ages(CACHE, CONFIG, LINE_INDEX) + (CONFIG)->ways)
+
+#define cache_soa_line(CACHE, CONFIG, LINE_INDEX, WAY) \
+        ((word_t *)((byte_t *)(CACHE) + (CONFIG)->data_offset + \
+            ((size_t)(LINE_INDEX) * (CONFIG)->ways + (WAY)) * (CONFIG)->payload_size))
 
 // --------------------------------------------------
-#define cache_age(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->age
+// Any layout: per-set replacement state (PLRU bits)
+#define cache_set_meta(CACHE, CONFIG, LINE_INDEX) \
+        (((uint64_t *)((byte_t *)(CACHE) + (CONFIG)->meta_offset))[LINE_INDEX])
 
 // --------------------------------------------------
-#define cache_tag(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->tag
+// Any layout: per-set MRU way hint
+#define cache_set_hint(CACHE, CONFIG, LINE_INDEX) \
+        (((uint8_t *)((byte_t *)(CACHE) + (CONFIG)->hint_offset))[LINE_INDEX])
 
 // --------------------------------------------------
-#define cache_line(TYPE, WAYS, LINE_INDEX, WAY) \
-        cache_entry(TYPE, WAYS, LINE_INDEX, WAY)->line
- 
- 
-typedef enum {L1_ICACHE, L1_DCACHE, L2_CACHE} cache_t;
- 
-typedef struct {
-	 uint8_t v : 1;
-	 uint8_t age: 3; 
-	 uint32_t tag: L2_CACHE_TAG_BITS;
-	 word_t line[L2_CACHE_WORDS_PER_LINE];
-} l2_cache_entry_t;
- 
-typedef struct {
-	 uint8_t v: 1;
-	 uint8_t age: 2; //used for LRU
-	 uint32_t tag: L1_ICACHE_TAG_BITS;
-	 word_t line[L1_ICACHE_WORDS_PER_LINE];
-} l1_icache_entry_t;
- 
-typedef l1_icache_entry_t l1_dcache_entry_t;
+// Any layout: cache-wide state
+#define cache_state(CACHE, CONFIG) \
+        ((cache_state_t *)((byte_t *)(CACHE) + (CONFIG)->state_offset))
+
+// --------------------------------------------------
+// Any layout, given apart from the geometry: a constant layout folds the
+// accessors into plain address computations (see cache_kernels.h)
+static inline uint8_t* cache_valid_ptr_as(const void* cache, const cache_config_t* config,
+                                          cache_layout_t layout, uint16_t line_index, uint8_t way) {
+    return layout == CACHE_LAYOUT_SOA
+           ? cache_soa_valids(cache, config, line_index) + way
+           : &cache_entry(cache, config, line_index, way)->v;
+}
+
+static inline uint8_t* cache_age_ptr_as(const void* cache, const cache_config_t* config,
+                                        cache_layout_t layout, uint16_t line_index, uint8_t way) {
+    return layout == CACHE_LAYOUT_SOA
+           ? cache_soa_ages(cache, config, line_index) + way
+           : &cache_entry(cache, config, line_index, way)->age;
+}
+
+static inline uint8_t* cache_dirty_ptr_as(const void* cache, const cache_config_t* config,
+                                          cache_layout_t layout, uint16_t line_index, uint8_t way) {
+    return layout == CACHE_LAYOUT_SOA
+           ? cache_soa_dirties(cache, config, line_index) + way
+           : &cache_entry(cache, config, line_index, way)->d;
+}
+
+static inline uint32_t* cache_tag_ptr_as(const void* cache, const cache_config_t* config,
+                                         cache_layout_t layout, uint16_t line_index, uint8_t way) {
+    return layout == CACHE_LAYOUT_SOA
+           ? cache_soa_tags(cache, config, line_index) + way
+           : &cache_entry(cache, config, line_index, way)->tag;
+}
+
+static inline word_t* cache_line_ptr_as(const void* cache, const cache_config_t* config,
+                                        cache_layout_t layout, uint16_t line_index, uint8_t way) {
+    return layout == CACHE_LAYOUT_SOA
+           ? cache_soa_line(cache, config, line_index, way)
+           : cache_entry(cache, config, line_index, way)->line;
+}
+
+// --------------------------------------------------
+// Any layout
+static inline uint8_t* cache_valid_ptr(const void* cache, const cache_config_t* config,
+                                       uint16_t line_index, uint8_t way) {
+    return cache_valid_ptr_as(cache, config, config->layout, line_index, way);
+}
+
+static inline uint8_t* cache_age_ptr(const void* cache, const cache_config_t* config,
+                                     uint16_t line_index, uint8_t way) {
+    return cache_age_ptr_as(cache, config, config->layout, line_index, way);
+}
+
+static inline uint8_t* cache_dirty_ptr(const void* cache, const cache_config_t* config,
+                                       uint16_t line_index, uint8_t way) {
+    return cache_dirty_ptr_as(cache, config, config->layout, line_index, way);
+}
+
+static inline uint32_t* cache_tag_ptr(const void* cache, const cache_config_t* config,
+                                      uint16_t line_index, uint8_t way) {
+    return cache_tag_ptr_as(cache, config, config->layout, line_index, way);
+}
+
+static inline word_t* cache_line_ptr(const void* cache, const cache_config_t* config,
+                                     uint16_t line_index, uint8_t way) {
+    return cache_line_ptr_as(cache, config, config->layout, line_index, way);
+}
+
+// --------------------------------------------------
+#define cache_valid(CACHE, CONFIG, LINE_INDEX, WAY) \
+        (*cache_valid_ptr(CACHE, CONFIG, LINE_INDEX, WAY))
+
+// --------------------------------------------------
+#define cache_age(CACHE, CONFIG, LINE_INDEX, WAY) \
+        (*cache_age_ptr(CACHE, CONFIG, LINE_INDEX, WAY))
+
+// --------------------------------------------------
+#define cache_dirty(CACHE, CONFIG, LINE_INDEX, WAY) \
+        (*cache_dirty_ptr(CACHE, CONFIG, LINE_INDEX, WAY))
+
+// --------------------------------------------------
+#define cache_tag(CACHE, CONFIG, LINE_INDEX, WAY) \
+        (*cache_tag_ptr(CACHE, CONFIG, LINE_INDEX, WAY))
+
+// --------------------------------------------------
+#define cache_line(CACHE, CONFIG, LINE_INDEX, WAY) \
+        cache_line_ptr(CACHE, CONFIG, LINE_INDEX, WAY)
+
+// --------------------------------------------------
+// Sectors (a single one, the whole line, if the cache is not sectored)
+static inline uint8_t cache_sector_bit(const cache_config_t* config, uint32_t phy_addr) {
+    return (uint8_t) (1u << ((phy_addr >> config->sector_bits) & (config->sectors - 1u)));
+}
+
+static inline uint8_t cache_all_sectors(const cache_config_t* config) {
+    return (uint8_t) ((1u << config->sectors) - 1u);
+}
+
+// Copies the given sectors of a line payload
+static inline void cache_copy_sectors(const cache_config_t* config, word_t* to, const word_t* from,
+                                      uint8_t sectors) {
+    if (sectors == cache_all_sectors(config)) {
+        memcpy(to, from, config->payload_size);
+        return;
+    }
+    if (config->payload_size == 0) return;
+    for (uint8_t i = 0; i < config->sectors; ++i) {
+        if (sectors & (1u << i)) {
+            size_t offset = (size_t) i * config->sector_size;
+            memcpy((byte_t*) to + offset, (const byte_t*) from + offset, config->sector_size);
+        }
+    }
+}
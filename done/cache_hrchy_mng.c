@@ -0,0 +1,638 @@
+/**
+ * @file cache_hrchy_mng.c
+ * @brief whole memory hierarchy (TLBs, L1, L2 and optional L3 caches) and batch
+ *        execution of programs through it
+ *
+ * @date 2019
+ */
+
+#include "cache_hrchy_mng.h"
+#include "tlb_hrchy_mng.h"
+#include "addr_mng.h"
+#include "page_walk.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h> // for memcpy
+#include <math.h> // for sqrt
+#include <inttypes.h> // for PRIu64
+
+#define SAMPLE_HASH 0x9E3779B1u // odd: a bijection on the L1 set indexes
+#define SAMPLE_Z    1.96        // 95% confidence
+
+// Without memory space (tag-only mode), virtual addresses are used as
+// physical ones, truncated to PHY_ADDR bits
+static inline void identity_translate(const virt_addr_t* vaddr, phy_addr_t* paddr) {
+    paddr->phy_page_num = (uint32_t) (virt_addr_t_to_virtual_page_number(vaddr) & ((UINT32_C(1) << PHY_PAGE_NUM) - 1));
+    paddr->page_offset = vaddr->page_offset;
+}
+
+int cache_hrchy_init(cache_hrchy_t * hrchy,
+                     void * mem_space,
+                     const cache_config_t * l1_config,
+                     const cache_config_t * l2_config,
+                     cache_replace_t replace) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(l1_config);
+    M_REQUIRE_NON_NULL(l2_config);
+    M_REQUIRE(mem_space != NULL || (l1_config->tag_only && l2_config->tag_only), ERR_BAD_PARAMETER,
+              "%s", "a memory space is required unless both cache levels are tag-only");
+    M_REQUIRE(l1_config->line_size == l2_config->line_size, ERR_BAD_PARAMETER, "%s", "L1 and L2 line sizes differ");
+    M_REQUIRE(l1_config->sector_size == l2_config->sector_size, ERR_BAD_PARAMETER, "%s", "L1 and L2 sector sizes differ");
+    M_REQUIRE(l1_config->write_back == l2_config->write_back, ERR_BAD_PARAMETER, "%s", "L1 and L2 write policies differ");
+    M_REQUIRE(cache_replace_supported(l1_config, replace) && cache_replace_supported(l2_config, replace),
+              ERR_POLICY, "%d: replacement policy not supported by the caches", replace);
+
+    zero_init_ptr(hrchy);
+    hrchy->mem_space = mem_space;
+    hrchy->l1_config = *l1_config;
+    hrchy->l2_config = *l2_config;
+    hrchy->replace = replace;
+
+    int err = cache_alloc(&hrchy->l1_icache, &hrchy->l1_config);
+    if (err == ERR_NONE) err = cache_alloc(&hrchy->l1_dcache, &hrchy->l1_config);
+    if (err == ERR_NONE) err = cache_alloc(&hrchy->l2_cache, &hrchy->l2_config);
+    if (err == ERR_NONE) err = cache_attach_upper(hrchy->l2_cache, &hrchy->l2_config, hrchy->l1_icache, &hrchy->l1_config);
+    if (err == ERR_NONE) err = cache_attach_upper(hrchy->l2_cache, &hrchy->l2_config, hrchy->l1_dcache, &hrchy->l1_config);
+    if (err == ERR_NONE) err = cache_attach_lower(hrchy->l1_icache, &hrchy->l1_config, hrchy->l2_cache, &hrchy->l2_config, replace);
+    if (err == ERR_NONE) err = cache_attach_lower(hrchy->l1_dcache, &hrchy->l1_config, hrchy->l2_cache, &hrchy->l2_config, replace);
+    if (err == ERR_NONE) err = tlb_flush(hrchy->l1_itlb, L1_ITLB);
+    if (err == ERR_NONE) err = tlb_flush(hrchy->l1_dtlb, L1_DTLB);
+    if (err == ERR_NONE) err = tlb_flush(hrchy->l2_tlb, L2_TLB);
+    if (err != ERR_NONE) cache_hrchy_free(hrchy);
+    return err;
+}
+
+// Links L2 to the L3 cache of the hierarchy
+static int link_l3(cache_hrchy_t* hrchy) {
+    M_EXIT_IF_ERR_NOMSG(cache_attach_lower(hrchy->l2_cache, &hrchy->l2_config,
+                                           hrchy->l3_cache, &hrchy->l3_config, hrchy->l3_replace));
+    return cache_attach_upper(hrchy->l3_cache, &hrchy->l3_config, hrchy->l2_cache, &hrchy->l2_config);
+}
+
+int cache_hrchy_add_l3(cache_hrchy_t * hrchy, const cache_config_t * l3_config, cache_replace_t l3_replace) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(l3_config);
+    M_REQUIRE(hrchy->l3_cache == NULL, ERR_BAD_PARAMETER, "%s", "the hierarchy already has an L3 cache");
+    M_REQUIRE(hrchy->sample_units == NULL || l3_config->lines >= hrchy->l1_config.lines, ERR_BAD_PARAMETER,
+              "%s", "set sampling requires at least as many L3 sets as L1 sets");
+
+    hrchy->l3_config = *l3_config;
+    hrchy->l3_replace = l3_replace;
+    M_EXIT_IF_ERR_NOMSG(cache_alloc(&hrchy->l3_cache, &hrchy->l3_config));
+
+    int err = link_l3(hrchy);
+    if (err != ERR_NONE) {
+        free(hrchy->l3_cache);
+        hrchy->l3_cache = NULL;
+    }
+    return err;
+}
+
+int cache_hrchy_share_l3(cache_hrchy_t * hrchy, void * l3_cache,
+                         const cache_config_t * l3_config, cache_replace_t l3_replace) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(l3_cache);
+    M_REQUIRE_NON_NULL(l3_config);
+    M_REQUIRE(hrchy->l3_cache == NULL, ERR_BAD_PARAMETER, "%s", "the hierarchy already has an L3 cache");
+    M_REQUIRE(hrchy->sample_units == NULL || l3_config->lines >= hrchy->l1_config.lines, ERR_BAD_PARAMETER,
+              "%s", "set sampling requires at least as many L3 sets as L1 sets");
+
+    hrchy->l3_config = *l3_config;
+    hrchy->l3_replace = l3_replace;
+    hrchy->l3_cache = l3_cache;
+    hrchy->l3_shared = 1;
+
+    int err = link_l3(hrchy);
+    if (err != ERR_NONE) {
+        hrchy->l3_cache = NULL;
+        hrchy->l3_shared = 0;
+    }
+    return err;
+}
+
+int cache_hrchy_free(cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(hrchy);
+
+    free(hrchy->l1_icache);
+    free(hrchy->l1_dcache);
+    free(hrchy->l2_cache);
+    if (!hrchy->l3_shared) free(hrchy->l3_cache);
+    free(hrchy->sample_units);
+    if (hrchy->classifiers != NULL) {
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            miss_class_free(&hrchy->classifiers[level]);
+        }
+        free(hrchy->classifiers);
+    }
+    hrchy->classifiers = NULL;
+    if (hrchy->heat != NULL) heat_map_free(hrchy->heat);
+    free(hrchy->heat);
+    hrchy->heat = NULL;
+    hrchy->l1_icache = hrchy->l1_dcache = hrchy->l2_cache = hrchy->l3_cache = NULL;
+    hrchy->sample_units = NULL;
+
+    return ERR_NONE;
+}
+
+int cache_hrchy_set_prefetcher(cache_hrchy_t * hrchy, prefetcher_t * prefetcher) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(prefetcher == NULL || (UINT32_C(1) << prefetcher->line_bits) == hrchy->l1_config.line_size,
+              ERR_BAD_PARAMETER, "%s", "prefetcher line size differs from the caches one");
+    M_REQUIRE(prefetcher == NULL || hrchy->sample_units == NULL, ERR_BAD_PARAMETER, "%s",
+              "prefetching would touch sets that are not sampled");
+
+    hrchy->prefetcher = prefetcher;
+    return ERR_NONE;
+}
+
+int cache_hrchy_classify_misses(cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(hrchy->classifiers == NULL, ERR_BAD_PARAMETER, "%s", "misses already classified");
+
+    void* caches[CACHE_HRCHY_LEVELS] = { hrchy->l1_icache, hrchy->l1_dcache, hrchy->l2_cache,
+                                         hrchy->l3_shared ? NULL : hrchy->l3_cache };
+    const cache_config_t* configs[CACHE_HRCHY_LEVELS] = { &hrchy->l1_config, &hrchy->l1_config,
+                                                          &hrchy->l2_config, &hrchy->l3_config };
+    M_EXIT_IF_NULL(hrchy->classifiers = calloc(CACHE_HRCHY_LEVELS, sizeof(miss_class_t)),
+                   CACHE_HRCHY_LEVELS * sizeof(miss_class_t));
+
+    int err = ERR_NONE;
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS && err == ERR_NONE; ++level) {
+        if (caches[level] == NULL) continue;
+        err = miss_class_init(&hrchy->classifiers[level], configs[level]->line_size,
+                              (uint32_t) configs[level]->lines * configs[level]->ways);
+        if (err == ERR_NONE) err = cache_set_classifier(caches[level], configs[level], &hrchy->classifiers[level]);
+    }
+    if (err != ERR_NONE) {
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            if (caches[level] != NULL) (void) cache_set_classifier(caches[level], configs[level], NULL);
+            miss_class_free(&hrchy->classifiers[level]);
+        }
+        free(hrchy->classifiers);
+        hrchy->classifiers = NULL;
+    }
+    return err;
+}
+
+int cache_hrchy_heat_map(cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(hrchy->heat == NULL, ERR_BAD_PARAMETER, "%s", "heat maps already enabled");
+    M_REQUIRE(hrchy->sample_units == NULL, ERR_BAD_PARAMETER, "%s", "heat maps would miss the sets not sampled");
+
+    void* caches[CACHE_HRCHY_LEVELS] = { hrchy->l1_icache, hrchy->l1_dcache, hrchy->l2_cache,
+                                         hrchy->l3_shared ? NULL : hrchy->l3_cache };
+    const cache_config_t* configs[CACHE_HRCHY_LEVELS] = { &hrchy->l1_config, &hrchy->l1_config,
+                                                          &hrchy->l2_config, &hrchy->l3_config };
+    uint32_t nb_sets[HEAT_LEVELS];
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+        nb_sets[level] = caches[level] == NULL ? 0 : configs[level]->lines;
+    }
+    M_EXIT_IF_NULL(hrchy->heat = malloc(sizeof(heat_map_t)), sizeof(heat_map_t));
+    int err = heat_map_init(hrchy->heat, nb_sets);
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS && err == ERR_NONE; ++level) {
+        if (caches[level] != NULL) err = cache_set_heat(caches[level], configs[level], &hrchy->heat->levels[level]);
+    }
+    if (err != ERR_NONE) {
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            if (caches[level] != NULL) (void) cache_set_heat(caches[level], configs[level], NULL);
+        }
+        heat_map_free(hrchy->heat);
+        free(hrchy->heat);
+        hrchy->heat = NULL;
+    }
+    return err;
+}
+
+int cache_hrchy_set_sampling(cache_hrchy_t * hrchy, uint8_t sample_bits) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(hrchy->l1_config.tag_only, ERR_BAD_PARAMETER, "%s", "set sampling requires tag-only caches");
+    M_REQUIRE(hrchy->prefetcher == NULL, ERR_BAD_PARAMETER, "%s",
+              "prefetching would touch sets that are not sampled");
+    M_REQUIRE(hrchy->heat == NULL, ERR_BAD_PARAMETER, "%s", "heat maps would miss the sets not sampled");
+    M_REQUIRE(sample_bits <= hrchy->l1_config.index_bits, ERR_BAD_PARAMETER,
+              "%u: sampling ratio larger than the number of L1 sets", sample_bits);
+    M_REQUIRE(hrchy->l2_config.lines >= hrchy->l1_config.lines
+              && (hrchy->l3_cache == NULL || hrchy->l3_config.lines >= hrchy->l1_config.lines),
+              ERR_BAD_PARAMETER, "%s", "set sampling requires at least as many L2 (L3) sets as L1 sets");
+
+    free(hrchy->sample_units);
+    hrchy->sample_bits = sample_bits;
+    hrchy->sample_skipped = 0;
+    M_EXIT_IF_NULL(hrchy->sample_units = calloc(hrchy->l1_config.lines, sizeof(sample_unit_t)),
+                   hrchy->l1_config.lines * sizeof(sample_unit_t));
+    return ERR_NONE;
+}
+
+// Whether an L1 set is sampled: exactly 1 in 2^sample_bits sets are, as
+// the hash is a bijection on the set indexes
+static inline int sampled_set(const cache_hrchy_t* hrchy, uint32_t set) {
+    uint32_t hash = (set * SAMPLE_HASH) & (hrchy->l1_config.lines - 1u);
+    return (hash >> (hrchy->l1_config.index_bits - hrchy->sample_bits)) == 0;
+}
+
+// Statistics of the levels an access may go through, NULL for the others
+static void sample_stats(const cache_hrchy_t* hrchy, size_t l1_level, const cache_stats_t* stats[]) {
+    void* caches[CACHE_HRCHY_LEVELS] = { hrchy->l1_icache, hrchy->l1_dcache, hrchy->l2_cache, hrchy->l3_cache };
+    const cache_config_t* configs[CACHE_HRCHY_LEVELS] = { &hrchy->l1_config, &hrchy->l1_config,
+                                                          &hrchy->l2_config, &hrchy->l3_config };
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+        stats[level] = (caches[level] == NULL || (level < 2 && level != l1_level))
+                       ? NULL : &cache_state(caches[level], configs[level])->stats;
+    }
+}
+
+// Executes an access if its L1 set is sampled, accounting what it caused
+// at each level to that set
+static int sampled_access(cache_hrchy_t* hrchy, const command_t* command, phy_addr_t* paddr) {
+    uint32_t phy_addr = ((uint32_t) paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset;
+    uint32_t set = (phy_addr >> hrchy->l1_config.line_bits) & (hrchy->l1_config.lines - 1u);
+    if (!sampled_set(hrchy, set)) {
+        ++hrchy->sample_skipped;
+        return ERR_NONE;
+    }
+
+    // The counters of the set first take away the ones of the caches, then
+    // add them back once the access is done: only the deltas remain
+    const cache_stats_t* stats[CACHE_HRCHY_LEVELS];
+    sample_stats(hrchy, (command->type == INSTRUCTION) ? 0 : 1, stats);
+    sample_unit_t* unit = &hrchy->sample_units[set];
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+        if (stats[level] == NULL) continue;
+        unit->accesses[level] -= stats[level]->hits + stats[level]->misses;
+        unit->misses[level] -= stats[level]->misses;
+    }
+    int err = cache_hrchy_access_phy(hrchy, command, paddr);
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+        if (stats[level] == NULL) continue;
+        unit->accesses[level] += stats[level]->hits + stats[level]->misses;
+        unit->misses[level] += stats[level]->misses;
+    }
+    return err;
+}
+
+// Whether the line of an address is in the prefetch target level or above it
+static int prefetch_hit(const cache_hrchy_t* hrchy, const phy_addr_t* paddr, int* hit) {
+    M_EXIT_IF_ERR_NOMSG(cache_probe(hrchy->l1_dcache, &hrchy->l1_config, paddr, hit));
+    if (!*hit && hrchy->prefetcher->target == PREFETCH_TO_L2) {
+        M_EXIT_IF_ERR_NOMSG(cache_probe(hrchy->l2_cache, &hrchy->l2_config, paddr, hit));
+    }
+    return ERR_NONE;
+}
+
+// Trains the prefetcher with a data access, then issues its prefetches
+static int prefetch(cache_hrchy_t* hrchy, const phy_addr_t* paddr, int hit) {
+    prefetcher_t* pf = hrchy->prefetcher;
+    uint32_t candidates[PREFETCH_MAX_DEGREE];
+    uint8_t nb = 0;
+    uint32_t phy_addr = ((uint32_t) paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset;
+    M_EXIT_IF_ERR_NOMSG(prefetch_observe(pf, phy_addr, hit, candidates, &nb));
+
+    for (uint8_t i = 0; i < nb; ++i) {
+        phy_addr_t line_paddr;
+        M_EXIT_IF_ERR_NOMSG(init_phy_addr(&line_paddr, candidates[i] & ~(uint32_t) (PAGE_SIZE - 1),
+                                          candidates[i] & (PAGE_SIZE - 1)));
+        int issued = 0;
+        M_EXIT_IF_ERR_NOMSG(cache_prefetch(hrchy->mem_space, &line_paddr, hrchy->l1_dcache, &hrchy->l1_config,
+                                           hrchy->l2_cache, &hrchy->l2_config, pf->target == PREFETCH_TO_L2,
+                                           hrchy->replace, &issued));
+        if (issued) M_EXIT_IF_ERR_NOMSG(prefetch_issued(pf, candidates[i]));
+    }
+    return ERR_NONE;
+}
+
+// Read or write of one command through the caches, once translated
+static int access_caches(cache_hrchy_t* hrchy, const command_t* command, phy_addr_t* paddr) {
+    void* l1_cache = (command->type == INSTRUCTION) ? hrchy->l1_icache : hrchy->l1_dcache;
+    if (command->order == READ) {
+        uint64_t data;
+        return cache_read_bytes(hrchy->mem_space, paddr, command->type, l1_cache, &hrchy->l1_config,
+                                hrchy->l2_cache, &hrchy->l2_config, &data, command->data_size, hrchy->replace);
+    }
+
+    M_REQUIRE(command->order == WRITE, ERR_BAD_PARAMETER, "%d: unknown command order", command->order);
+    return cache_write_bytes(hrchy->mem_space, paddr, hrchy->l1_dcache, &hrchy->l1_config,
+                             hrchy->l2_cache, &hrchy->l2_config, &command->write_data, command->data_size,
+                             hrchy->replace);
+}
+
+int cache_hrchy_translate(cache_hrchy_t * hrchy, const command_t * command, phy_addr_t * paddr) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE_NON_NULL(paddr);
+
+    if (hrchy->mem_space == NULL) {
+        identity_translate(&command->vaddr, paddr);
+        return ERR_NONE;
+    }
+
+    int hit = 0;
+    M_EXIT_IF_ERR_NOMSG(tlb_search(hrchy->mem_space, &command->vaddr, paddr, command->type,
+                                   hrchy->l1_itlb, hrchy->l1_dtlb, hrchy->l2_tlb, &hit));
+    if (hit) ++hrchy->tlb_hits;
+    else     ++hrchy->tlb_misses;
+    return ERR_NONE;
+}
+
+int cache_hrchy_split(const cache_hrchy_t * hrchy, const command_t * command, const phy_addr_t * paddr,
+                      command_t parts[2], phy_addr_t paddrs[2], uint8_t * nb) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(parts);
+    M_REQUIRE_NON_NULL(paddrs);
+    M_REQUIRE_NON_NULL(nb);
+    M_REQUIRE(command->data_size >= 1 && command->data_size <= COMMAND_MAX_SIZE, ERR_BAD_PARAMETER,
+              "%zu: data size out of range", command->data_size);
+
+    parts[0] = *command;
+    paddrs[0] = *paddr;
+    *nb = 1;
+    size_t offset = paddr->page_offset & (hrchy->l1_config.line_size - 1u);
+    if (offset + command->data_size <= hrchy->l1_config.line_size) return ERR_NONE;
+
+    // page and line offsets of the virtual and physical addresses are the same
+    size_t first = hrchy->l1_config.line_size - offset;
+    parts[0].data_size = first;
+    parts[1] = *command;
+    parts[1].data_size = command->data_size - first;
+    parts[1].write_data = command->write_data >> (8 * first);
+    parts[1].vaddr.page_offset = (uint16_t) (command->vaddr.page_offset + first);
+    paddrs[1] = *paddr;
+    paddrs[1].page_offset = (uint16_t) (paddr->page_offset + first);
+    *nb = 2;
+    return ERR_NONE;
+}
+
+int cache_hrchy_access_phy(cache_hrchy_t * hrchy, const command_t * command, phy_addr_t * paddr) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE_NON_NULL(paddr);
+
+    if (hrchy->prefetcher == NULL || command->type != DATA) {
+        return access_caches(hrchy, command, paddr);
+    }
+
+    int hit = 0;
+    M_EXIT_IF_ERR_NOMSG(prefetch_hit(hrchy, paddr, &hit));
+    M_EXIT_IF_ERR_NOMSG(access_caches(hrchy, command, paddr));
+    return prefetch(hrchy, paddr, hit);
+}
+
+int cache_hrchy_access(cache_hrchy_t * hrchy, const command_t * command) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(command);
+
+    if (hrchy->heat != NULL) {
+        M_EXIT_IF_ERR_NOMSG(heat_map_page(hrchy->heat, virt_addr_t_to_virtual_page_number(&command->vaddr)));
+    }
+    phy_addr_t paddr;
+    M_EXIT_IF_ERR_NOMSG(cache_hrchy_translate(hrchy, command, &paddr));
+    if (hrchy->sample_units != NULL) {
+        // each line is sampled on its own
+        command_t parts[2];
+        phy_addr_t paddrs[2];
+        uint8_t nb = 0;
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_split(hrchy, command, &paddr, parts, paddrs, &nb));
+        for (uint8_t i = 0; i < nb; ++i) M_EXIT_IF_ERR_NOMSG(sampled_access(hrchy, &parts[i], &paddrs[i]));
+        return ERR_NONE;
+    }
+    return cache_hrchy_access_phy(hrchy, command, &paddr);
+}
+
+int cache_hrchy_run(cache_hrchy_t * hrchy, const program_t * program, FILE * dump) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(program);
+
+    for_all_lines(line, program) {
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_access(hrchy, line));
+    }
+
+    if (dump != NULL) {
+        return cache_hrchy_dump(dump, hrchy);
+    }
+    return ERR_NONE;
+}
+
+// Caches of a hierarchy, and their geometries, in the cache_hrchy_stats_t order
+static void hrchy_caches(const cache_hrchy_t* hrchy, void* caches[], const cache_config_t* configs[]) {
+    caches[0] = hrchy->l1_icache;
+    caches[1] = hrchy->l1_dcache;
+    caches[2] = hrchy->l2_cache;
+    caches[3] = hrchy->l3_shared ? NULL : hrchy->l3_cache;
+    configs[0] = configs[1] = &hrchy->l1_config;
+    configs[2] = &hrchy->l2_config;
+    configs[3] = &hrchy->l3_config;
+}
+
+int cache_hrchy_enable_stats(cache_hrchy_t * hrchy, int enabled) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE(enabled || hrchy->sample_units == NULL, ERR_BAD_PARAMETER, "%s",
+              "the statistics of the sampled sets cannot be disabled");
+    if ((enabled != 0) == !hrchy->stats_disabled) return ERR_NONE;
+
+    void* caches[CACHE_HRCHY_LEVELS];
+    const cache_config_t* configs[CACHE_HRCHY_LEVELS];
+    hrchy_caches(hrchy, caches, configs);
+    cache_hrchy_stats_t* saved = &hrchy->saved_stats;
+    if (!enabled) {
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            if (caches[level] != NULL) M_EXIT_IF_ERR_NOMSG(cache_stats_get(caches[level], configs[level], &saved->caches[level]));
+            if (hrchy->classifiers != NULL) saved->classes[level] = hrchy->classifiers[level].stats;
+        }
+        saved->tlb_hits = hrchy->tlb_hits;
+        saved->tlb_misses = hrchy->tlb_misses;
+        if (hrchy->prefetcher != NULL) saved->prefetch = hrchy->prefetcher->stats;
+    } else {
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            if (caches[level] != NULL) {
+                M_EXIT_IF_ERR_NOMSG(cache_stats_reset(caches[level], configs[level]));
+                M_EXIT_IF_ERR_NOMSG(cache_stats_add(caches[level], configs[level], &saved->caches[level]));
+            }
+            if (hrchy->classifiers != NULL) hrchy->classifiers[level].stats = saved->classes[level];
+        }
+        hrchy->tlb_hits = saved->tlb_hits;
+        hrchy->tlb_misses = saved->tlb_misses;
+        if (hrchy->prefetcher != NULL) hrchy->prefetcher->stats = saved->prefetch;
+    }
+    if (hrchy->heat != NULL) hrchy->heat->paused = !enabled;
+    hrchy->stats_disabled = !enabled;
+    return ERR_NONE;
+}
+
+int cache_hrchy_fast_forward(cache_hrchy_t * hrchy, const program_t * program, size_t from, size_t to) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(from <= to && to <= program->nb_lines, ERR_BAD_PARAMETER, "%s", "commands out of the program");
+
+    if (hrchy->mem_space == NULL || hrchy->l1_config.tag_only) return ERR_NONE;
+
+    // the snoops from the lowest level reach all the copies of a line
+    void* lowest = hrchy->l3_cache != NULL ? hrchy->l3_cache : hrchy->l2_cache;
+    const cache_config_t* lowest_config = hrchy->l3_cache != NULL ? &hrchy->l3_config : &hrchy->l2_config;
+    for (size_t i = from; i < to; ++i) {
+        const command_t* command = &program->listing[i];
+        if (command->order != WRITE) continue;
+        phy_addr_t paddr;
+        M_EXIT_IF_ERR_NOMSG(page_walk(hrchy->mem_space, &command->vaddr, &paddr));
+
+        // only the lines written lose their copies (written back first if
+        // dirty, as the write may not cover them): the others stay warm
+        phy_addr_t last = paddr;
+        last.page_offset = (uint16_t) (paddr.page_offset + command->data_size - 1u);
+        int found = 0, dirty = 0;
+        M_EXIT_IF_ERR_NOMSG(cache_snoop(hrchy->mem_space, lowest, lowest_config, &paddr, 1, &found, &dirty));
+        if ((last.page_offset ^ paddr.page_offset) >> lowest_config->line_bits) {
+            M_EXIT_IF_ERR_NOMSG(cache_snoop(hrchy->mem_space, lowest, lowest_config, &last, 1, &found, &dirty));
+        }
+
+        byte_t* target = (byte_t*) hrchy->mem_space + (((uint32_t) paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset);
+        memcpy(target, &command->write_data, command->data_size);
+    }
+    return ERR_NONE;
+}
+
+int cache_hrchy_run_range(cache_hrchy_t * hrchy, const program_t * program, size_t from, size_t to,
+                          size_t warmup, int fast_forward) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(from <= to && to <= program->nb_lines, ERR_BAD_PARAMETER, "%s", "commands out of the program");
+
+    int err = ERR_NONE;
+    for (size_t i = from; i < to && err == ERR_NONE; ) {
+        size_t begin = 0, end = 0;
+        int roi = program_roi(program, i, &begin, &end);
+        if (end > to) end = to;
+        if (roi && i - begin < warmup && end - begin > warmup) end = begin + warmup;
+        int measured = roi && i - begin >= warmup;
+
+        err = cache_hrchy_enable_stats(hrchy, measured);
+        if (err == ERR_NONE && !roi && fast_forward) {
+            err = cache_hrchy_fast_forward(hrchy, program, i, end);
+        } else {
+            for (; i < end && err == ERR_NONE; ++i) err = cache_hrchy_access(hrchy, &program->listing[i]);
+        }
+        i = end;
+    }
+
+    int enabled = cache_hrchy_enable_stats(hrchy, 1);
+    return err != ERR_NONE ? err : enabled;
+}
+
+int cache_hrchy_clean(cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(hrchy);
+
+    // lower levels first: an L1 copy is more recent than an L2 one
+    if (hrchy->l3_cache != NULL && !hrchy->l3_shared) {
+        M_EXIT_IF_ERR_NOMSG(cache_clean(hrchy->mem_space, hrchy->l3_cache, &hrchy->l3_config));
+    }
+    M_EXIT_IF_ERR_NOMSG(cache_clean(hrchy->mem_space, hrchy->l2_cache, &hrchy->l2_config));
+    M_EXIT_IF_ERR_NOMSG(cache_clean(hrchy->mem_space, hrchy->l1_icache, &hrchy->l1_config));
+    M_EXIT_IF_ERR_NOMSG(cache_clean(hrchy->mem_space, hrchy->l1_dcache, &hrchy->l1_config));
+
+    return ERR_NONE;
+}
+
+int cache_hrchy_dump(FILE * output, const cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(hrchy);
+
+    fputs("L1_ICACHE: \n\n", output);
+    M_EXIT_IF_ERR_NOMSG(cache_dump(output, hrchy->l1_icache, &hrchy->l1_config));
+    fputs("L1_DCACHE: \n\n", output);
+    M_EXIT_IF_ERR_NOMSG(cache_dump(output, hrchy->l1_dcache, &hrchy->l1_config));
+    fputs("L2_CACHE: \n\n", output);
+    M_EXIT_IF_ERR_NOMSG(cache_dump(output, hrchy->l2_cache, &hrchy->l2_config));
+    if (hrchy->l3_cache != NULL && !hrchy->l3_shared) {
+        fputs("L3_CACHE: \n\n", output);
+        M_EXIT_IF_ERR_NOMSG(cache_dump(output, hrchy->l3_cache, &hrchy->l3_config));
+    }
+
+    return ERR_NONE;
+}
+
+/**
+ * @brief Prints the extrapolation of the statistics of the sampled sets to
+ *        all the sets. The miss rate is a ratio estimator over the sampled
+ *        L1 sets (cluster sampling without replacement); its confidence
+ *        interval is from the variance of the misses of the sets around it.
+ * @return error code
+ */
+static int print_sampling(FILE* output, const cache_hrchy_t* hrchy) {
+    static const char* const names[CACHE_HRCHY_LEVELS] = { "L1_ICACHE", "L1_DCACHE", "L2_CACHE", "L3_CACHE" };
+    uint32_t nb_sets = hrchy->l1_config.lines;
+    uint32_t n = nb_sets >> hrchy->sample_bits;
+    double f = (double) n / (double) nb_sets;
+
+    uint64_t simulated = 0;
+    for (uint32_t set = 0; set < nb_sets; ++set) {
+        simulated += hrchy->sample_units[set].accesses[0] + hrchy->sample_units[set].accesses[1];
+    }
+    fprintf(output, "%-9s: 1 in %u L1 sets (%" PRIu32 " of %" PRIu32 "), accesses simulated: %" PRIu64
+            ", skipped: %" PRIu64 "\n", "SAMPLING", 1u << hrchy->sample_bits, n, nb_sets,
+            simulated, hrchy->sample_skipped);
+
+    for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+        if (level == 3 && hrchy->l3_cache == NULL) continue;
+        uint64_t accesses = 0, misses = 0;
+        for (uint32_t set = 0; set < nb_sets; ++set) {
+            if (!sampled_set(hrchy, set)) continue;
+            accesses += hrchy->sample_units[set].accesses[level];
+            misses += hrchy->sample_units[set].misses[level];
+        }
+        double rate = accesses == 0 ? 0.0 : (double) misses / (double) accesses;
+
+        double deviation = 0.0;
+        for (uint32_t set = 0; set < nb_sets; ++set) {
+            if (!sampled_set(hrchy, set)) continue;
+            double d = (double) hrchy->sample_units[set].misses[level]
+                       - rate * (double) hrchy->sample_units[set].accesses[level];
+            deviation += d * d;
+        }
+        fprintf(output, "%-9s: estimated accesses: %.0f, misses: %.0f, miss rate: %.2f%%", names[level],
+                (double) accesses / f, (double) misses / f, 100.0 * rate);
+        if (n < 2 || accesses == 0) {
+            fputs(" +/- n/a\n", output);
+        } else {
+            double mean = (double) accesses / (double) n;
+            double variance = (1.0 - f) * deviation / (double) (n - 1) / ((double) n * mean * mean);
+            fprintf(output, " +/- %.2f%% (95%%)\n", 100.0 * SAMPLE_Z * sqrt(variance));
+        }
+    }
+    return ERR_NONE;
+}
+
+int cache_hrchy_print_stats(FILE * output, const cache_hrchy_t * hrchy) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(hrchy);
+
+    cache_stats_t stats;
+    fprintf(output, "%-9s: hits: %" PRIu64 ", misses: %" PRIu64 "\n", "TLB",
+            hrchy->tlb_hits, hrchy->tlb_misses);
+    M_EXIT_IF_ERR_NOMSG(cache_stats_get(hrchy->l1_icache, &hrchy->l1_config, &stats));
+    M_EXIT_IF_ERR_NOMSG(cache_stats_print(output, "L1_ICACHE", &stats));
+    M_EXIT_IF_ERR_NOMSG(cache_stats_get(hrchy->l1_dcache, &hrchy->l1_config, &stats));
+    M_EXIT_IF_ERR_NOMSG(cache_stats_print(output, "L1_DCACHE", &stats));
+    M_EXIT_IF_ERR_NOMSG(cache_stats_get(hrchy->l2_cache, &hrchy->l2_config, &stats));
+    M_EXIT_IF_ERR_NOMSG(cache_stats_print(output, "L2_CACHE", &stats));
+    if (hrchy->l3_cache != NULL && !hrchy->l3_shared) {
+        M_EXIT_IF_ERR_NOMSG(cache_stats_get(hrchy->l3_cache, &hrchy->l3_config, &stats));
+        M_EXIT_IF_ERR_NOMSG(cache_stats_print(output, "L3_CACHE", &stats));
+    }
+    if (hrchy->prefetcher != NULL) {
+        M_EXIT_IF_ERR_NOMSG(prefetch_stats_print(output, hrchy->prefetcher));
+    }
+    if (hrchy->classifiers != NULL) {
+        static const char* const names[CACHE_HRCHY_LEVELS] = { "L1I_3C", "L1D_3C", "L2_3C", "L3_3C" };
+        for (size_t level = 0; level < CACHE_HRCHY_LEVELS; ++level) {
+            if (hrchy->classifiers[level].nodes == NULL) continue;
+            M_EXIT_IF_ERR_NOMSG(miss_class_print(output, names[level], &hrchy->classifiers[level]));
+        }
+    }
+    if (hrchy->sample_units != NULL) {
+        M_EXIT_IF_ERR_NOMSG(print_sampling(output, hrchy));
+    }
+
+    return ERR_NONE;
+}
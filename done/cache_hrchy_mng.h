@@ -0,0 +1,314 @@
+#pragma once
+
+/**
+ * @file cache_hrchy_mng.h
+ * @brief whole memory hierarchy (TLBs, L1, L2 and optional L3 caches) and batch
+ *        execution of programs through it
+ *
+ * @date 2019
+ */
+
+#include "cache_mng.h"
+#include "commands.h"
+#include "prefetch_mng.h"
+#include "tlb_hrchy.h"
+
+#include <stdio.h> // for FILE
+
+#define CACHE_HRCHY_LEVELS 4u // L1I, L1D, L2 and L3, in this order in sample_unit_t
+
+/**
+ * Set sampling: accesses and misses caused at each level by the accesses
+ * to one sampled L1 set (see cache_hrchy_set_sampling()).
+ */
+typedef struct {
+    uint64_t accesses[CACHE_HRCHY_LEVELS];
+    uint64_t misses[CACHE_HRCHY_LEVELS];
+} sample_unit_t;
+
+/**
+ * All the statistics of a hierarchy, kept aside while they are disabled
+ * (see cache_hrchy_enable_stats()).
+ */
+typedef struct {
+    cache_stats_t caches[CACHE_HRCHY_LEVELS];
+    miss_class_stats_t classes[CACHE_HRCHY_LEVELS];
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    prefetch_stats_t prefetch;
+} cache_hrchy_stats_t;
+
+/**
+ * The TLB hierarchy, both L1 caches, the L2 cache and an optional L3 cache,
+ * together with the memory they translate and cache.
+ */
+typedef struct {
+    void* mem_space;
+    cache_config_t l1_config; // both L1 caches
+    cache_config_t l2_config;
+    cache_replace_t replace;
+    void* l1_icache;
+    void* l1_dcache;
+    void* l2_cache;
+    cache_config_t l3_config;
+    cache_replace_t l3_replace;
+    void* l3_cache;           // NULL without L3
+    uint8_t l3_shared;        // L3 owned by someone else (see cache_hrchy_share_l3())
+    l1_itlb_entry_t l1_itlb[L1_ITLB_LINES];
+    l1_dtlb_entry_t l1_dtlb[L1_DTLB_LINES];
+    l2_tlb_entry_t l2_tlb[L2_TLB_LINES];
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    prefetcher_t* prefetcher; // on the data accesses; NULL for none
+    uint8_t sample_bits;      // 1 in 2^sample_bits L1 sets is simulated
+    uint64_t sample_skipped;  // accesses to the other sets
+    sample_unit_t* sample_units; // per L1 set; NULL without sampling
+    miss_class_t* classifiers;   // L1I, L1D, L2, L3; NULL without 3C classification
+    heat_map_t* heat;            // NULL without heat maps
+    uint8_t stats_disabled;           // see cache_hrchy_enable_stats()
+    cache_hrchy_stats_t saved_stats;  // the statistics when they were disabled
+} cache_hrchy_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for cache_hrchy_t: allocates the caches and
+ *        flushes all caches and TLBs. The caches refer to the geometries
+ *        stored in the hierarchy, so it must not be moved once initialized.
+ * @param hrchy (modified) the hierarchy to initialize
+ * @param mem_space the memory space (kept, not copied); may be NULL if both
+ *        geometries are tag-only, virtual addresses are then used as physical ones
+ * @param l1_config the geometry of both L1 caches
+ * @param l2_config the geometry of the L2 cache
+ * @param replace the replacement policy of the caches
+ * @return error code
+ */
+int cache_hrchy_init(cache_hrchy_t * hrchy,
+                     void * mem_space,
+                     const cache_config_t * l1_config,
+                     const cache_config_t * l2_config,
+                     cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Adds an L3 cache below the L2 cache of a hierarchy, before any access.
+ * @param hrchy the hierarchy (without L3 yet)
+ * @param l3_config the geometry of the L3 cache (its inclusion policy
+ *        being with respect to L2); same line size, tag-only mode and
+ *        write policy as L2
+ * @param l3_replace the replacement policy of the L3 cache
+ * @return error code
+ */
+int cache_hrchy_add_l3(cache_hrchy_t * hrchy, const cache_config_t * l3_config, cache_replace_t l3_replace);
+
+//=========================================================================
+/**
+ * @brief Links the L2 cache of a hierarchy to an L3 cache shared with
+ *        other hierarchies (cores), before any access. The L3 cache is not
+ *        freed by cache_hrchy_free() nor printed by cache_hrchy_dump() and
+ *        cache_hrchy_print_stats().
+ * @param hrchy the hierarchy (without L3 yet)
+ * @param l3_cache the shared L3 cache
+ * @param l3_config its geometry, see cache_hrchy_add_l3()
+ * @param l3_replace its replacement policy
+ * @return error code
+ */
+int cache_hrchy_share_l3(cache_hrchy_t * hrchy, void * l3_cache,
+                         const cache_config_t * l3_config, cache_replace_t l3_replace);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for cache_hrchy_t: frees the caches (not the memory).
+ * @param hrchy the hierarchy
+ * @return error code
+ */
+int cache_hrchy_free(cache_hrchy_t * hrchy);
+
+//=========================================================================
+/**
+ * @brief Attaches a data prefetcher to the hierarchy (NULL to detach it).
+ *        It is trained by the data accesses and fills L1D or L2.
+ * @param hrchy the hierarchy
+ * @param prefetcher the prefetcher (kept, not copied), initialized for
+ *        the line size of the hierarchy
+ * @return error code
+ */
+int cache_hrchy_set_prefetcher(cache_hrchy_t * hrchy, prefetcher_t * prefetcher);
+
+//=========================================================================
+/**
+ * @brief Enables the 3C classification of the misses of each cache, before
+ *        any access (and after cache_hrchy_add_l3(), if any; a shared L3
+ *        is not classified). cache_hrchy_print_stats() then prints it.
+ * @param hrchy the hierarchy
+ * @return error code
+ */
+int cache_hrchy_classify_misses(cache_hrchy_t * hrchy);
+
+//=========================================================================
+/**
+ * @brief Enables the heat maps of the hits, misses and evictions per
+ *        virtual page and per set of each cache (but a shared L3), see
+ *        heat_map_mng.h; they are then in hrchy->heat.
+ * @param hrchy the hierarchy, without set sampling
+ * @return error code
+ */
+int cache_hrchy_heat_map(cache_hrchy_t * hrchy);
+
+//=========================================================================
+/**
+ * @brief Enables set sampling, before any access: only the accesses to
+ *        1 in 2^sample_bits L1 sets, chosen by hashing the set index, go
+ *        through the caches; the others are dropped once translated.
+ *        Each L2 (L3) set only holds lines of one L1 set, so the sampled
+ *        sets are the same at all the levels. cache_hrchy_print_stats()
+ *        then extrapolates the statistics of the sampled sets, with
+ *        confidence intervals.
+ * @param hrchy the hierarchy, tag-only and without prefetcher (the data
+ *        of the dropped accesses is not kept), whose L2 (L3) has at least
+ *        as many sets as L1: ERR_BAD_PARAMETER otherwise, also from a
+ *        later cache_hrchy_add_l3() or cache_hrchy_share_l3()
+ * @param sample_bits log2 of the sampling ratio, at most the L1 index bits
+ * @return error code
+ */
+int cache_hrchy_set_sampling(cache_hrchy_t * hrchy, uint8_t sample_bits);
+
+//=========================================================================
+/**
+ * @brief Translates the address of a command through the TLBs.
+ * @param hrchy the hierarchy
+ * @param command the command
+ * @param paddr (modified) the physical address
+ * @return error code
+ */
+int cache_hrchy_translate(cache_hrchy_t * hrchy, const command_t * command, phy_addr_t * paddr);
+
+//=========================================================================
+/**
+ * @brief Splits a command at the line boundary it crosses, if any, into
+ *        the accesses to each line (whose sizes need not be powers of 2).
+ *        cache_hrchy_access_phy() executes a crossing command as its two
+ *        parts in a row; the split lets a caller that works line by line
+ *        (set sampling, shards, coherence) handle each part on its own.
+ * @param hrchy the hierarchy
+ * @param command the command
+ * @param paddr its physical address, see cache_hrchy_translate()
+ * @param parts (modified) the parts, in address order
+ * @param paddrs (modified) their physical addresses
+ * @param nb (modified) the number of parts, 1 or 2
+ * @return error code
+ */
+int cache_hrchy_split(const cache_hrchy_t * hrchy, const command_t * command, const phy_addr_t * paddr,
+                      command_t parts[2], phy_addr_t paddrs[2], uint8_t * nb);
+
+//=========================================================================
+/**
+ * @brief Executes one command on an already translated address: read or
+ *        write through the caches.
+ * @param hrchy the hierarchy
+ * @param command the command
+ * @param paddr its physical address, see cache_hrchy_translate()
+ * @return error code
+ */
+int cache_hrchy_access_phy(cache_hrchy_t * hrchy, const command_t * command, phy_addr_t * paddr);
+
+//=========================================================================
+/**
+ * @brief Executes one command: translation through the TLBs, then
+ *        read or write through the caches (unless its set is not sampled).
+ * @param hrchy the hierarchy
+ * @param command the command to execute
+ * @return error code
+ */
+int cache_hrchy_access(cache_hrchy_t * hrchy, const command_t * command);
+
+//=========================================================================
+/**
+ * @brief Executes all the commands of a program.
+ * @param hrchy the hierarchy
+ * @param program the program to execute
+ * @param dump where to dump the caches once at the end (NULL for no dump)
+ * @return error code
+ */
+int cache_hrchy_run(cache_hrchy_t * hrchy, const program_t * program, FILE * dump);
+
+//=========================================================================
+/**
+ * @brief Enables or disables the statistics of a hierarchy (of the TLBs,
+ *        caches, prefetcher, 3C classification and heat maps). While they are
+ *        disabled, the accesses still update the TLBs, the caches and the
+ *        prefetcher, which warms them up, but not their statistics: these
+ *        are set back, when enabled again, to what they were when disabled.
+ * @param hrchy the hierarchy, without set sampling
+ * @param enabled whether to enable the statistics
+ * @return error code
+ */
+int cache_hrchy_enable_stats(cache_hrchy_t * hrchy, int enabled);
+
+//=========================================================================
+/**
+ * @brief Executes commands of a program functionally only: their writes
+ *        go straight to memory, through page walks, bypassing the TLBs and
+ *        caches. Unless the caches are tag-only (their writes never reach
+ *        memory, which fast-forwarding then leaves untouched), the copies
+ *        of the lines written are written back if dirty and invalidated at
+ *        all levels, so that the caches cannot hold stale data; the other
+ *        lines stay in the caches, which stay warm.
+ * @param hrchy the hierarchy
+ * @param program the program
+ * @param from the first command to execute
+ * @param to one past the last command to execute
+ * @return error code
+ */
+int cache_hrchy_fast_forward(cache_hrchy_t * hrchy, const program_t * program, size_t from, size_t to);
+
+//=========================================================================
+/**
+ * @brief Executes the commands [from, to) of a program, with statistics
+ *        only in its regions of interest (see program_roi()) and past
+ *        the first warmup commands of each; the statistics are enabled
+ *        again on return.
+ * @param hrchy the hierarchy
+ * @param program the program
+ * @param from the first command to execute
+ * @param to one past the last command to execute
+ * @param warmup the number of commands that start each region of interest
+ *        and only warm the hierarchy up
+ * @param fast_forward whether the commands out of the regions of interest
+ *        are only executed functionally (see cache_hrchy_fast_forward()),
+ *        each region then starting with the caches the previous ones left;
+ *        otherwise they warm the hierarchy up too
+ * @return error code
+ */
+int cache_hrchy_run_range(cache_hrchy_t * hrchy, const program_t * program, size_t from, size_t to,
+                          size_t warmup, int fast_forward);
+
+//=========================================================================
+/**
+ * @brief Writes the dirty lines of all the caches (but a shared L3) back
+ *        to memory (write-back caches only, see cache_clean()).
+ * @param hrchy the hierarchy
+ * @return error code
+ */
+int cache_hrchy_clean(cache_hrchy_t * hrchy);
+
+//=========================================================================
+/**
+ * @brief Dumps the caches of the hierarchy.
+ * @param output the stream to print to
+ * @param hrchy the hierarchy
+ * @return error code
+ */
+int cache_hrchy_dump(FILE * output, const cache_hrchy_t * hrchy);
+
+//=========================================================================
+/**
+ * @brief Prints the statistics of the TLBs, of the caches and of
+ *        the prefetcher (if any), the 3C classification of the misses
+ *        (if enabled); with set sampling, the statistics of the
+ *        caches are those of the sampled sets, followed by their
+ *        extrapolation to all the sets.
+ * @param output the stream to print to
+ * @param hrchy the hierarchy
+ * @return error code
+ */
+int cache_hrchy_print_stats(FILE * output, const cache_hrchy_t * hrchy);
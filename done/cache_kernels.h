@@ -0,0 +1,305 @@
+#pragma once
+
+/**
+ * @file cache_kernels.h
+ * @brief per-set kernels of the caches (lookup, insertion), specialized
+ *        for each storage layout and replacement policy.
+ *
+ * The kernels are written once below, with the layout and the policy as
+ * parameters, and instantiated by CACHE_KERNELS_LAYOUT() for each pair of
+ * them as compile-time constants: the layout accessors and the policy
+ * switches fold away, leaving straight-line code for each kind of cache.
+ * The instances are bound through two constant tables, indexed by the
+ * layout (and the policy) of a cache: cache_layout_kernels() and
+ * cache_kernels() are a single table load, without any branch.
+ *
+ * The kernels do not check their arguments: the public functions of
+ * cache_mng.h do, once per call, before using them.
+ *
+ * Only to be included by cache_mng.c.
+ *
+ * @date 2019
+ */
+
+#include "cache.h"
+#include "cache_mng.h"
+#include "lru.h"
+#include "way_match.h"
+
+#include <string.h> // for memcpy()
+
+#if defined(__GNUC__)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+#define NB_LAYOUTS  2 // CACHE_LAYOUT_AOS, CACHE_LAYOUT_SOA
+#define NB_POLICIES 6 // LRU ... DRRIP
+
+//=========================================================================
+// Generic kernels
+
+// First valid way holding tag, -1 if none
+KERNEL_INLINE int kernel_find(const void* cache, const cache_config_t* config, cache_layout_t layout,
+                              uint16_t line_index, uint32_t tag) {
+    if (layout == CACHE_LAYOUT_SOA) {
+        const uint32_t* tags = cache_soa_tags(cache, config, line_index);
+        const uint8_t* valids = cache_soa_valids(cache, config, line_index);
+        uint8_t i = 0;
+#if WAY_MATCH_SIMD
+        int way = way_match(tags, valids, config->ways, tag, &i);
+        if (way != -1) return way;
+#endif
+        // scalar fallback, and the ways left over by the vector kernel
+        for (; i < config->ways; ++i) {
+            if (tags[i] == tag && valids[i]) return i;
+        }
+        return -1;
+    }
+    foreach_way(i, config->ways) {
+        const cache_entry_t* entry = cache_entry(cache, config, line_index, i);
+        if (entry->v && entry->tag == tag) return i;
+    }
+    return -1;
+}
+
+// First invalid way, -1 if the set is full
+KERNEL_INLINE int kernel_empty(const void* cache, const cache_config_t* config, cache_layout_t layout,
+                               uint16_t line_index) {
+    if (layout == CACHE_LAYOUT_SOA) {
+        const uint8_t* valids = cache_soa_valids(cache, config, line_index);
+        uint8_t i = 0;
+#if WAY_MATCH_SIMD
+        int way = way_empty(valids, config->ways, &i);
+        if (way != -1) return way;
+#endif
+        for (; i < config->ways; ++i) {
+            if (!valids[i]) return i;
+        }
+        return -1;
+    }
+    foreach_way(i, config->ways) {
+        if (!cache_entry(cache, config, line_index, i)->v) return i;
+    }
+    return -1;
+}
+
+// Replacement state update of an access to a way (cold_start: the way was empty)
+KERNEL_INLINE void kernel_touch(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                uint16_t line_index, uint8_t way, int cold_start, cache_replace_t replace) {
+    switch (replace) {
+    case LRU:
+        if (cold_start) lru_age_increase(cache, config, layout, line_index, way);
+        else            lru_age_update(cache, config, layout, line_index, way);
+        break;
+    case PLRU_TREE:
+        plru_tree_touch(&cache_set_meta(cache, config, line_index), config->ways, way);
+        break;
+    case PLRU_BIT:
+        plru_bit_touch(&cache_set_meta(cache, config, line_index), config->ways, way);
+        break;
+    case SRRIP:
+    case BRRIP:
+    case DRRIP:
+        *cache_age_ptr_as(cache, config, layout, line_index, way) = 0;
+        break;
+    }
+}
+
+// Way to replace in a full set
+KERNEL_INLINE uint8_t kernel_victim(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                    uint16_t line_index, cache_replace_t replace) {
+    switch (replace) {
+    case PLRU_TREE:
+        return plru_tree_victim(cache_set_meta(cache, config, line_index), config->ways);
+    case PLRU_BIT:
+        return plru_bit_victim(cache_set_meta(cache, config, line_index), config->ways);
+    case SRRIP:
+    case BRRIP:
+    case DRRIP:
+        return rrip_victim(cache, config, layout, line_index);
+    default:
+        return lru_victim(cache, config, layout, line_index);
+    }
+}
+
+#define KERNEL_SECTOR_MISS (-2) // lookup: the line is present, not the sector
+
+// Looks the sector of tag up in a set, probing its MRU way first and scanning
+// all the ways only if that one misses; updates the replacement state and the
+// hint on hit. Returns the way, -1 on miss, KERNEL_SECTOR_MISS if only the
+// sector misses; *predicted tells whether the MRU way hit.
+KERNEL_INLINE int kernel_lookup(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                uint16_t line_index, uint32_t tag, uint8_t sector,
+                                cache_replace_t replace, int* predicted) {
+    uint8_t* hint = &cache_set_hint(cache, config, line_index);
+    *predicted = (*cache_valid_ptr_as(cache, config, layout, line_index, *hint) & sector)
+                 && *cache_tag_ptr_as(cache, config, layout, line_index, *hint) == tag;
+    int way = *predicted ? *hint : kernel_find(cache, config, layout, line_index, tag);
+    if (way != -1 && (*cache_valid_ptr_as(cache, config, layout, line_index, (uint8_t) way) & sector)) {
+        *hint = (uint8_t) way;
+        kernel_touch(cache, config, layout, line_index, (uint8_t) way, 0, replace);
+        return way;
+    }
+    if (replace == DRRIP) rrip_miss(cache, config, line_index);
+    return way == -1 ? -1 : KERNEL_SECTOR_MISS;
+}
+
+// Places the valid sectors of a line in a set, in an empty way if any, in
+// the victim way otherwise (copied out first); returns 1 if a valid entry
+// was evicted. In a sectored cache, the sectors of a line already present
+// are merged into it, its own sectors being kept as the most recent ones.
+KERNEL_INLINE int kernel_insert(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                uint16_t line_index, uint32_t tag, const word_t* line, uint8_t valid,
+                                uint8_t dirty, cache_replace_t replace, uint8_t* p_way,
+                                uint32_t* victim_tag, word_t* victim_line, uint8_t* victim_valid,
+                                uint8_t* victim_dirty) {
+    int present = config->sectors > 1 ? kernel_find(cache, config, layout, line_index, tag) : -1;
+    if (present != -1) {
+        uint8_t way = (uint8_t) present;
+        uint8_t* sectors = cache_valid_ptr_as(cache, config, layout, line_index, way);
+        cache_copy_sectors(config, cache_line_ptr_as(cache, config, layout, line_index, way), line,
+                           (uint8_t) (valid & ~*sectors));
+        *sectors |= valid;
+        *cache_dirty_ptr_as(cache, config, layout, line_index, way) |= dirty;
+        kernel_touch(cache, config, layout, line_index, way, 0, replace);
+        cache_set_hint(cache, config, line_index) = way;
+        *p_way = way;
+        return 0;
+    }
+
+    int empty_way = kernel_empty(cache, config, layout, line_index);
+    int cold_start = (empty_way != -1);
+    uint8_t way = cold_start ? (uint8_t) empty_way : kernel_victim(cache, config, layout, line_index, replace);
+
+    word_t* entry_line = cache_line_ptr_as(cache, config, layout, line_index, way);
+    if (!cold_start) {
+        *victim_tag = *cache_tag_ptr_as(cache, config, layout, line_index, way);
+        *victim_valid = *cache_valid_ptr_as(cache, config, layout, line_index, way);
+        *victim_dirty = *cache_dirty_ptr_as(cache, config, layout, line_index, way);
+        memcpy(victim_line, entry_line, config->payload_size);
+    }
+
+    *cache_valid_ptr_as(cache, config, layout, line_index, way) = valid;
+    *cache_dirty_ptr_as(cache, config, layout, line_index, way) = dirty;
+    *cache_tag_ptr_as(cache, config, layout, line_index, way) = tag;
+    memcpy(entry_line, line, config->payload_size);
+    if (IS_RRIP(replace)) {
+        rrip_insert(cache, config, layout, line_index, way, replace);
+    } else {
+        kernel_touch(cache, config, layout, line_index, way, cold_start, replace);
+    }
+    cache_set_hint(cache, config, line_index) = way;
+
+    *p_way = way;
+    return !cold_start;
+}
+
+// Stores an entry given in the exchange (AoS) format into a way
+KERNEL_INLINE void kernel_put(void* cache, const cache_config_t* config, cache_layout_t layout,
+                              uint16_t line_index, uint8_t way, const cache_entry_t* entry) {
+    if (layout == CACHE_LAYOUT_AOS) {
+        memcpy(cache_entry(cache, config, line_index, way), entry, config->entry_size);
+        return;
+    }
+    *cache_valid_ptr_as(cache, config, layout, line_index, way) = entry->v;
+    *cache_age_ptr_as(cache, config, layout, line_index, way) = entry->age;
+    *cache_dirty_ptr_as(cache, config, layout, line_index, way) = entry->d;
+    *cache_tag_ptr_as(cache, config, layout, line_index, way) = entry->tag;
+    memcpy(cache_line_ptr_as(cache, config, layout, line_index, way), entry->line, config->payload_size);
+}
+
+//=========================================================================
+// Instances and dispatch tables
+
+typedef int (*find_kernel_t)(const void* cache, const cache_config_t* config,
+                             uint16_t line_index, uint32_t tag);
+typedef void (*put_kernel_t)(void* cache, const cache_config_t* config,
+                             uint16_t line_index, uint8_t way, const cache_entry_t* entry);
+typedef int (*lookup_kernel_t)(void* cache, const cache_config_t* config,
+                               uint16_t line_index, uint32_t tag, uint8_t sector, int* predicted);
+typedef int (*insert_kernel_t)(void* cache, const cache_config_t* config, uint16_t line_index,
+                               uint32_t tag, const word_t* line, uint8_t valid, uint8_t dirty, uint8_t* p_way,
+                               uint32_t* victim_tag, word_t* victim_line, uint8_t* victim_valid,
+                               uint8_t* victim_dirty);
+
+// Kernels that only depend on the layout
+typedef struct {
+    find_kernel_t find;
+    put_kernel_t  put;
+} cache_layout_kernels_t;
+
+// Kernels of one layout and replacement policy
+typedef struct {
+    lookup_kernel_t lookup;
+    insert_kernel_t insert;
+} cache_kernels_t;
+
+#define CACHE_KERNELS_POLICY(L, LAYOUT, P, REPLACE) \
+    static int lookup_##L##_##P(void* cache, const cache_config_t* config, \
+                                uint16_t line_index, uint32_t tag, uint8_t sector, int* predicted) { \
+        return kernel_lookup(cache, config, LAYOUT, line_index, tag, sector, REPLACE, predicted); \
+    } \
+    static int insert_##L##_##P(void* cache, const cache_config_t* config, uint16_t line_index, \
+                                uint32_t tag, const word_t* line, uint8_t valid, uint8_t dirty, \
+                                uint8_t* p_way, uint32_t* victim_tag, word_t* victim_line, \
+                                uint8_t* victim_valid, uint8_t* victim_dirty) { \
+        return kernel_insert(cache, config, LAYOUT, line_index, tag, line, valid, dirty, REPLACE, p_way, \
+                             victim_tag, victim_line, victim_valid, victim_dirty); \
+    }
+
+#define CACHE_KERNELS_LAYOUT(L, LAYOUT) \
+    static int find_##L(const void* cache, const cache_config_t* config, uint16_t line_index, uint32_t tag) { \
+        return kernel_find(cache, config, LAYOUT, line_index, tag); \
+    } \
+    static void put_##L(void* cache, const cache_config_t* config, uint16_t line_index, uint8_t way, \
+                        const cache_entry_t* entry) { \
+        kernel_put(cache, config, LAYOUT, line_index, way, entry); \
+    } \
+    CACHE_KERNELS_POLICY(L, LAYOUT, lru, LRU) \
+    CACHE_KERNELS_POLICY(L, LAYOUT, plru_tree, PLRU_TREE) \
+    CACHE_KERNELS_POLICY(L, LAYOUT, plru_bit, PLRU_BIT) \
+    CACHE_KERNELS_POLICY(L, LAYOUT, srrip, SRRIP) \
+    CACHE_KERNELS_POLICY(L, LAYOUT, brrip, BRRIP) \
+    CACHE_KERNELS_POLICY(L, LAYOUT, drrip, DRRIP)
+
+CACHE_KERNELS_LAYOUT(aos, CACHE_LAYOUT_AOS)
+CACHE_KERNELS_LAYOUT(soa, CACHE_LAYOUT_SOA)
+
+#define CACHE_KERNELS_ENTRY(L, P) { lookup_##L##_##P, insert_##L##_##P }
+#define CACHE_KERNELS_ROW(L) { \
+        [LRU] = CACHE_KERNELS_ENTRY(L, lru), \
+        [PLRU_TREE] = CACHE_KERNELS_ENTRY(L, plru_tree), \
+        [PLRU_BIT] = CACHE_KERNELS_ENTRY(L, plru_bit), \
+        [SRRIP] = CACHE_KERNELS_ENTRY(L, srrip), \
+        [BRRIP] = CACHE_KERNELS_ENTRY(L, brrip), \
+        [DRRIP] = CACHE_KERNELS_ENTRY(L, drrip) }
+
+static const cache_layout_kernels_t LAYOUT_KERNELS[NB_LAYOUTS] = {
+    [CACHE_LAYOUT_AOS] = { find_aos, put_aos },
+    [CACHE_LAYOUT_SOA] = { find_soa, put_soa }
+};
+
+static const cache_kernels_t POLICY_KERNELS[NB_LAYOUTS][NB_POLICIES] = {
+    [CACHE_LAYOUT_AOS] = CACHE_KERNELS_ROW(aos),
+    [CACHE_LAYOUT_SOA] = CACHE_KERNELS_ROW(soa)
+};
+
+//=========================================================================
+/**
+ * @brief Kernels of the layout of a cache.
+ * @param config the geometry of the cache (checked)
+ */
+static inline const cache_layout_kernels_t* cache_layout_kernels(const cache_config_t* config) {
+    return &LAYOUT_KERNELS[config->layout];
+}
+
+/**
+ * @brief Kernels of the layout and replacement policy of a cache.
+ * @param config the geometry of the cache (checked)
+ * @param replace the replacement policy (supported by the cache)
+ */
+static inline const cache_kernels_t* cache_kernels(const cache_config_t* config, cache_replace_t replace) {
+    return &POLICY_KERNELS[config->layout][replace];
+}
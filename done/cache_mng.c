@@ -9,7 +9,7 @@
 #include "error.h"
 #include "util.h"
 #include "cache_mng.h"
-#include "lru.h"
+#include "cache_kernels.h"
 
 #include <stdlib.h>
 #include <stdio.h>
@@ -18,336 +18,1018 @@
 //=========================================================================
 // Helper functions & Macros
 
-#define L1_PHY_ADDR_BYTE_INDEX 0
-#define L1_PHY_ADDR_WORD_INDEX 2
-#define L1_PHY_ADDR_LINE_INDEX 4
-#define L1_PHY_ADDR_TAG_INDEX 10
-#define L1_PHY_ADDR_TAG_END_INDEX 32
-
-// Used by M_TLB_ENTRY_T(m_tlb_type) to get a ..._entry_t from an type
-#define M_L1_ICACHE_ENTRY l1_icache_entry_t
-#define M_L1_DCACHE_ENTRY l1_dcache_entry_t
-#define M_L2_CACHE_ENTRY l2_cache_entry_t
-
-// Used to get a ..._entry_t from a tlb_type (enum)
-// To be used strictly with parameters L1_ICACHE, L1_DCACHE or L2_CACHE
-#define M_CACHE_ENTRY_T(m_cache_type) M_ ## m_cache_type ## _ENTRY
-
-// Creates a if else if .. statement with a select macro for all 3 cache types
-#define M_EXPAND_ALL_CACHE_TYPES(MACRO) \
-	if (cache_type == L1_ICACHE) { \
-		MACRO(L1_ICACHE); \
-	} else if (cache_type == L1_DCACHE) { \
-		MACRO(L1_DCACHE); \
-	} else { \
-		MACRO(L2_CACHE); \
-	}
-
-#define L1_LINETAG_TO_L2_LINETAG(IN_L1_TAG, IN_L1_LINE, OUT_L2_TAG, OUT_L2_LINE) \
+// Checks that a geometry was set up by cache_config_init()
+#define M_REQUIRE_CACHE_CONFIG(config) \
     do { \
-        OUT_L2_TAG = extractBits32(IN_L1_TAG, 0, L2_CACHE_TAG_BITS); \
-        OUT_L2_LINE = (extractBits32(IN_L1_TAG, 0, 3) << 6) | IN_L1_LINE; \
+        M_REQUIRE_NON_NULL(config); \
+        M_REQUIRE((config)->entry_size != 0, ERR_BAD_PARAMETER, "%s", #config " is not initialized"); \
     } while(0)
 
-#define L2_LINETAG_TO_L1_LINETAG(IN_L2_TAG, IN_L2_LINE, OUT_L1_TAG, OUT_L1_LINE) \
-    do { \
-        OUT_L1_TAG = (IN_L2_TAG << 3) | extractBits32(IN_L2_LINE, 6, 9); \
-        OUT_L1_LINE = extractBits32(IN_L2_LINE, 0, 6); \
-    } while(0)
+// Turns the phy_addr_t to and more useful uint32
+static inline uint32_t get_addr(const phy_addr_t * paddr) {
+    return (paddr->phy_page_num << PAGE_OFFSET) | (paddr->page_offset);
+}
+
+// log2 of a power of 2
+static inline uint8_t log2_u32(uint32_t value) {
+    uint8_t bits = 0;
+    while (value >>= 1) ++bits;
+    return bits;
+}
+
+#define IS_POWER_OF_2(X) ((X) != 0 && ((X) & ((X) - 1)) == 0)
+
+// Counts an event in the statistics of a cache
+#define CACHE_STAT(CACHE, CONFIG, FIELD) (++cache_state(CACHE, CONFIG)->stats.FIELD)
+
+// Counts an event of a set in the heat map of the cache, if any
+static inline void heat_event(const void* cache, const cache_config_t* config, uint16_t line_index,
+                              heat_event_t event) {
+    heat_level_t* heat = cache_state(cache, config)->heat;
+    if (heat != NULL) heat_count(heat, line_index, event);
+}
 
-#define TRANSFER_ENTRY_INFO(DEST_ENTRY, SRC_ENTRY, DEST_TAG) \
+// Checks that two geometries can be used as L1 and L2 of a hierarchy
+#define M_REQUIRE_HRCHY(mem_space, l1_config, l2_config) \
     do { \
-        (DEST_ENTRY)->v = 1; \
-        (DEST_ENTRY)->tag = (DEST_TAG); \
-        memcpy((DEST_ENTRY)->line, (SRC_ENTRY)->line, sizeof(word_t) * L1_DCACHE_WORDS_PER_LINE); \
+        M_REQUIRE_CACHE_CONFIG(l1_config); \
+        M_REQUIRE_CACHE_CONFIG(l2_config); \
+        M_REQUIRE((l1_config)->line_size == (l2_config)->line_size, ERR_BAD_PARAMETER, "%s", "L1 and L2 line sizes differ"); \
+        M_REQUIRE((l1_config)->sector_size == (l2_config)->sector_size, ERR_BAD_PARAMETER, "%s", "L1 and L2 sector sizes differ"); \
+        M_REQUIRE((l1_config)->tag_only == (l2_config)->tag_only, ERR_BAD_PARAMETER, "%s", "L1 and L2 tag-only modes differ"); \
+        M_REQUIRE((l1_config)->write_back == (l2_config)->write_back, ERR_BAD_PARAMETER, "%s", "L1 and L2 write policies differ"); \
+        M_REQUIRE((mem_space) != NULL || (l1_config)->tag_only, ERR_BAD_PARAMETER, "%s", "mem_space is NULL"); \
     } while(0)
 
-#define my_cache_cast(CACHE, M_CACHE_TYPE) ((M_CACHE_ENTRY_T(M_CACHE_TYPE) *) CACHE)
+#define M_REQUIRE_REPLACE(config, replace) \
+    M_REQUIRE(cache_replace_supported(config, replace), ERR_POLICY, \
+              "%d: replacement policy not supported by this cache", replace)
 
-// --------------------------------------------------
-#define my_cache_entry(CACHE, M_CACHE_TYPE, LINE_INDEX, WAY) \
-        (my_cache_cast(CACHE, M_CACHE_TYPE) + (LINE_INDEX) * (M_CACHE_TYPE ## _WAYS) + (WAY))
-
-#define ZERO_4_LSBS 0xFFFFFFF0
+// Checks that an access is at most a line long and lies in one page
+#define M_REQUIRE_ACCESS_SIZE(paddr, size, config) \
+    M_REQUIRE((size) >= 1 && (size) <= (config)->line_size && (paddr)->page_offset + (size) <= PAGE_SIZE, \
+              ERR_BAD_PARAMETER, "%zu: access size out of range or crossing a page", (size_t) (size))
 
 // Finds the line in memory
-static inline word_t* find_line_in_mem(const void* mem_space, uint32_t phy_addr) {
-    uint32_t alligned_phy_addr = phy_addr & ZERO_4_LSBS;
+static inline word_t* find_line_in_mem(const void* mem_space, uint32_t phy_addr, const cache_config_t* config) {
+    uint32_t alligned_phy_addr = phy_addr & ~((uint32_t) config->line_size - 1);
     return (word_t*) mem_space + alligned_phy_addr/sizeof(word_t);
 }
-#undef ZERO_4_LSBS
 
-// Applies the correct increase or update policy on given cache block
-static inline void recompute_ages(void* cache, cache_t cache_type, uint16_t cache_line, uint8_t way_index, uint8_t bool_cold_start, cache_replace_t replace);
+// Gets the byte_select from a phy_addr
+static inline uint8_t extract_byte_select(uint32_t phy_addr, const cache_config_t* config) {
+    return phy_addr & (config->word_size - 1u);
+}
 
-// Find an empty way of a cache line
-static inline int find_empty_way(void * cache, cache_t cache_type, uint16_t cache_line_index);
+// Gets the word_select from a phy_addr
+static inline uint8_t extract_word_select(uint32_t phy_addr, const cache_config_t* config) {
+    return (phy_addr >> config->word_bits) & (config->words_per_line - 1u);
+}
 
-// Finds the oldest way of a cache line
-static inline uint8_t find_oldest_way(void* cache, cache_t cache_type, uint16_t cache_line);
+// Gets the line (set) index from a phy_addr
+static inline uint16_t extract_line_select(uint32_t phy_addr, const cache_config_t* config) {
+    return (phy_addr >> config->line_bits) & (config->lines - 1u);
+}
 
-// Turns the phy_addr_t to and more useful uint32
-static inline uint32_t get_addr(const phy_addr_t * paddr) {
-    return (paddr->phy_page_num << PAGE_OFFSET) | (paddr->page_offset);
+// Gets the tag from a phy_addr
+static inline uint32_t extract_tag(uint32_t phy_addr, const cache_config_t* config) {
+    return phy_addr >> config->tag_remaining_bits;
+}
+
+// Gets the word of a line at a phy_addr (0 in tag-only mode)
+static inline word_t line_word(const word_t* line, uint32_t phy_addr, const cache_config_t* config) {
+    return config->tag_only ? 0 : line[extract_word_select(phy_addr, config)];
+}
+
+// Rebuilds the (line aligned) phy_addr of a line from its tag and line index
+static inline uint32_t line_addr(uint32_t tag, uint16_t line_index, const cache_config_t* config) {
+    return (tag << config->tag_remaining_bits) | ((uint32_t) line_index << config->line_bits);
+}
+
+// Counts the bytes of the given sectors of a line
+static inline uint32_t sector_bytes(uint8_t sectors, const cache_config_t* config) {
+    uint32_t count = 0;
+    for (; sectors != 0; sectors &= (uint8_t) (sectors - 1u)) ++count;
+    return count * config->sector_size;
 }
 
 /**
- * @brief Looks for an empty way in the cache at the given line.
- * 
+ * @brief Looks for a valid way holding the given tag in the cache at the given line.
+ *
  * @param cache the cache
- * @param cache_type its type
+ * @param config its geometry
  * @param cache_line_index the index
- * 
- * @return the index of the 1st empty way that was found. Otherwise, returns -1 
+ * @param tag the tag to look for
+ *
+ * @return the index of the way that was found. Otherwise, returns -1
  */
-static inline int find_empty_way(void * cache, cache_t cache_type, uint16_t cache_line_index) {    
-    #define M_FIND_EMPTY_WAY(m_cache_type) \
-        foreach_way(i, m_cache_type ## _WAYS) { \
-            if (!cache_valid(M_CACHE_ENTRY_T(m_cache_type), m_cache_type ## _WAYS, cache_line_index, i)) { \
-                return i; \
-            } \
+static inline int find_way(const void * cache, const cache_config_t* config, uint16_t cache_line_index, uint32_t tag) {
+    return cache_layout_kernels(config)->find(cache, config, cache_line_index, tag);
+}
+
+// Way holding the line of an address with its sector valid, -1 if none
+static inline int find_sector(const void* cache, const cache_config_t* config, uint32_t phy_addr) {
+    uint16_t line_index = extract_line_select(phy_addr, config);
+    int way = find_way(cache, config, line_index, extract_tag(phy_addr, config));
+    if (way == -1 || !(cache_valid(cache, config, line_index, way) & cache_sector_bit(config, phy_addr))) return -1;
+    return way;
+}
+
+// Writes the valid sectors of a line to memory, counting the traffic in the
+// stats of the writing cache. Memory then holds the most recent data: the
+// copies of the line in the caches below the writing one (see
+// cache_attach_lower()) are refreshed, and clean unless they hold other
+// sectors.
+static inline void write_line_to_mem(void* mem_space, void* cache, const cache_config_t* config,
+                                     uint32_t phy_addr, const word_t* line, uint8_t valid) {
+    if (!config->tag_only) {
+        cache_copy_sectors(config, find_line_in_mem(mem_space, phy_addr, config), line, valid);
+    }
+    cache_state(cache, config)->stats.mem_write_bytes += sector_bytes(valid, config);
+
+    for (const cache_state_t* state = cache_state(cache, config); state->lower != NULL;
+         state = cache_state(state->lower, state->lower_config)) {
+        const cache_config_t* lower_config = state->lower_config;
+        uint16_t line_index = extract_line_select(phy_addr, lower_config);
+        int way = find_way(state->lower, lower_config, line_index, extract_tag(phy_addr, lower_config));
+        if (way != -1) {
+            uint8_t lower_valid = cache_valid(state->lower, lower_config, line_index, way);
+            cache_copy_sectors(lower_config, cache_line(state->lower, lower_config, line_index, way), line,
+                               valid & lower_valid);
+            if (!(lower_valid & ~valid)) cache_dirty(state->lower, lower_config, line_index, way) = 0;
         }
+    }
+}
 
-    M_EXPAND_ALL_CACHE_TYPES(M_FIND_EMPTY_WAY)
+// Writes the written sector of a line "through the cache" (write-through caches only)
+static inline void write_though(void* mem_space, void* cache, uint32_t phy_addr,
+                                const uint32_t* p_line, uint8_t valid, const cache_config_t* config) {
+    if (config->write_back) return;
+    write_line_to_mem(mem_space, cache, config, phy_addr, p_line, valid);
+}
 
-    return -1;
-    #undef M_find_empty_way
+/**
+ * @brief Places a line in a cache line (set), in an empty way if any, in the
+ *        oldest way otherwise.
+ *
+ * @param cache the cache
+ * @param config its geometry
+ * @param line_index where to place the line
+ * @param tag the tag of the line
+ * @param line the words of the line
+ * @param valid its valid sectors (merged into the line if already present)
+ * @param dirty whether the line is dirty
+ * @param replace replacement policy
+ * @param p_way (modified) the way where the line was placed
+ * @param victim_tag (modified) tag of the evicted entry, if any
+ * @param victim_line (modified) words of the evicted entry, if any
+ * @param victim_valid (modified) valid sectors of the evicted entry, if any
+ * @param victim_dirty (modified) whether the evicted entry was dirty, if any
+ * @return 1 if a valid entry was evicted, 0 otherwise
+ */
+static inline int insert_line(void* cache, const cache_config_t* config, uint16_t line_index,
+                              uint32_t tag, const word_t* line, uint8_t valid, uint8_t dirty,
+                              cache_replace_t replace, uint8_t* p_way, uint32_t* victim_tag,
+                              word_t* victim_line, uint8_t* victim_valid, uint8_t* victim_dirty) {
+    return cache_kernels(config, replace)->insert(cache, config, line_index, tag, line, valid, dirty, p_way,
+                                                  victim_tag, victim_line, victim_valid, victim_dirty);
 }
 
 /**
- * @Brief Extracts bits from a u_int bitstring from start (included) to stop 
- * 		  (excluded)
- * @param sample The bitstring from which to extract
- * @param start bit index/placeholder from which to clip
- * @param stop bit index/placeholder till which to clip
- * @return the right justified extracted u_int bitstring
+ * @brief Looks the line (sector) of an address up in a cache, counting the
+ *        access and updating the replacement state and the MRU way hint,
+ *        without checking the arguments (see cache_hit()).
+ *
+ * @param cache the cache
+ * @param config its geometry
+ * @param phy_addr the address
+ * @param replace replacement policy
+ * @return the way holding the line and its sector, -1 on miss
  */
-static inline uint32_t extractBits32(uint32_t sample, const uint8_t start, const uint8_t stop) {
-    return (sample << (32 - stop)) >> (32 - stop + start);
+static inline int lookup(void* cache, const cache_config_t* config, uint32_t phy_addr, cache_replace_t replace) {
+    uint16_t line_index = extract_line_select(phy_addr, config);
+    int predicted = 0;
+    int way = cache_kernels(config, replace)->lookup(cache, config, line_index, extract_tag(phy_addr, config),
+                                                     cache_sector_bit(config, phy_addr), &predicted);
+    if (way == KERNEL_SECTOR_MISS) {
+        CACHE_STAT(cache, config, sector_misses);
+        way = -1;
+    }
+
+    miss_class_t* classifier = cache_state(cache, config)->classifier;
+    if (classifier != NULL) {
+        miss_class_access(classifier, phy_addr, way != -1);
+    }
+    heat_event(cache, config, line_index, way != -1 ? HEAT_HITS : HEAT_MISSES);
+    if (way == -1) {
+        CACHE_STAT(cache, config, misses);
+        return way;
+    }
+    CACHE_STAT(cache, config, hits);
+    if (predicted) CACHE_STAT(cache, config, mru_hits);
+    return way;
 }
 
-// Gets the byte_select from a phy_addr (same for l1 and l2)
-static inline uint8_t extract_byte_select(uint32_t phy_addr) {
-    return extractBits32(phy_addr, L1_PHY_ADDR_BYTE_INDEX, L1_PHY_ADDR_WORD_INDEX);
+// Writes back the dirty copy of a line in a cache, then in the caches
+// attached above it (the uppermost last, as the most recent one), and
+// invalidates the copies if asked to. Sets *found if there was any copy
+// and adds the sectors of the ones written back to *written.
+static void snoop_line(void* mem_space, void* cache, const cache_config_t* config,
+                       uint32_t phy_addr, int invalidate, int* found, uint8_t* written) {
+    uint16_t line_index = extract_line_select(phy_addr, config);
+    int way = find_way(cache, config, line_index, extract_tag(phy_addr, config));
+    if (way != -1) {
+        uint8_t valid = cache_valid(cache, config, line_index, way);
+        *found = 1;
+        if (invalidate) {
+            cache_valid(cache, config, line_index, way) = 0;
+            CACHE_STAT(cache, config, invalidations);
+        }
+        if (cache_dirty(cache, config, line_index, way)) {
+            CACHE_STAT(cache, config, writebacks);
+            cache_dirty(cache, config, line_index, way) = 0;
+            write_line_to_mem(mem_space, cache, config, phy_addr, cache_line(cache, config, line_index, way), valid);
+            *written |= valid;
+        }
+    }
+
+    const cache_state_t* state = cache_state(cache, config);
+    for (uint8_t i = 0; i < state->nb_upper; ++i) {
+        snoop_line(mem_space, state->upper[i], state->upper_config[i], phy_addr, invalidate, found, written);
+    }
 }
 
-// Gets the word_select from a phy_addr (same for l1 and l2)
-static inline uint8_t extract_word_select(uint32_t phy_addr) {
-    return extractBits32(phy_addr, L1_PHY_ADDR_WORD_INDEX, L1_PHY_ADDR_LINE_INDEX);
+// Invalidates a line in one upper cache and in the caches attached above
+// it, writing the copies back if dirty; returns the sectors written back
+static inline uint8_t invalidate_upper(void* mem_space, void* upper, const cache_config_t* upper_config,
+                                       uint32_t phy_addr) {
+    int found = 0;
+    uint8_t written = 0;
+    snoop_line(mem_space, upper, upper_config, phy_addr, 1, &found, &written);
+    return written;
 }
 
-static inline uint16_t extract_l1_line_select(uint32_t phy_addr) {
-    return extractBits32(phy_addr, L1_PHY_ADDR_LINE_INDEX, L1_PHY_ADDR_TAG_INDEX);
+// Inclusive L2: removes a line dropped from L2 from all the L1 caches above
+// it (the attached ones and l1_cache). Returns the sectors of the dirty L1
+// copies written back, which make these sectors of the L2 copy stale.
+static inline uint8_t back_invalidate(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                      void* l2_cache, const cache_config_t* l2_config, uint32_t phy_addr) {
+    const cache_state_t* state = cache_state(l2_cache, l2_config);
+    uint8_t written = 0;
+    int l1_attached = 0;
+    for (uint8_t i = 0; i < state->nb_upper; ++i) {
+        l1_attached |= (state->upper[i] == l1_cache);
+        written |= invalidate_upper(mem_space, state->upper[i], state->upper_config[i], phy_addr);
+    }
+    if (!l1_attached) {
+        written |= invalidate_upper(mem_space, l1_cache, l1_config, phy_addr);
+    }
+    return written;
+}
+
+// Places a line into L3, handling the L3 victim (if any): back-invalidation
+// (inclusive L3), then write-back of its dirty sectors not written back
+// from above
+static inline void insert_l3(void* mem_space, void* l3_cache, const cache_config_t* l3_config,
+                             uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty,
+                             cache_replace_t replace) {
+    uint16_t dest_l3_line = extract_line_select(phy_addr, l3_config);
+    uint8_t way;
+    uint32_t dropped_tag;
+    uint8_t dropped_valid;
+    uint8_t dropped_dirty;
+    word_t dropped_line[CACHE_MAX_WORDS_PER_LINE];
+
+    if (insert_line(l3_cache, l3_config, dest_l3_line, extract_tag(phy_addr, l3_config), line, valid, dirty,
+                    replace, &way, &dropped_tag, dropped_line, &dropped_valid, &dropped_dirty)) {
+        CACHE_STAT(l3_cache, l3_config, evictions);
+        heat_event(l3_cache, l3_config, dest_l3_line, HEAT_EVICTIONS);
+        uint32_t dropped_addr = line_addr(dropped_tag, dest_l3_line, l3_config);
+        uint8_t written = 0;
+        if (l3_config->inclusion == CACHE_INCLUSIVE) {
+            const cache_state_t* state = cache_state(l3_cache, l3_config);
+            for (uint8_t i = 0; i < state->nb_upper; ++i) {
+                written |= invalidate_upper(mem_space, state->upper[i], state->upper_config[i], dropped_addr);
+            }
+        }
+        if (dropped_dirty && (dropped_valid & ~written)) {
+            CACHE_STAT(l3_cache, l3_config, writebacks);
+            write_line_to_mem(mem_space, l3_cache, l3_config, dropped_addr, dropped_line, dropped_valid & ~written);
+        }
+    }
 }
 
-#define L2_LINE_INDEX_START 4
-#define L2_LINE_INDEX_END 13
+// Handles a line dropped from L2 into the L3 below it:
+//  - exclusive L3: the line is placed into L3;
+//  - inclusive and NINE L3: a dirty line updates its L3 copy; without
+//    L3 copy (NINE only), dirty lines are placed into L3, clean ones dropped.
+static inline void handle_l2_to_l3(void* mem_space, void* l2_cache, const cache_config_t* l2_config,
+                                   uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty) {
+    const cache_state_t* state = cache_state(l2_cache, l2_config);
+    void* l3_cache = state->lower;
+    const cache_config_t* l3_config = state->lower_config;
+
+    uint16_t l3_line = extract_line_select(phy_addr, l3_config);
+    int way = find_way(l3_cache, l3_config, l3_line, extract_tag(phy_addr, l3_config));
+    if (way != -1) {
+        if (dirty) {
+            cache_copy_sectors(l3_config, cache_line(l3_cache, l3_config, l3_line, way), line, valid);
+            cache_valid(l3_cache, l3_config, l3_line, way) |= valid;
+            cache_dirty(l3_cache, l3_config, l3_line, way) = 1;
+        }
+        return;
+    }
+    if (l3_config->inclusion != CACHE_EXCLUSIVE && !dirty) return;
 
-static inline uint16_t extract_l2_line_select(uint32_t phy_addr) {
-    return extractBits32(phy_addr, L2_LINE_INDEX_START, L2_LINE_INDEX_END);
+    CACHE_STAT(l3_cache, l3_config, victim_inserts);
+    insert_l3(mem_space, l3_cache, l3_config, phy_addr, line, valid, dirty, (cache_replace_t) state->lower_replace);
 }
 
-#undef L2_LINE_INDEX_START
-#undef L2_LINE_INDEX_END
+// Handles a line dropped from L2: back-invalidation (inclusive L2), then
+// down to L3 (if any), else write-back if dirty. Memory holds the most
+// recent data of the sectors of the L1 copies written back: only the other
+// sectors of the line go on (none when the line is not sectored).
+static inline void handle_l2_victim(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                    void* l2_cache, const cache_config_t* l2_config,
+                                    uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty) {
+    if (l2_config->inclusion == CACHE_INCLUSIVE) {
+        valid &= (uint8_t) ~back_invalidate(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr);
+        if (!valid) return;
+    }
+    if (cache_state(l2_cache, l2_config)->lower != NULL) {
+        handle_l2_to_l3(mem_space, l2_cache, l2_config, phy_addr, line, valid, dirty);
+    } else if (dirty) {
+        CACHE_STAT(l2_cache, l2_config, writebacks);
+        write_line_to_mem(mem_space, l2_cache, l2_config, phy_addr, line, valid);
+    }
+}
+
+// Places a line into L2, handling the L2 victim (if any)
+static inline void insert_l2(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                             void* l2_cache, const cache_config_t* l2_config,
+                             uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty,
+                             cache_replace_t replace) {
+    uint16_t dest_l2_line = extract_line_select(phy_addr, l2_config);
+    uint8_t way;
+    uint32_t dropped_tag;
+    uint8_t dropped_valid;
+    uint8_t dropped_dirty;
+    word_t dropped_line[CACHE_MAX_WORDS_PER_LINE];
+
+    if (insert_line(l2_cache, l2_config, dest_l2_line, extract_tag(phy_addr, l2_config), line, valid, dirty,
+                    replace, &way, &dropped_tag, dropped_line, &dropped_valid, &dropped_dirty)) {
+        CACHE_STAT(l2_cache, l2_config, evictions);
+        heat_event(l2_cache, l2_config, dest_l2_line, HEAT_EVICTIONS);
+        handle_l2_victim(mem_space, l1_cache, l1_config, l2_cache, l2_config,
+                         line_addr(dropped_tag, dest_l2_line, l2_config), dropped_line, dropped_valid,
+                         dropped_dirty);
+    }
+}
 
-#define extract_tag(phy_addr, m_cache_type) (phy_addr >> m_cache_type ## _TAG_REMAINING_BITS)
+// Handles a victim evicted from L1:
+//  - exclusive L2: the victim is placed into L2;
+//  - inclusive and NINE L2: a dirty victim updates its L2 copy; without
+//    L2 copy (NINE only), dirty victims are placed into L2, clean ones dropped.
+static inline void handle_l1_to_l2(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                   void* l2_cache, const cache_config_t* l2_config,
+                                   uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty,
+                                   cache_replace_t replace) {
+    if (l2_config->inclusion != CACHE_EXCLUSIVE) {
+        uint16_t l2_line = extract_line_select(phy_addr, l2_config);
+        int way = find_way(l2_cache, l2_config, l2_line, extract_tag(phy_addr, l2_config));
+        if (way != -1) {
+            if (dirty) {
+                cache_copy_sectors(l2_config, cache_line(l2_cache, l2_config, l2_line, way), line, valid);
+                cache_valid(l2_cache, l2_config, l2_line, way) |= valid;
+                cache_dirty(l2_cache, l2_config, l2_line, way) = 1;
+            }
+            return;
+        }
+        if (!dirty) return;
+    }
 
-// Performs everything to correctly move a cache_entry from l2 to l1
-static inline void handle_l2_to_l1(void* l1_cache, void* l2_cache, uint16_t src_l2_line, uint8_t src_l2_way, cache_replace_t replace) {
-    l1_icache_entry_t new_l1_entry;
-    l2_cache_entry_t* old_l2_entry = my_cache_entry(l2_cache, L2_CACHE, src_l2_line, src_l2_way);
+    CACHE_STAT(l2_cache, l2_config, victim_inserts);
+    insert_l2(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, line, valid, dirty, replace);
+}
 
-    uint32_t dest_l1_tag; uint16_t dest_l1_line;
-    L2_LINETAG_TO_L1_LINETAG(old_l2_entry->tag, src_l2_line, dest_l1_tag, dest_l1_line);  
-    TRANSFER_ENTRY_INFO(&new_l1_entry, old_l2_entry, dest_l1_tag);
+// Places a line into L1, handling the L1 victim (if any); returns its way
+static inline uint8_t handle_to_l1(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                   void* l2_cache, const cache_config_t* l2_config,
+                                   uint32_t phy_addr, const word_t* line, uint8_t valid, uint8_t dirty,
+                                   cache_replace_t replace) {
+    uint16_t dest_l1_line = extract_line_select(phy_addr, l1_config);
+    uint8_t way;
+    uint32_t victim_tag;
+    uint8_t victim_valid;
+    uint8_t victim_dirty;
+    word_t victim_line[CACHE_MAX_WORDS_PER_LINE];
+
+    if (insert_line(l1_cache, l1_config, dest_l1_line, extract_tag(phy_addr, l1_config), line, valid, dirty,
+                    replace, &way, &victim_tag, victim_line, &victim_valid, &victim_dirty)) {
+        CACHE_STAT(l1_cache, l1_config, evictions);
+        heat_event(l1_cache, l1_config, dest_l1_line, HEAT_EVICTIONS);
+        handle_l1_to_l2(mem_space, l1_cache, l1_config, l2_cache, l2_config,
+                        line_addr(victim_tag, dest_l1_line, l1_config), victim_line, victim_valid,
+                        victim_dirty, replace);
+    }
+    return way;
+}
 
-    old_l2_entry->v = 0; // Invalidate l2_entry
+// Copies a line hit in L2 into L1. An exclusive L2 gives the line (and its
+// dirty bit) away, the other ones keep it. Returns the L1 way.
+static inline uint8_t handle_l2_to_l1(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                      void* l2_cache, const cache_config_t* l2_config,
+                                      uint16_t src_l2_line, uint8_t src_l2_way, cache_replace_t replace) {
+    word_t line[CACHE_MAX_WORDS_PER_LINE];
+    memcpy(line, cache_line(l2_cache, l2_config, src_l2_line, src_l2_way), l2_config->payload_size);
+    uint32_t phy_addr = line_addr(cache_tag(l2_cache, l2_config, src_l2_line, src_l2_way), src_l2_line, l2_config);
+    uint8_t valid = cache_valid(l2_cache, l2_config, src_l2_line, src_l2_way);
+    uint8_t dirty = 0;
+
+    CACHE_STAT(l2_cache, l2_config, promotions);
+    if (l2_config->inclusion == CACHE_EXCLUSIVE) {
+        dirty = cache_dirty(l2_cache, l2_config, src_l2_line, src_l2_way);
+        cache_valid(l2_cache, l2_config, src_l2_line, src_l2_way) = 0; // Invalidate l2_entry
+        CACHE_STAT(l2_cache, l2_config, invalidations);
+    }
 
-    // Searching where to place old_l1_entry
-    int l1_empty_way = find_empty_way(l1_cache, L1_ICACHE, dest_l1_line);
-    uint8_t l1_cold_start = (l1_empty_way != -1);
+    return handle_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, line, valid, dirty, replace);
+}
 
-    if (l1_cold_start) {
-        l1_icache_entry_t* l1_empty_entry = my_cache_entry(l1_cache, L1_ICACHE, dest_l1_line, l1_empty_way);
-        TRANSFER_ENTRY_INFO(l1_empty_entry, &new_l1_entry, dest_l1_tag);
-        recompute_ages(l1_cache, L1_ICACHE, dest_l1_line, l1_empty_way, l1_cold_start, replace);
-    } else {
-        uint8_t l1_oldest_way = find_oldest_way(l1_cache, L1_ICACHE, dest_l1_line);
-        l1_icache_entry_t* old_l1_entry_ptr = my_cache_entry(l1_cache, L1_ICACHE, dest_l1_line, l1_oldest_way);
-        l1_icache_entry_t old_l1_entry = *old_l1_entry_ptr;
-
-        TRANSFER_ENTRY_INFO(old_l1_entry_ptr, &new_l1_entry, dest_l1_tag);
-        recompute_ages(l1_cache, L1_ICACHE, dest_l1_line, l1_oldest_way, l1_cold_start, replace);
-
-        // =========== look for space in l2 cache =============
-        uint32_t dest_l2_tag; uint16_t dest_l2_line; // Fining index for l2_cache
-        L1_LINETAG_TO_L2_LINETAG(old_l1_entry.tag, dest_l1_line, dest_l2_tag, dest_l2_line);
-
-        int l2_empty_way = find_empty_way(l2_cache, L2_CACHE, dest_l2_line);
-        uint8_t l2_cold_start = (l2_empty_way != -1);
-        if (l2_cold_start) {
-            l2_cache_entry_t* empty_l2_entry = my_cache_entry(l2_cache, L2_CACHE, dest_l2_line, l2_empty_way);
-            TRANSFER_ENTRY_INFO(empty_l2_entry, &old_l1_entry, dest_l2_tag);
-            recompute_ages(l2_cache, L2_CACHE, dest_l2_line, l2_empty_way, l2_cold_start, replace);
-        } else {
-            uint8_t l2_oldest_way = find_oldest_way(l2_cache, L2_CACHE, dest_l2_line);
-            l2_cache_entry_t* oldest_l2_entry = my_cache_entry(l2_cache, L2_CACHE, dest_l2_line, l2_oldest_way);
-            TRANSFER_ENTRY_INFO(oldest_l2_entry, &old_l1_entry, dest_l2_tag);
-            recompute_ages(l2_cache, L2_CACHE, dest_l2_line, l2_oldest_way, l2_cold_start, replace);
-        }
+// On a sector miss in L2 (its copy of the line lacks the sector of the
+// address), lays the sectors of the L2 copy over a line filled from below
+// L2, as they may be more recent. An exclusive L2 gives them (and its
+// dirty bit) away, the other ones keep them.
+static inline void merge_l2_sectors(void* l2_cache, const cache_config_t* l2_config,
+                                    uint32_t phy_addr, cache_entry_t* entry) {
+    uint16_t l2_line = extract_line_select(phy_addr, l2_config);
+    int way = find_way(l2_cache, l2_config, l2_line, extract_tag(phy_addr, l2_config));
+    if (way == -1) return;
+
+    uint8_t valid = cache_valid(l2_cache, l2_config, l2_line, way);
+    cache_copy_sectors(l2_config, entry->line, cache_line(l2_cache, l2_config, l2_line, way), valid);
+    entry->v |= valid;
+    if (l2_config->inclusion == CACHE_EXCLUSIVE) {
+        entry->d |= cache_dirty(l2_cache, l2_config, l2_line, way);
+        cache_valid(l2_cache, l2_config, l2_line, way) = 0;
+        CACHE_STAT(l2_cache, l2_config, invalidations);
     }
 }
 
-// Performs everything to correctly set a l1_cache_entry from a given src_entry (an initialised struct containing the wanted info)
-static inline void handle_mem_to_l1(void* l1_cache, void* l2_cache, uint16_t dest_l1_line, l1_dcache_entry_t* src_entry, cache_replace_t replace) {
-    uint32_t dest_l1_tag = src_entry->tag;
+// Fills a line from below L2 (L3 or memory) into L1 (and into a
+// non-exclusive L2), with the sectors of the L2 copy (if any) laid
+// over it; returns the L1 way
+static inline uint8_t handle_fill_to_l1(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                        void* l2_cache, const cache_config_t* l2_config,
+                                        uint32_t phy_addr, cache_entry_t* src_entry, cache_replace_t replace) {
+    if (l2_config->sectors > 1) merge_l2_sectors(l2_cache, l2_config, phy_addr, src_entry);
+    if (l2_config->inclusion != CACHE_EXCLUSIVE) {
+        CACHE_STAT(l2_cache, l2_config, fills);
+        insert_l2(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, src_entry->line, src_entry->v,
+                  0, replace);
+    }
+    return handle_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr,
+                        src_entry->line, src_entry->v, src_entry->d, replace);
+}
 
-    // Searching where to place old_l1_entry
-    int l1_empty_way = find_empty_way(l1_cache, L1_ICACHE, dest_l1_line);
-    uint8_t l1_cold_start = (l1_empty_way != -1);
+// Fills a line (its sector if sectored) from memory into L1 (and into a
+// non-exclusive L2); returns the L1 way
+static inline uint8_t handle_mem_to_l1(void* mem_space, void* l1_cache, const cache_config_t* l1_config,
+                                       void* l2_cache, const cache_config_t* l2_config,
+                                       uint32_t phy_addr, cache_entry_t* src_entry, cache_replace_t replace) {
+    CACHE_STAT(l1_cache, l1_config, fills);
+    cache_state(l1_cache, l1_config)->stats.mem_read_bytes += sector_bytes(src_entry->v, l1_config);
+    return handle_fill_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, src_entry, replace);
+}
 
-    if (l1_cold_start) {
-        l1_icache_entry_t* l1_empty_entry = my_cache_entry(l1_cache, L1_ICACHE, dest_l1_line, l1_empty_way);
-        TRANSFER_ENTRY_INFO(l1_empty_entry, src_entry, dest_l1_tag);
-        recompute_ages(l1_cache, L1_ICACHE, dest_l1_line, l1_empty_way, l1_cold_start, replace);
-    } else {
-        uint8_t l1_oldest_way = find_oldest_way(l1_cache, L1_ICACHE, dest_l1_line);
-        l1_icache_entry_t* old_l1_entry_ptr = my_cache_entry(l1_cache, L1_ICACHE, dest_l1_line, l1_oldest_way);
-        l1_icache_entry_t old_l1_entry = *old_l1_entry_ptr;
-
-        TRANSFER_ENTRY_INFO(old_l1_entry_ptr, src_entry, dest_l1_tag);
-        recompute_ages(l1_cache, L1_ICACHE, dest_l1_line, l1_oldest_way, l1_cold_start, replace);
-
-        // =========== look for space in l2 cache =============
-        uint32_t dest_l2_tag; uint16_t dest_l2_line; // Fining index for l2_cache
-        L1_LINETAG_TO_L2_LINETAG(old_l1_entry.tag, dest_l1_line, dest_l2_tag, dest_l2_line);
-
-        int l2_empty_way = find_empty_way(l2_cache, L2_CACHE, dest_l2_line);
-        uint8_t l2_cold_start = (l2_empty_way != -1);
-        if (l2_cold_start) {
-            l2_cache_entry_t* empty_l2_entry = my_cache_entry(l2_cache, L2_CACHE, dest_l2_line, l2_empty_way);
-            TRANSFER_ENTRY_INFO(empty_l2_entry, &old_l1_entry, dest_l2_tag);
-            recompute_ages(l2_cache, L2_CACHE, dest_l2_line, l2_empty_way, l2_cold_start, replace);
-        } else {
-            uint8_t l2_oldest_way = find_oldest_way(l2_cache, L2_CACHE, dest_l2_line);
-            l2_cache_entry_t* oldest_l2_entry = my_cache_entry(l2_cache, L2_CACHE, dest_l2_line, l2_oldest_way);
-            TRANSFER_ENTRY_INFO(oldest_l2_entry, &old_l1_entry, dest_l2_tag);
-            recompute_ages(l2_cache, L2_CACHE, dest_l2_line, l2_oldest_way, l2_cold_start, replace);
+/**
+ * @brief Reads a line missing from L2 from the level below it: L3 if one
+ *        is attached to L2 (see cache_attach_lower()), memory otherwise.
+ *        An exclusive L3 gives the line (and its dirty bit) away; the other
+ *        ones keep it, and are filled with it on a miss. Memory only gives
+ *        the sector of the address to a sectored cache.
+ * @param demand whether the L3 lookup is counted in its statistics and
+ *        replacement state (demand access) or not (prefetch)
+ * @param entry (modified) the line, its valid sectors and its dirty bit
+ * @param from_mem (modified) whether the line came from memory
+ * @return error code
+ */
+static int fetch_below_l2(void* mem_space, const phy_addr_t* paddr,
+                          void* l2_cache, const cache_config_t* l2_config,
+                          int demand, cache_entry_t* entry, int* from_mem) {
+    const cache_state_t* state = cache_state(l2_cache, l2_config);
+    void* l3_cache = state->lower;
+    const cache_config_t* l3_config = state->lower_config;
+    cache_replace_t l3_replace = (cache_replace_t) state->lower_replace;
+    uint32_t phy_addr = get_addr(paddr);
+    *from_mem = 1;
+
+    if (l3_cache != NULL) {
+        // *** L2 Miss - Searching Level 3 Cache ***
+        debug_print("%s", "L2 Miss - Searching Level 3 Cache");
+        uint16_t l3_line = extract_line_select(phy_addr, l3_config);
+        int way = demand ? lookup(l3_cache, l3_config, phy_addr, l3_replace)
+                         : find_sector(l3_cache, l3_config, phy_addr);
+
+        if (way != -1) {
+            debug_print("%s", "L3 Hit!");
+            memcpy(entry->line, cache_line(l3_cache, l3_config, l3_line, way), l3_config->payload_size);
+            entry->v = cache_valid(l3_cache, l3_config, l3_line, way);
+            entry->d = 0;
+            CACHE_STAT(l3_cache, l3_config, promotions);
+            if (l3_config->inclusion == CACHE_EXCLUSIVE) {
+                entry->d = cache_dirty(l3_cache, l3_config, l3_line, way);
+                cache_valid(l3_cache, l3_config, l3_line, way) = 0;
+                CACHE_STAT(l3_cache, l3_config, invalidations);
+            }
+            *from_mem = 0;
+            return ERR_NONE;
         }
     }
+
+    // *** Searching Memory
+    debug_print("%s", "Searching Memory");
+    M_EXIT_IF_ERR_NOMSG(cache_entry_init(mem_space, paddr, entry, l2_config));
+    if (l3_cache != NULL && l3_config->inclusion != CACHE_EXCLUSIVE) {
+        CACHE_STAT(l3_cache, l3_config, fills);
+        insert_l3(mem_space, l3_cache, l3_config, phy_addr, entry->line, entry->v, 0, l3_replace);
+    }
+    return ERR_NONE;
 }
 
-// Writes data "through the cache"
-static inline void write_though(void* mem_space, uint32_t phy_addr, const uint32_t* p_line) {
-    word_t* start = find_line_in_mem(mem_space, phy_addr);
-    memcpy(start, p_line, sizeof(word_t) * L1_ICACHE_WORDS_PER_LINE);
+/**
+ * @brief Brings the line of an address into L1 (from L2 or memory) as
+ *        required by the inclusion policy of L2.
+ * @param line_index (modified) the L1 line (set) of the address
+ * @param way (modified) the L1 way holding the line
+ * @return error code
+ */
+static int fetch_to_l1(void* mem_space, phy_addr_t* paddr,
+                       void* l1_cache, const cache_config_t* l1_config,
+                       void* l2_cache, const cache_config_t* l2_config,
+                       cache_replace_t replace, uint16_t* line_index, uint8_t* way) {
+    uint32_t phy_addr = get_addr(paddr);
+
+    // *** Searching Level 1 Cache ***
+    debug_print("%s", "Searching Level 1 Cache");
+    *line_index = extract_line_select(phy_addr, l1_config);
+    int hit_way = lookup(l1_cache, l1_config, phy_addr, replace);
+    if (hit_way != -1) {
+        debug_print("%s", "L1 Hit!");
+        *way = (uint8_t) hit_way;
+        return ERR_NONE;
+    }
+
+    // *** L1 Miss - Searching Level 2 Cache ***
+    debug_print("%s", "L1 Miss - Searching Level 2 Cache");
+    hit_way = lookup(l2_cache, l2_config, phy_addr, replace);
+    if (hit_way != -1) {
+        debug_print("%s", "L2 Hit!");
+        *way = handle_l2_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config,
+                               extract_line_select(phy_addr, l2_config), (uint8_t) hit_way, replace);
+        return ERR_NONE;
+    }
+
+    // *** L2 Miss - Searching L3 (if any), then Memory
+    word_t entry_buffer[(sizeof(cache_entry_t) + CACHE_MAX_LINE_SIZE) / sizeof(word_t)];
+    cache_entry_t* new_entry = (cache_entry_t*) entry_buffer;
+    int from_mem = 1;
+    M_EXIT_IF_ERR_NOMSG(fetch_below_l2(mem_space, paddr, l2_cache, l2_config, 1, new_entry, &from_mem));
+    *way = from_mem ? handle_mem_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, new_entry, replace)
+                    : handle_fill_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, new_entry, replace);
+
+    return ERR_NONE;
 }
 
 //=========================================================================
-#define PRINT_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
+#define PRINT_CACHE_LINE(OUTFILE, CACHE, CONFIG, LINE_INDEX, WAY) \
     do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: %1" PRIx8 ", TAG: 0x%03" PRIx16 ", values: ( ", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_age(TYPE, WAYS, LINE_INDEX, WAY), \
-                        cache_tag(TYPE, WAYS, LINE_INDEX, WAY)); \
-            for(int i_ = 0; i_ < WORDS_PER_LINE; i_++) \
-                fprintf(OUTFILE, "0x%08" PRIx32 " ", \
-                        cache_line(TYPE, WAYS, LINE_INDEX, WAY)[i_]); \
+            fprintf(OUTFILE, "V: %1" PRIx8 ", ", cache_valid(CACHE, CONFIG, LINE_INDEX, WAY)); \
+            if ((CONFIG)->write_back) \
+                fprintf(OUTFILE, "D: %1" PRIx8 ", ", cache_dirty(CACHE, CONFIG, LINE_INDEX, WAY)); \
+            fprintf(OUTFILE, "AGE: %1" PRIx8 ", TAG: 0x%03" PRIx32 ", values: ( ", \
+                        cache_age(CACHE, CONFIG, LINE_INDEX, WAY), \
+                        cache_tag(CACHE, CONFIG, LINE_INDEX, WAY)); \
+            for(int i_ = 0; i_ < (CONFIG)->payload_size / (CONFIG)->word_size; i_++) { \
+                if (cache_valid(CACHE, CONFIG, LINE_INDEX, WAY) & (1u << ((i_ * (CONFIG)->word_size) >> (CONFIG)->sector_bits))) \
+                    fprintf(OUTFILE, "0x%08" PRIx32 " ", \
+                            cache_line(CACHE, CONFIG, LINE_INDEX, WAY)[i_]); \
+                else \
+                    fputs("---------- ", OUTFILE); \
+            } \
             fputs(")\n", OUTFILE); \
     } while(0)
 
-#define PRINT_INVALID_CACHE_LINE(OUTFILE, TYPE, WAYS, LINE_INDEX, WAY, WORDS_PER_LINE) \
+#define PRINT_INVALID_CACHE_LINE(OUTFILE, CACHE, CONFIG, LINE_INDEX, WAY) \
     do { \
-            fprintf(OUTFILE, "V: %1" PRIx8 ", AGE: -, TAG: -----, values: ( ---------- ---------- ---------- ---------- )\n", \
-                        cache_valid(TYPE, WAYS, LINE_INDEX, WAY)); \
+            fprintf(OUTFILE, "V: %1" PRIx8 ", %sAGE: -, TAG: -----, values: ( ", \
+                        cache_valid(CACHE, CONFIG, LINE_INDEX, WAY), \
+                        (CONFIG)->write_back ? "D: -, " : ""); \
+            for(int i_ = 0; i_ < (CONFIG)->payload_size / (CONFIG)->word_size; i_++) \
+                fputs("---------- ", OUTFILE); \
+            fputs(")\n", OUTFILE); \
     } while(0)
 
-#define DUMP_CACHE_TYPE(OUTFILE, TYPE, WAYS, LINES, WORDS_PER_LINE)  \
+#define DUMP_CACHE_TYPE(OUTFILE, CACHE, CONFIG)  \
     do { \
-        for(uint16_t index = 0; index < LINES; index++) { \
-            foreach_way(way, WAYS) { \
-                fprintf(output, "%02" PRIx8 "/%04" PRIx16 ": ", way, index); \
-                if(cache_valid(TYPE, WAYS, index, way)) \
-                    PRINT_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE); \
+        for(uint16_t index = 0; index < (CONFIG)->lines; index++) { \
+            foreach_way(way, (CONFIG)->ways) { \
+                fprintf(OUTFILE, "%02" PRIx8 "/%04" PRIx16 ": ", way, index); \
+                if(cache_valid(CACHE, CONFIG, index, way)) \
+                    PRINT_CACHE_LINE(OUTFILE, CACHE, CONFIG, index, way); \
                 else \
-                    PRINT_INVALID_CACHE_LINE(OUTFILE, const TYPE, WAYS, index, way, WORDS_PER_LINE);\
+                    PRINT_INVALID_CACHE_LINE(OUTFILE, CACHE, CONFIG, index, way);\
             } \
         } \
     } while(0)
 
 //=========================================================================
 // see cache_mng.h
-int cache_dump(FILE* output, const void* cache, cache_t cache_type) {
+int cache_dump(FILE* output, const void* cache, const cache_config_t * config) {
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    fputs(config->write_back ? "WAY/LINE: V: D: AGE: TAG: WORDS\n" : "WAY/LINE: V: AGE: TAG: WORDS\n", output);
+    DUMP_CACHE_TYPE(output, cache, config);
+    putc('\n', output);
+
+    return ERR_NONE;
+}
+
+int cache_config_init(cache_config_t * config,
+                      uint16_t lines,
+                      uint8_t ways,
+                      uint8_t line_size,
+                      uint8_t word_size) {
+    M_REQUIRE_NON_NULL(config);
+    M_REQUIRE(IS_POWER_OF_2(lines) && lines <= CACHE_MAX_LINES, ERR_SIZE,
+              "lines (%" PRIu16 ") must be a power of 2 <= %u", lines, CACHE_MAX_LINES);
+    M_REQUIRE(ways != 0 && ways <= CACHE_MAX_WAYS, ERR_SIZE,
+              "ways (%" PRIu8 ") must be in [1, %u]", ways, CACHE_MAX_WAYS);
+    M_REQUIRE(word_size == sizeof(word_t), ERR_SIZE,
+              "word_size (%" PRIu8 ") must be %zu", word_size, sizeof(word_t));
+    M_REQUIRE(IS_POWER_OF_2(line_size) && line_size >= word_size && line_size <= CACHE_MAX_LINE_SIZE,
+              ERR_SIZE, "line_size (%" PRIu8 ") must be a power of 2 in [word_size, %u]",
+              line_size, CACHE_MAX_LINE_SIZE);
+
+    zero_init_ptr(config);
+    config->lines = lines;
+    config->ways = ways;
+    config->line_size = line_size;
+    config->word_size = word_size;
+
+    config->words_per_line = line_size / word_size;
+    config->word_bits = log2_u32(word_size);
+    config->line_bits = log2_u32(line_size);
+    config->index_bits = log2_u32(lines);
+    config->tag_remaining_bits = config->line_bits + config->index_bits;
+    config->sector_size = line_size;
+    config->sectors = 1;
+    config->sector_bits = config->line_bits;
+    config->payload_size = line_size;
+    config->entry_size = sizeof(cache_entry_t) + line_size;
+
+    return cache_config_set_layout(config, CACHE_LAYOUT_AOS);
+}
+
+int cache_config_set_write_back(cache_config_t * config, int write_back) {
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    config->write_back = (write_back != 0);
+    return ERR_NONE;
+}
+
+int cache_config_set_sector_size(cache_config_t * config, uint8_t sector_size) {
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(sector_size == config->line_size
+              || (IS_POWER_OF_2(sector_size) && sector_size >= CACHE_MIN_SECTOR_SIZE
+                  && sector_size < config->line_size && config->line_size / sector_size <= CACHE_MAX_SECTORS),
+              ERR_SIZE, "sector_size (%" PRIu8 ") must be the line size or a power of 2 >= %u"
+              " splitting a line in at most %u sectors", sector_size, CACHE_MIN_SECTOR_SIZE, CACHE_MAX_SECTORS);
+
+    config->sector_size = sector_size;
+    config->sectors = (uint8_t) (config->line_size / sector_size);
+    config->sector_bits = log2_u32(sector_size);
+    return ERR_NONE;
+}
+
+int cache_config_set_inclusion(cache_config_t * config, cache_inclusion_t inclusion) {
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(inclusion == CACHE_EXCLUSIVE || inclusion == CACHE_INCLUSIVE || inclusion == CACHE_NINE,
+              ERR_BAD_PARAMETER, "%d: unknown inclusion policy", inclusion);
+
+    config->inclusion = inclusion;
+    return ERR_NONE;
+}
+
+int cache_attach_upper(void * cache, const cache_config_t * config,
+                       void * upper, const cache_config_t * upper_config) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(upper);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE_CACHE_CONFIG(upper_config);
+
+    cache_state_t* state = cache_state(cache, config);
+    M_REQUIRE(state->nb_upper < CACHE_MAX_UPPER, ERR_SIZE, "at most %u upper caches", CACHE_MAX_UPPER);
+    state->upper[state->nb_upper] = upper;
+    state->upper_config[state->nb_upper] = upper_config;
+    ++state->nb_upper;
+
+    return ERR_NONE;
+}
+
+int cache_attach_lower(void * cache, const cache_config_t * config,
+                       void * lower, const cache_config_t * lower_config,
+                       cache_replace_t lower_replace) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(lower);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE_CACHE_CONFIG(lower_config);
+    M_REQUIRE(config->line_size == lower_config->line_size, ERR_BAD_PARAMETER, "%s", "line sizes differ");
+    M_REQUIRE(config->sector_size == lower_config->sector_size, ERR_BAD_PARAMETER, "%s", "sector sizes differ");
+    M_REQUIRE(config->tag_only == lower_config->tag_only, ERR_BAD_PARAMETER, "%s", "tag-only modes differ");
+    M_REQUIRE(config->write_back == lower_config->write_back, ERR_BAD_PARAMETER, "%s", "write policies differ");
+    M_REQUIRE_REPLACE(lower_config, lower_replace);
+
+    cache_state_t* state = cache_state(cache, config);
+    state->lower = lower;
+    state->lower_config = lower_config;
+    state->lower_replace = (uint8_t) lower_replace;
+
+    return ERR_NONE;
+}
+
+int cache_config_set_tag_only(cache_config_t * config, int tag_only) {
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    config->tag_only = (tag_only != 0);
+    config->payload_size = config->tag_only ? 0 : config->line_size;
+    config->entry_size = sizeof(cache_entry_t) + config->payload_size;
+
+    return cache_config_set_layout(config, config->layout);
+}
+
+int cache_config_set_layout(cache_config_t * config, cache_layout_t layout) {
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(layout == CACHE_LAYOUT_AOS || layout == CACHE_LAYOUT_SOA, ERR_BAD_PARAMETER,
+              "%d: unknown cache layout", layout);
+
+    config->layout = layout;
+    config->set_size = 0;
+    config->data_offset = 0;
+
+    if (layout == CACHE_LAYOUT_SOA) {
+        // tags, valid bits and ages of a set; packed several per host
+        // line when small, otherwise padded to whole host lines
+        size_t tag_block = (size_t) config->ways * (sizeof(uint32_t) + 3 * sizeof(uint8_t));
+        size_t set_size = sizeof(uint32_t);
+        while (set_size < tag_block && set_size < CACHE_HOST_LINE) set_size <<= 1;
+        if (set_size < tag_block) {
+            set_size = (tag_block + CACHE_HOST_LINE - 1) / CACHE_HOST_LINE * CACHE_HOST_LINE;
+        }
+        config->set_size = set_size;
+        config->data_offset = (set_size * config->lines + CACHE_HOST_LINE - 1)
+                              / CACHE_HOST_LINE * CACHE_HOST_LINE;
+        config->meta_offset = config->data_offset + (size_t) config->lines * config->ways * config->payload_size;
+    } else {
+        config->meta_offset = (size_t) config->lines * config->ways * config->entry_size;
+    }
+    config->meta_offset = (config->meta_offset + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    config->hint_offset = config->meta_offset + (size_t) config->lines * sizeof(uint64_t);
+    config->state_offset = (config->hint_offset + config->lines + sizeof(uint64_t) - 1)
+                           / sizeof(uint64_t) * sizeof(uint64_t);
+
+    return ERR_NONE;
+}
+
+int cache_replace_supported(const cache_config_t * config, cache_replace_t replace) {
+    if (config == NULL) return 0;
+    switch (replace) {
+    case LRU:
+    case SRRIP:
+    case BRRIP:
+    case DRRIP:
+        return 1;
+    case PLRU_TREE:
+        return IS_POWER_OF_2(config->ways) && config->ways <= PLRU_MAX_WAYS;
+    case PLRU_BIT:
+        return config->ways <= PLRU_MAX_WAYS;
+    default:
+        return 0;
+    }
+}
 
-    fputs("WAY/LINE: V: AGE: TAG: WORDS\n", output);
+int cache_config_default(cache_config_t * config, cache_t cache_type) {
     switch (cache_type) {
     case L1_ICACHE:
-        DUMP_CACHE_TYPE(output, l1_icache_entry_t, L1_ICACHE_WAYS,
-                        L1_ICACHE_LINES, L1_ICACHE_WORDS_PER_LINE);
-        break;
+        return cache_config_init(config, L1_ICACHE_LINES, L1_ICACHE_WAYS, L1_ICACHE_LINE, sizeof(word_t));
     case L1_DCACHE:
-        DUMP_CACHE_TYPE(output, l1_dcache_entry_t, L1_DCACHE_WAYS,
-                        L1_DCACHE_LINES, L1_DCACHE_WORDS_PER_LINE);
-        break;
+        return cache_config_init(config, L1_DCACHE_LINES, L1_DCACHE_WAYS, L1_DCACHE_LINE, sizeof(word_t));
     case L2_CACHE:
-        DUMP_CACHE_TYPE(output, l2_cache_entry_t, L2_CACHE_WAYS,
-                        L2_CACHE_LINES, L2_CACHE_WORDS_PER_LINE);
-        break;
+        return cache_config_init(config, L2_CACHE_LINES, L2_CACHE_WAYS, L2_CACHE_LINE, sizeof(word_t));
+    case L3_CACHE:
+        return cache_config_init(config, L3_CACHE_LINES, L3_CACHE_WAYS, L3_CACHE_LINE, sizeof(word_t));
     default:
         debug_print("%d: unknown cache type", cache_type);
         return ERR_BAD_PARAMETER;
     }
-    putc('\n', output);
+}
+
+size_t cache_size(const cache_config_t * config) {
+    return config == NULL ? 0 : config->state_offset + sizeof(cache_state_t);
+}
+
+int cache_alloc(void ** cache, const cache_config_t * config) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    // aligned on host lines so that SoA tag blocks do not straddle two of them
+    size_t size = (cache_size(config) + CACHE_HOST_LINE - 1) / CACHE_HOST_LINE * CACHE_HOST_LINE;
+    M_EXIT_IF_NULL(*cache = aligned_alloc(CACHE_HOST_LINE, size), size);
+    memset(*cache, 0, size);
+
+    return cache_flush(*cache, config);
+}
+
+int cache_clean(void * mem_space, void * cache, const cache_config_t * config) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(mem_space != NULL || config->tag_only, ERR_BAD_PARAMETER, "%s", "mem_space is NULL");
+
+    for (uint16_t line_index = 0; line_index < config->lines; ++line_index) {
+        foreach_way(way, config->ways) {
+            if (cache_valid(cache, config, line_index, way) && cache_dirty(cache, config, line_index, way)) {
+                CACHE_STAT(cache, config, writebacks);
+                write_line_to_mem(mem_space, cache, config,
+                                  line_addr(cache_tag(cache, config, line_index, way), line_index, config),
+                                  cache_line(cache, config, line_index, way),
+                                  cache_valid(cache, config, line_index, way));
+                cache_dirty(cache, config, line_index, way) = 0;
+            }
+        }
+    }
+    return ERR_NONE;
+}
 
+int cache_stats_get(const void * cache, const cache_config_t * config, cache_stats_t * stats) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(stats);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    *stats = cache_state(cache, config)->stats;
+    return ERR_NONE;
+}
+
+int cache_stats_reset(void * cache, const cache_config_t * config) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    zero_init_var(cache_state(cache, config)->stats);
+    return ERR_NONE;
+}
+
+int cache_set_classifier(void * cache, const cache_config_t * config, miss_class_t * classifier) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(classifier == NULL || (UINT32_C(1) << classifier->line_bits) == config->line_size,
+              ERR_BAD_PARAMETER, "%s", "classifier line size differs from the cache one");
+
+    cache_state(cache, config)->classifier = classifier;
+    return ERR_NONE;
+}
+
+int cache_set_heat(void * cache, const cache_config_t * config, heat_level_t * heat) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(heat == NULL || heat->nb_sets == config->lines, ERR_BAD_PARAMETER, "%s",
+              "heat map sets differ from the cache ones");
+
+    cache_state(cache, config)->heat = heat;
+    return ERR_NONE;
+}
+
+int cache_stats_add(void * cache, const cache_config_t * config, const cache_stats_t * stats) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE_NON_NULL(stats);
+
+    cache_stats_t* s = &cache_state(cache, config)->stats;
+    s->hits += stats->hits;
+    s->misses += stats->misses;
+    s->sector_misses += stats->sector_misses;
+    s->mru_hits += stats->mru_hits;
+    s->evictions += stats->evictions;
+    s->promotions += stats->promotions;
+    s->victim_inserts += stats->victim_inserts;
+    s->fills += stats->fills;
+    s->invalidations += stats->invalidations;
+    s->writebacks += stats->writebacks;
+    s->mem_read_bytes += stats->mem_read_bytes;
+    s->mem_write_bytes += stats->mem_write_bytes;
+    return ERR_NONE;
+}
+
+int cache_copy_sets(void * cache, const void * from, const cache_config_t * config,
+                    uint16_t mask, uint16_t residue) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(from);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    for (uint32_t line_index = residue & mask; line_index < config->lines; line_index += (uint32_t) mask + 1) {
+        if (config->layout == CACHE_LAYOUT_SOA) {
+            memcpy(cache_soa_tags(cache, config, line_index), cache_soa_tags(from, config, line_index),
+                   config->set_size);
+            memcpy(cache_soa_line(cache, config, line_index, 0), cache_soa_line(from, config, line_index, 0),
+                   (size_t) config->ways * config->payload_size);
+        } else {
+            memcpy(cache_entry(cache, config, line_index, 0), cache_entry(from, config, line_index, 0),
+                   (size_t) config->ways * config->entry_size);
+        }
+        cache_set_meta(cache, config, line_index) = cache_set_meta(from, config, line_index);
+        cache_set_hint(cache, config, line_index) = cache_set_hint(from, config, line_index);
+    }
+    return ERR_NONE;
+}
+
+int cache_save(FILE* output, const void * cache, const cache_config_t * config) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    const cache_state_t* state = cache_state(cache, config);
+    M_REQUIRE(fwrite(cache, config->state_offset, 1, output) == 1
+              && fwrite(&state->stats, sizeof(state->stats), 1, output) == 1
+              && fwrite(&state->psel, sizeof(state->psel), 1, output) == 1
+              && fwrite(&state->brrip_tick, sizeof(state->brrip_tick), 1, output) == 1,
+              ERR_IO, "%s", "cannot write the cache");
+    return ERR_NONE;
+}
+
+int cache_load(FILE* input, void * cache, const cache_config_t * config) {
+    M_REQUIRE_NON_NULL(input);
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    cache_state_t* state = cache_state(cache, config);
+    M_REQUIRE(fread(cache, config->state_offset, 1, input) == 1
+              && fread(&state->stats, sizeof(state->stats), 1, input) == 1
+              && fread(&state->psel, sizeof(state->psel), 1, input) == 1
+              && fread(&state->brrip_tick, sizeof(state->brrip_tick), 1, input) == 1,
+              ERR_IO, "%s", "cannot read the cache");
+    return ERR_NONE;
+}
+
+int cache_stats_print(FILE* output, const char* name, const cache_stats_t * stats) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(stats);
+
+    uint64_t accesses = stats->hits + stats->misses;
+    fprintf(output, "%-9s: accesses: %" PRIu64 ", hits: %" PRIu64 ", misses: %" PRIu64
+            " (%.2f%%), sector misses: %" PRIu64 ", MRU way hits: %" PRIu64 " (%.2f%%), evictions: %" PRIu64 ", promotions: %" PRIu64
+            ", victim inserts: %" PRIu64 ", fills: %" PRIu64 ", invalidations: %" PRIu64
+            ", write-backs: %" PRIu64
+            ", memory bytes read: %" PRIu64 ", written: %" PRIu64 "\n",
+            name, accesses, stats->hits, stats->misses,
+            accesses == 0 ? 0.0 : 100.0 * (double) stats->misses / (double) accesses,
+            stats->sector_misses, stats->mru_hits, stats->hits == 0 ? 0.0 : 100.0 * (double) stats->mru_hits / (double) stats->hits,
+            stats->evictions, stats->promotions, stats->victim_inserts, stats->fills,
+            stats->invalidations, stats->writebacks, stats->mem_read_bytes, stats->mem_write_bytes);
     return ERR_NONE;
 }
 
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
                      void * cache_entry,
-                     cache_t cache_type) {
-    M_REQUIRE_NON_NULL(mem_space);
+                     const cache_config_t * config) {
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(cache_entry);
-    M_REQUIRE(cache_type == L1_ICACHE || cache_type == L1_DCACHE || cache_type == L2_CACHE,
-              ERR_BAD_PARAMETER, "%s", "tlb has non existing type");
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(mem_space != NULL || config->tag_only, ERR_BAD_PARAMETER, "%s", "mem_space is NULL");
 
     uint32_t phy_addr = get_addr(paddr);
 
-    uint32_t tag;
-
-    const word_t* start = find_line_in_mem(mem_space, phy_addr);
-
-    #define M_CACHE_ENTRY_INIT(m_cache_type) \
-        tag = phy_addr >> m_cache_type ## _TAG_REMAINING_BITS; \
-        M_CACHE_ENTRY_T(m_cache_type)* cast_entry = (M_CACHE_ENTRY_T(m_cache_type)*)cache_entry; \
-        cast_entry->tag = tag; \
-        cast_entry->age = (uint8_t) 0; \
-        cast_entry->v = (uint8_t) 1; \
-        memcpy(cast_entry->line, start, sizeof(word_t) * m_cache_type ## _WORDS_PER_LINE);
-
-    M_EXPAND_ALL_CACHE_TYPES(M_CACHE_ENTRY_INIT);
-    #undef M_CACHE_ENTRY_INIT
+    cache_entry_t* cast_entry = cache_entry;
+    cast_entry->tag = extract_tag(phy_addr, config);
+    cast_entry->age = (uint8_t) 0;
+    cast_entry->v = cache_sector_bit(config, phy_addr);
+    cast_entry->d = (uint8_t) 0;
+    if (!config->tag_only) {
+        memcpy(cast_entry->line, find_line_in_mem(mem_space, phy_addr, config), config->line_size);
+    }
 
     return ERR_NONE;
 }
 
-int cache_flush(void *cache, cache_t cache_type) {
+int cache_flush(void *cache, const cache_config_t * config) {
     M_REQUIRE_NON_NULL(cache);
-    M_REQUIRE(cache_type == L1_ICACHE || cache_type == L1_DCACHE || cache_type == L2_CACHE,
-              ERR_BAD_PARAMETER, "%s", "tlb has non existing type");
-    
-    size_t cache_size;
+    M_REQUIRE_CACHE_CONFIG(config);
 
-    #define M_CACHE_FLUSH(m_cache_type) \
-        cache_size = (m_cache_type ## _LINES) * (m_cache_type ## _WAYS) * sizeof(M_CACHE_ENTRY_T(m_cache_type));
-
-    M_EXPAND_ALL_CACHE_TYPES(M_CACHE_FLUSH)
-    #undef M_CACHE_FLUSH
-
-    memset(cache, 0, cache_size);
+    // lines and replacement state; the cache-wide state but the RRIP one is kept
+    memset(cache, 0, config->state_offset);
+    cache_state(cache, config)->psel = RRIP_PSEL_MAX / 2;
+    cache_state(cache, config)->brrip_tick = 0;
     return ERR_NONE;
 }
 
@@ -355,21 +1037,15 @@ int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
                  const void * cache_line_in,
                  void * cache,
-                 cache_t cache_type) {
+                 const cache_config_t * config) {
     M_REQUIRE_NON_NULL(cache);
     M_REQUIRE_NON_NULL(cache_line_in);
-    M_REQUIRE(cache_type == L1_ICACHE || cache_type == L1_DCACHE || cache_type == L2_CACHE,
-              ERR_BAD_PARAMETER, "%s", "tlb has non existing type");
-
-    #define M_CACHE_INSERT(m_cache_type) \
-        M_REQUIRE(cache_line_index < m_cache_type ## _LINES, ERR_BAD_PARAMETER, "cache_line_index out of bounds. cache_line=%d", cache_line_index); \
-        M_REQUIRE(cache_way < m_cache_type ## _WAYS, ERR_BAD_PARAMETER, "cache_way out of bounds. cache_way=%d", cache_way); \
-        M_CACHE_ENTRY_T(m_cache_type)* cache_line = cache_entry(M_CACHE_ENTRY_T(m_cache_type), m_cache_type ## _WAYS, cache_line_index, cache_way); \
-        *cache_line = *((M_CACHE_ENTRY_T(m_cache_type)*) cache_line_in);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(cache_line_index < config->lines, ERR_BAD_PARAMETER, "cache_line_index out of bounds. cache_line=%d", cache_line_index);
+    M_REQUIRE(cache_way < config->ways, ERR_BAD_PARAMETER, "cache_way out of bounds. cache_way=%d", cache_way);
 
-    M_EXPAND_ALL_CACHE_TYPES(M_CACHE_INSERT)
+    cache_layout_kernels(config)->put(cache, config, cache_line_index, cache_way, cache_line_in);
     return ERR_NONE;
-    #undef M_CACHE_INSERT
 }
 
 int cache_hit (const void * mem_space,
@@ -378,71 +1054,25 @@ int cache_hit (const void * mem_space,
                const uint32_t ** p_line,
                uint8_t *hit_way,
                uint16_t *hit_index,
-               cache_t cache_type) {
-    //M_REQUIRE_NON_NULL(mem_space); // No test since mem_space in unused here!
+               const cache_config_t * config,
+               cache_replace_t replace) {
+    (void) mem_space; // No test since mem_space in unused here!
     M_REQUIRE_NON_NULL(cache);
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(p_line);
     M_REQUIRE_NON_NULL(hit_way);
     M_REQUIRE_NON_NULL(hit_index);
-    M_REQUIRE(cache_type == L1_ICACHE || cache_type == L1_DCACHE || cache_type == L2_CACHE,
-              ERR_BAD_PARAMETER, "%s", "tlb has non existing type");
-
-    cache_replace_t replace = LRU; // Since no argument was specified!
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE_REPLACE(config, replace);
 
     uint32_t phy_addr = get_addr(paddr);
-    uint32_t line_index;
-    uint32_t tag;
-
-    if (cache_type == L1_ICACHE) {
-        line_index = (phy_addr / L1_ICACHE_LINE) % L1_ICACHE_LINES;
-        tag = phy_addr >> L1_ICACHE_TAG_REMAINING_BITS;
-
-        foreach_way(i, L1_ICACHE_WAYS) {
-            l1_icache_entry_t* cache_entry = cache_entry(l1_icache_entry_t, L1_ICACHE_WAYS, line_index, i);
-            if (cache_entry->v && cache_entry->tag == tag) {
-                *hit_way = i;
-                *hit_index = line_index;
-                *p_line = cache_entry->line;
-
-                recompute_ages(cache, L1_ICACHE, line_index, i, 0, replace);
-
-                return ERR_NONE;
-            }
-        }
-    } else if(cache_type == L1_DCACHE) {
-		line_index = (phy_addr / L1_DCACHE_LINE) % L1_DCACHE_LINES;
-        tag = phy_addr >> L1_DCACHE_TAG_REMAINING_BITS;
-
-        foreach_way(i, L1_ICACHE_WAYS) {
-            l1_dcache_entry_t* cache_entry = cache_entry(l1_dcache_entry_t, L1_DCACHE_WAYS, line_index, i);
-            if (cache_entry->v && cache_entry->tag == tag) {
-                *hit_way = i;
-                *hit_index = line_index;
-                *p_line = cache_entry->line;
-                
-                recompute_ages(cache, L1_ICACHE, line_index, i, 0, replace);
-
-                return ERR_NONE;
-            }
-        }
-	} else if(cache_type == L2_CACHE) {
-		line_index = (phy_addr / L2_CACHE_LINE) % L2_CACHE_LINES;
-        tag = phy_addr >> L2_CACHE_TAG_REMAINING_BITS;
-
-        foreach_way(i, L2_CACHE_WAYS) {
-            l2_cache_entry_t* cache_entry = cache_entry(l2_cache_entry_t, L2_CACHE_WAYS, line_index, i);
-            if (cache_entry->v && cache_entry->tag == tag) {
-                *hit_way = i;
-                *hit_index = line_index;
-                *p_line = cache_entry->line;
-                
-                recompute_ages(cache, L2_CACHE, line_index, i, 0, replace);
-
-                return ERR_NONE;
-            }
-        }
-	}
+    int way = lookup(cache, config, phy_addr, replace);
+    if (way != -1) {
+        *hit_way = (uint8_t) way;
+        *hit_index = extract_line_select(phy_addr, config);
+        *p_line = cache_line(cache, config, *hit_index, *hit_way);
+        return ERR_NONE;
+    }
 
     // Set fields to miss if "Cache Miss"
     *hit_way = HIT_WAY_MISS;
@@ -451,209 +1081,285 @@ int cache_hit (const void * mem_space,
     return ERR_NONE;
 }
 
-int cache_read(const void * mem_space,
-               phy_addr_t * paddr,
-               mem_access_t access,
-               void * l1_cache,
-               void * l2_cache,
-               uint32_t * word,
-               cache_replace_t replace) {
-    M_REQUIRE_NON_NULL(mem_space);
+//=========================================================================
+int cache_way_hint(const void * cache, const cache_config_t * config, const phy_addr_t * paddr, uint8_t * way) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_CACHE_CONFIG(config);
     M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(l1_cache);
-    M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE_NON_NULL(word);
-    M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%s", "Non existing access type");
-    M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "%s", "Non existing replacement policy");
+    M_REQUIRE_NON_NULL(way);
 
-    uint8_t hit_way;
-    uint16_t hit_index;
-    const uint32_t* p_line;
-    uint32_t phy_addr = get_addr(paddr);
-    M_REQUIRE(phy_addr % L1_ICACHE_WORDS_PER_LINE == 0, ERR_BAD_PARAMETER, "%s", "paddr is not aligned");
+    *way = cache_set_hint(cache, config, extract_line_select(get_addr(paddr), config));
+    return ERR_NONE;
+}
 
-    debug_print("%s", "======================== cache_read() =========================");
+// Gets the first byte of a line at a phy_addr
+static inline byte_t* line_bytes(word_t* line, uint32_t phy_addr, const cache_config_t* config) {
+    return (byte_t*) line + (phy_addr & (config->line_size - 1u));
+}
 
-    // *** Searching Level 1 Cache ***
-    debug_print("%s", "Searching Level 1 Cache");
-    if (access == INSTRUCTION || access == DATA) {
-        M_EXIT_IF_ERR_NOMSG(cache_hit(mem_space, l1_cache, paddr, &p_line, &hit_way, &hit_index, L1_ICACHE));
-        if (hit_way != HIT_WAY_MISS) {
-            *word = p_line[extract_word_select(phy_addr)];
-            debug_print("%s", "L1 Hit! - return ...");
-            return ERR_NONE;
-        }
+/**
+ * @brief Reads or writes the bytes of an access that lie in one sector
+ *        (line), with a single lookup (write-allocate for writes).
+ * @param data the bytes read (0 in tag-only mode) or to write
+ * @return error code
+ */
+static int access_line(void* mem_space, phy_addr_t* paddr,
+                       void* l1_cache, const cache_config_t* l1_config,
+                       void* l2_cache, const cache_config_t* l2_config,
+                       byte_t* data, size_t size, int write, cache_replace_t replace) {
+    uint16_t line_index;
+    uint8_t way;
+    uint32_t phy_addr = get_addr(paddr);
+
+    M_EXIT_IF_ERR_NOMSG(fetch_to_l1(mem_space, paddr, l1_cache, l1_config, l2_cache, l2_config,
+                                    replace, &line_index, &way));
+    word_t* p_line = cache_line(l1_cache, l1_config, line_index, way);
+    if (!write) {
+        if (l1_config->tag_only) memset(data, 0, size);
+        else memcpy(data, line_bytes(p_line, phy_addr, l1_config), size);
+        return ERR_NONE;
     }
 
-    // *** L1 Miss - Searching Level 2 Cache ***
-    debug_print("%s", "L1 Miss - Searching Level 2 Cache");
-    M_EXIT_IF_ERR_NOMSG(cache_hit(mem_space, l2_cache, paddr, &p_line, &hit_way, &hit_index, L2_CACHE));
-    if (hit_way != HIT_WAY_MISS) {
-        debug_print("%s", "L2 Hit!");
-        if (access == INSTRUCTION || access == DATA) {
-            *word = p_line[extract_word_select(phy_addr)];
-            handle_l2_to_l1(l1_cache, l2_cache, hit_index, hit_way, replace);
+    if (!l1_config->tag_only) memcpy(line_bytes(p_line, phy_addr, l1_config), data, size);
+    if (l1_config->write_back) {
+        cache_dirty(l1_cache, l1_config, line_index, way) = 1;
+        return ERR_NONE;
+    }
 
-            return ERR_NONE;
+    write_though(mem_space, l1_cache, phy_addr, p_line, cache_sector_bit(l1_config, phy_addr), l1_config);
+    if (l2_config->inclusion != CACHE_EXCLUSIVE && !l2_config->tag_only) {
+        // keeps the L2 copy (if any) up to date
+        uint16_t l2_line = extract_line_select(phy_addr, l2_config);
+        int l2_way = find_way(l2_cache, l2_config, l2_line, extract_tag(phy_addr, l2_config));
+        if (l2_way != -1) {
+            memcpy(line_bytes(cache_line(l2_cache, l2_config, l2_line, l2_way), phy_addr, l2_config), data, size);
         }
     }
+    return ERR_NONE;
+}
 
-    // *** L2 Miss - Searching Memory
-    debug_print("%s", "L2 Miss - Searching Memory");
-    l1_icache_entry_t l1_new_entry;
-    M_EXIT_IF_ERR_NOMSG(cache_entry_init(mem_space, paddr, &l1_new_entry, L1_ICACHE));
-    p_line = l1_new_entry.line;
+/**
+ * @brief Reads or writes size bytes at any address: one lookup for each
+ *        sector (line) the access touches, from the one of the first byte
+ *        on (a line-sized access may span all the sectors of two lines).
+ * @return error code
+ */
+static int access_bytes(void* mem_space, phy_addr_t* paddr,
+                        void* l1_cache, const cache_config_t* l1_config,
+                        void* l2_cache, const cache_config_t* l2_config,
+                        byte_t* data, size_t size, int write, cache_replace_t replace) {
+    phy_addr_t sector = *paddr;
+    size_t offset = get_addr(paddr) & (l1_config->sector_size - 1u);
+    size_t done = 0;
+    while (done < size) {
+        size_t part = l1_config->sector_size - offset;
+        if (part > size - done) part = size - done;
+        M_EXIT_IF_ERR_NOMSG(access_line(mem_space, &sector, l1_cache, l1_config, l2_cache, l2_config,
+                                        data + done, part, write, replace));
+        done += part;
+        offset = 0;
+        // the next sector is in the same page
+        sector.page_offset = (uint16_t) (paddr->page_offset + done);
+    }
+    return ERR_NONE;
+}
+
+int cache_read_bytes(const void * mem_space,
+                     phy_addr_t * paddr,
+                     mem_access_t access,
+                     void * l1_cache,
+                     const cache_config_t * l1_config,
+                     void * l2_cache,
+                     const cache_config_t * l2_config,
+                     void * data,
+                     size_t size,
+                     cache_replace_t replace) {
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(data);
+    M_REQUIRE_HRCHY(mem_space, l1_config, l2_config);
+    M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%s", "Non existing access type");
+    M_REQUIRE_REPLACE(l1_config, replace);
+    M_REQUIRE_REPLACE(l2_config, replace);
+    M_REQUIRE_ACCESS_SIZE(paddr, size, l1_config);
 
-    // Inserting new_entry
-    debug_print("%s", "Inserting new_entry");
-    handle_mem_to_l1(l1_cache, l2_cache, extract_l1_line_select(phy_addr), &l1_new_entry, replace);
+    // a read may have to write back a dirty line pushed out of L2
+    return access_bytes((void*) mem_space, paddr, l1_cache, l1_config, l2_cache, l2_config,
+                        data, size, 0, replace);
+}
 
-    *word = p_line[extract_word_select(phy_addr)];
-    return ERR_NONE;
+int cache_write_bytes(void * mem_space,
+                      phy_addr_t * paddr,
+                      void * l1_cache,
+                      const cache_config_t * l1_config,
+                      void * l2_cache,
+                      const cache_config_t * l2_config,
+                      const void * data,
+                      size_t size,
+                      cache_replace_t replace) {
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(l1_cache);
+    M_REQUIRE_NON_NULL(l2_cache);
+    M_REQUIRE_NON_NULL(data);
+    M_REQUIRE_HRCHY(mem_space, l1_config, l2_config);
+    M_REQUIRE_REPLACE(l1_config, replace);
+    M_REQUIRE_REPLACE(l2_config, replace);
+    M_REQUIRE_ACCESS_SIZE(paddr, size, l1_config);
+
+    // write-allocate: each line is brought into L1, then written there
+    return access_bytes(mem_space, paddr, l1_cache, l1_config, l2_cache, l2_config,
+                        (byte_t*) data, size, 1, replace);
+}
+
+int cache_read(const void * mem_space,
+               phy_addr_t * paddr,
+               mem_access_t access,
+               void * l1_cache,
+               const cache_config_t * l1_config,
+               void * l2_cache,
+               const cache_config_t * l2_config,
+               uint32_t * word,
+               cache_replace_t replace) {
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_CACHE_CONFIG(l1_config);
+    M_REQUIRE(extract_byte_select(get_addr(paddr), l1_config) == 0, ERR_BAD_PARAMETER, "%s", "paddr is not aligned");
+
+    debug_print("%s", "======================== cache_read() =========================");
+
+    return cache_read_bytes(mem_space, paddr, access, l1_cache, l1_config, l2_cache, l2_config,
+                            word, sizeof(*word), replace);
 }
 
 int cache_read_byte(const void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
+                    const cache_config_t * l1_config,
                     void * l2_cache,
+                    const cache_config_t * l2_config,
                     uint8_t * p_byte,
                     cache_replace_t replace) {
-    M_REQUIRE_NON_NULL(mem_space);
-    M_REQUIRE_NON_NULL(p_paddr);
-    M_REQUIRE_NON_NULL(l1_cache);
-    M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE_NON_NULL(p_byte);
-    M_REQUIRE(access == INSTRUCTION || access == DATA, ERR_BAD_PARAMETER, "%s", "Non existing access type");
-    M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "%s", "Non existing replacement policy");
-
-    phy_addr_t paddr = *p_paddr;
-    paddr.page_offset = (p_paddr->page_offset - (p_paddr->page_offset % sizeof(word_t)));
-    word_t word;
-    cache_read(mem_space, &paddr, access, l1_cache, l2_cache, &word, replace);
-
-    *p_byte = ((byte_t*)(&word))[p_paddr->page_offset % sizeof(word_t)];
-
-    return ERR_NONE;
+    return cache_read_bytes(mem_space, p_paddr, access, l1_cache, l1_config, l2_cache, l2_config,
+                            p_byte, sizeof(*p_byte), replace);
 }
 
 int cache_write(void * mem_space,
                 phy_addr_t * paddr,
                 void * l1_cache,
+                const cache_config_t * l1_config,
                 void * l2_cache,
+                const cache_config_t * l2_config,
                 const uint32_t * word,
                 cache_replace_t replace) {
-
-    M_REQUIRE_NON_NULL(mem_space);
     M_REQUIRE_NON_NULL(paddr);
-    M_REQUIRE_NON_NULL(l1_cache);
-    M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE_NON_NULL(word);
+    M_REQUIRE_CACHE_CONFIG(l1_config);
+    M_REQUIRE(extract_byte_select(get_addr(paddr), l1_config) == 0, ERR_BAD_PARAMETER, "%s", "paddr is not aligned");
 
-    uint8_t hit_way;
-    uint16_t hit_index;
-    uint32_t* p_line;
-    uint32_t phy_addr = get_addr(paddr);
-    M_REQUIRE(phy_addr % L1_ICACHE_WORDS_PER_LINE == 0, ERR_BAD_PARAMETER, "%s", "paddr is not aligned");
-    uint8_t word_index = extract_word_select(phy_addr);
-    
-    // === Searching L1_DCACHE ===
-    M_EXIT_ERR_NOMSG(cache_hit(mem_space, l1_cache, paddr, (const uint32_t**) &p_line, &hit_way, &hit_index, L1_DCACHE));
-    if (hit_way != HIT_WAY_MISS) {
-        p_line[word_index] = *word;
-        recompute_ages(l1_cache, L1_DCACHE, hit_index, hit_way, 0, replace);
-        write_though(mem_space, phy_addr, p_line);
-        return ERR_NONE;
-    }
-
-    // ==========Check L2_CACHE========
-    M_EXIT_ERR_NOMSG(cache_hit(mem_space, l2_cache, paddr, (const uint32_t**) &p_line, &hit_way, &hit_index, L2_CACHE));
-    if(hit_way  != HIT_WAY_MISS) {
-        p_line[word_index] = *word;
-        recompute_ages(l2_cache, L2_CACHE, hit_index, hit_way, 0, replace);
-        handle_l2_to_l1(l1_cache, l2_cache, hit_index, hit_way, replace);
-        write_though(mem_space, phy_addr, p_line);
-    }
-
-    // ============ L1 & L2 Miss, Fetching from Memory ==================
-    l1_dcache_entry_t read_entry;
-    cache_entry_init(mem_space, paddr, &read_entry, L1_DCACHE);
-    read_entry.line[word_index] = *word;
-    write_though(mem_space, phy_addr, read_entry.line);
-
-    uint16_t l1_line = extract_l1_line_select(phy_addr);
-    handle_mem_to_l1(l1_cache, l2_cache, l1_line, &read_entry, replace);
-
-    return ERR_NONE;
+    return cache_write_bytes(mem_space, paddr, l1_cache, l1_config, l2_cache, l2_config,
+                             word, sizeof(*word), replace);
 }
 
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
                      void * l1_cache,
+                     const cache_config_t * l1_config,
                      void * l2_cache,
+                     const cache_config_t * l2_config,
                      uint8_t p_byte,
                      cache_replace_t replace) {
-    
-    M_REQUIRE_NON_NULL(mem_space);
+    return cache_write_bytes(mem_space, paddr, l1_cache, l1_config, l2_cache, l2_config,
+                             &p_byte, sizeof(p_byte), replace);
+}
+
+int cache_snoop(void * mem_space,
+                void * cache,
+                const cache_config_t * config,
+                const phy_addr_t * paddr,
+                int invalidate,
+                int * found,
+                int * dirty) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(found);
+    M_REQUIRE_NON_NULL(dirty);
+    M_REQUIRE_CACHE_CONFIG(config);
+    M_REQUIRE(mem_space != NULL || config->tag_only, ERR_BAD_PARAMETER, "%s", "mem_space is NULL");
+
+    uint8_t written = 0;
+    *found = 0;
+    snoop_line(mem_space, cache, config, get_addr(paddr), invalidate, found, &written);
+    *dirty = (written != 0);
+
+    return ERR_NONE;
+}
+
+int cache_probe(const void * cache,
+                const cache_config_t * config,
+                const phy_addr_t * paddr,
+                int * present) {
+    M_REQUIRE_NON_NULL(cache);
+    M_REQUIRE_NON_NULL(paddr);
+    M_REQUIRE_NON_NULL(present);
+    M_REQUIRE_CACHE_CONFIG(config);
+
+    uint32_t phy_addr = get_addr(paddr);
+    *present = find_way(cache, config, extract_line_select(phy_addr, config), extract_tag(phy_addr, config)) != -1;
+
+    return ERR_NONE;
+}
+
+int cache_prefetch(void * mem_space,
+                   const phy_addr_t * paddr,
+                   void * l1_cache,
+                   const cache_config_t * l1_config,
+                   void * l2_cache,
+                   const cache_config_t * l2_config,
+                   int to_l2,
+                   cache_replace_t replace,
+                   int * issued) {
     M_REQUIRE_NON_NULL(paddr);
     M_REQUIRE_NON_NULL(l1_cache);
     M_REQUIRE_NON_NULL(l2_cache);
-    M_REQUIRE(replace == LRU, ERR_BAD_PARAMETER, "%s", "Non existing replacement policy");
-
-    phy_addr_t w_paddr = *paddr;
-    w_paddr.page_offset = (paddr->page_offset - (paddr->page_offset % sizeof(word_t)));
-    word_t word;
-    cache_read(mem_space, paddr, DATA, l1_cache, l2_cache, &word, replace);
-    word |= (p_byte >> (w_paddr.page_offset % sizeof(word_t)));
-    // cache_write(mem_space, &w_paddr, l1_cache, l2_cache, &word, replace)
-    
-    return ERR_NONE;
-}               
-
-static inline void recompute_ages(void* cache, cache_t cache_type, uint16_t cache_line, uint8_t way_index, uint8_t bool_cold_start, cache_replace_t replace) {
-    if (cache_type == L1_ICACHE || cache_type == L1_DCACHE) {
-        if (replace == LRU) {
-            if (bool_cold_start) {
-                debug_print("cold_start = %d \tage_increase", bool_cold_start);
-                LRU_age_increase(l1_icache_entry_t, L1_ICACHE_WAYS, way_index, cache_line);
-            } else {
-                debug_print("cold_start = %d \tage_update", bool_cold_start);
-                LRU_age_update(l1_icache_entry_t, L1_ICACHE_WAYS, way_index, cache_line);
-            }
-        }
-    } else {
-        if (replace == LRU) {
-            if (bool_cold_start) {
-                LRU_age_increase(l2_cache_entry_t, L2_CACHE_WAYS, way_index, cache_line);    
-            } else {
-                LRU_age_update(l2_cache_entry_t, L2_CACHE_WAYS, way_index, cache_line);
-            }
+    M_REQUIRE_NON_NULL(issued);
+    M_REQUIRE_HRCHY(mem_space, l1_config, l2_config);
+    M_REQUIRE_REPLACE(l1_config, replace);
+    M_REQUIRE_REPLACE(l2_config, replace);
+
+    uint32_t phy_addr = get_addr(paddr);
+    *issued = 0;
+
+    if (find_sector(l1_cache, l1_config, phy_addr) != -1) {
+        return ERR_NONE;
+    }
+
+    uint16_t l2_line = extract_line_select(phy_addr, l2_config);
+    int l2_way = find_sector(l2_cache, l2_config, phy_addr);
+    if (l2_way != -1) {
+        if (!to_l2) {
+            handle_l2_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, l2_line, (uint8_t) l2_way, replace);
+            *issued = 1;
         }
+        return ERR_NONE;
     }
-}
 
-static inline uint8_t find_oldest_way(void* cache, cache_t cache_type, uint16_t cache_line) {
-    if (cache_type == L1_ICACHE || cache_type == L1_DCACHE) {
-        uint8_t way_max = 128;
-        uint8_t max = 0;
-        foreach_way(i, L1_ICACHE_WAYS) {
-            uint8_t age = cache_age(l1_icache_entry_t, L1_ICACHE_WAYS, cache_line, i);
-            if (max < age) {
-                max = age;
-                way_max = i;
-            }
+    word_t entry_buffer[(sizeof(cache_entry_t) + CACHE_MAX_LINE_SIZE) / sizeof(word_t)];
+    cache_entry_t* new_entry = (cache_entry_t*) entry_buffer;
+    int from_mem = 1;
+    M_EXIT_IF_ERR_NOMSG(fetch_below_l2(mem_space, paddr, l2_cache, l2_config, 0, new_entry, &from_mem));
+    if (to_l2) {
+        if (from_mem) {
+            CACHE_STAT(l2_cache, l2_config, fills);
+            cache_state(l2_cache, l2_config)->stats.mem_read_bytes += sector_bytes(new_entry->v, l2_config);
         }
-        return way_max;
+        insert_l2(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, new_entry->line, new_entry->v,
+                  new_entry->d, replace);
+    } else if (from_mem) {
+        handle_mem_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, new_entry, replace);
     } else {
-        uint8_t way_max = 128;
-        uint8_t max = 0;
-        foreach_way(i, L2_CACHE_WAYS) {
-            uint8_t age = cache_age(l2_cache_entry_t, L2_CACHE_WAYS, cache_line, i);
-            if (max < age) {
-                max = age;
-                way_max = i;
-            }
-        }
-        return way_max;
+        handle_fill_to_l1(mem_space, l1_cache, l1_config, l2_cache, l2_config, phy_addr, new_entry, replace);
     }
+    *issued = 1;
+
+    return ERR_NONE;
 }
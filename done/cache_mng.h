@@ -11,11 +11,39 @@
 #include "mem_access.h"
 #include "addr.h"
 #include "cache.h"
+#include "miss_class_mng.h"
+#include "heat_map_mng.h"
 #include <stdio.h> // for FILE
 
-enum cache_replacement_policy { LRU };
+/**
+ * @brief Replacement policies.
+ *
+ *  - LRU: true LRU, the age of every way is kept in its entry;
+ *  - PLRU_TREE: tree pseudo-LRU, ways-1 bits per set (power of 2 ways);
+ *  - PLRU_BIT: bit pseudo-LRU (MRU bits), one bit per way;
+ *  - SRRIP: static re-reference interval prediction, lines are inserted
+ *    with a long re-reference interval (scan resistant);
+ *  - BRRIP: bimodal RRIP, lines are mostly inserted with a distant
+ *    re-reference interval (thrash resistant);
+ *  - DRRIP: dynamic RRIP, a few leader sets duel SRRIP against BRRIP and
+ *    a saturating counter (PSEL) picks the winner for the other sets.
+ *
+ * Both PLRU policies keep their bits in the per-set replacement state and
+ * support at most PLRU_MAX_WAYS ways. RRIP policies keep a RRIP_RRPV_BITS
+ * re-reference prediction value (RRPV) per way in its age field.
+ */
+enum cache_replacement_policy { LRU, PLRU_TREE, PLRU_BIT, SRRIP, BRRIP, DRRIP };
 typedef enum cache_replacement_policy cache_replace_t;
 
+#define PLRU_MAX_WAYS 64u
+
+#define RRIP_RRPV_BITS   2
+#define RRIP_MAX_RRPV    ((1u << RRIP_RRPV_BITS) - 1)
+#define RRIP_BRRIP_LONG  32u   // BRRIP inserts long once every RRIP_BRRIP_LONG insertions
+#define RRIP_PSEL_BITS   10
+#define RRIP_PSEL_MAX    ((1u << RRIP_PSEL_BITS) - 1)
+#define RRIP_DUEL_PERIOD 32u   // one SRRIP and one BRRIP leader set per period
+
 #define HIT_WAY_MISS   ((uint8_t)  -1)
 #define HIT_INDEX_MISS ((uint16_t) -1)
 
@@ -27,16 +55,289 @@ typedef enum cache_replacement_policy cache_replace_t;
 #define foreach_way(var, ways) \
   for (uint8_t var = 0; var < (ways); var++)
 
+//=========================================================================
+/**
+ * @brief Initialize a cache geometry and compute its derived fields.
+ *
+ * lines and line_size must be powers of 2, line_size a multiple of
+ * word_size, and word_size must be sizeof(word_t).
+ * @param config (modified) the geometry to initialize
+ * @param lines number of sets
+ * @param ways associativity
+ * @param line_size number of bytes per line
+ * @param word_size number of bytes per word
+ * @return error code
+ */
+int cache_config_init(cache_config_t * config,
+                      uint16_t lines,
+                      uint8_t ways,
+                      uint8_t line_size,
+                      uint8_t word_size);
+
+//=========================================================================
+/**
+ * @brief Tell whether a replacement policy can be used with a geometry.
+ * @param config the cache geometry
+ * @param replace the replacement policy
+ * @return 1 if it can, 0 otherwise
+ */
+int cache_replace_supported(const cache_config_t * config, cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Change the storage layout of an initialized cache geometry.
+ *        Caches allocated with the former layout must not be used with it.
+ * @param config (modified) the geometry to update
+ * @param layout the new storage layout
+ * @return error code
+ */
+int cache_config_set_layout(cache_config_t * config, cache_layout_t layout);
+
+//=========================================================================
+/**
+ * @brief Turn the tag-only (data-less) mode of an initialized cache
+ *        geometry on or off. Caches allocated before must not be used with it.
+ *
+ * Both levels of a hierarchy must use the same mode; in tag-only mode,
+ * cache_read() and cache_write() need no memory space.
+ * @param config (modified) the geometry to update
+ * @param tag_only 1 to drop the line payloads, 0 to keep them
+ * @return error code
+ */
+int cache_config_set_tag_only(cache_config_t * config, int tag_only);
+
+//=========================================================================
+/**
+ * @brief Choose between write-through (default) and write-back for a
+ *        cache geometry. Both levels of a hierarchy must use the same policy.
+ *
+ * Write-back caches mark written lines dirty; dirty lines move with the
+ * line between L1 and L2 and reach memory only when evicted from L2 or
+ * written back by cache_clean().
+ * @param config (modified) the geometry to update
+ * @param write_back 1 for write-back, 0 for write-through
+ * @return error code
+ */
+int cache_config_set_write_back(cache_config_t * config, int write_back);
+
+//=========================================================================
+/**
+ * @brief Make a cache geometry sectored: lines are still allocated (and
+ *        evicted) whole, but each sector is filled from below on its own
+ *        when first accessed, and only the valid sectors of a line move
+ *        between the levels and to memory. All the levels of a hierarchy
+ *        must use the same sector size.
+ * @param config (modified) the geometry to update (after cache_config_init())
+ * @param sector_size bytes per sector: the line size (not sectored, the
+ *        default) or a power of 2 >= CACHE_MIN_SECTOR_SIZE splitting the
+ *        line in at most CACHE_MAX_SECTORS sectors
+ * @return error code
+ */
+int cache_config_set_sector_size(cache_config_t * config, uint8_t sector_size);
+
+//=========================================================================
+/**
+ * @brief Set the inclusion policy of a (lower level) cache geometry with
+ *        respect to the caches above it. Default is CACHE_EXCLUSIVE.
+ * @param config (modified) the geometry to update
+ * @param inclusion the inclusion policy
+ * @return error code
+ */
+int cache_config_set_inclusion(cache_config_t * config, cache_inclusion_t inclusion);
+
+//=========================================================================
+/**
+ * @brief Registers a cache as being above another one, so that an
+ *        inclusive lower cache back-invalidates it. The L1 cache passed to
+ *        cache_read()/cache_write() is always back-invalidated, attaching
+ *        is needed for the other ones (e.g. L1 ICACHE and L1 DCACHE sharing
+ *        an L2). Both caches and the upper geometry must outlive the link;
+ *        cache_flush() keeps it.
+ * @param cache the lower cache
+ * @param config its geometry
+ * @param upper the upper cache
+ * @param upper_config its geometry
+ * @return error code
+ */
+int cache_attach_upper(void * cache, const cache_config_t * config,
+                       void * upper, const cache_config_t * upper_config);
+
+//=========================================================================
+/**
+ * @brief Registers a cache as being below another one:
+ *  - below L2, an L3 cache is searched on the L2 misses before memory and
+ *    receives the lines dropped from L2 as required by its own inclusion
+ *    policy (an inclusive L3 back-invalidates the caches attached above
+ *    it with cache_attach_upper(), which must be done as well);
+ *  - below any cache, the copies of a line written to memory by this
+ *    cache are refreshed, so that attaching L1 caches to L2 keeps the L2
+ *    and L3 copies up to date.
+ * Both caches and the lower geometry must outlive the link; cache_flush()
+ * keeps it.
+ * @param cache the upper cache
+ * @param config its geometry
+ * @param lower the lower cache
+ * @param lower_config its geometry (same line size, tag-only and write policy)
+ * @param lower_replace replacement policy of the lower cache
+ * @return error code
+ */
+int cache_attach_lower(void * cache, const cache_config_t * config,
+                       void * lower, const cache_config_t * lower_config,
+                       cache_replace_t lower_replace);
+
+//=========================================================================
+/**
+ * @brief Initialize a cache geometry to the default (i7) one of a cache type.
+ * @param config (modified) the geometry to initialize
+ * @param cache_type which default to use
+ * @return error code
+ */
+int cache_config_default(cache_config_t * config, cache_t cache_type);
+
+//=========================================================================
+/**
+ * @brief Size in bytes of the storage of a cache with given geometry.
+ * @param config the cache geometry
+ * @return the size, 0 if config is NULL
+ */
+size_t cache_size(const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Allocate (and flush) the storage of a cache with given geometry.
+ *        The storage shall be released with free().
+ * @param cache (modified) pointer to the allocated cache, NULL on error
+ * @param config the cache geometry
+ * @return error code
+ */
+int cache_alloc(void ** cache, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Writes all the dirty lines of a cache back to memory and marks
+ *        them clean (the lines stay valid).
+ *
+ * With a non-exclusive L2, an L1 line and its L2 copy may both be dirty:
+ * clean L2 before L1.
+ * @param mem_space the memory space (may be NULL in tag-only mode)
+ * @param cache the cache
+ * @param config its geometry
+ * @return error code
+ */
+int cache_clean(void * mem_space, void * cache, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Copies the statistics of a cache.
+ * @param cache the cache
+ * @param config its geometry
+ * @param stats (modified) where to copy the statistics
+ * @return error code
+ */
+int cache_stats_get(const void * cache, const cache_config_t * config, cache_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Clears the statistics of a cache (its content is left untouched).
+ * @param cache the cache
+ * @param config its geometry
+ * @return error code
+ */
+int cache_stats_reset(void * cache, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Attaches a 3C miss classifier to a cache (NULL to detach it):
+ *        it then observes every access in cache_hit().
+ * @param cache the cache
+ * @param config its geometry
+ * @param classifier the classifier (kept, not copied), initialized for
+ *        the line size and capacity of the cache
+ * @return error code
+ */
+int cache_set_classifier(void * cache, const cache_config_t * config, miss_class_t * classifier);
+
+//=========================================================================
+/**
+ * @brief Attaches the heat map counters of a level to a cache (NULL to
+ *        detach them): they then count its hits, misses and evictions per set.
+ * @param cache the cache
+ * @param config its geometry
+ * @param heat the counters (kept, not copied), for the number of sets of the cache
+ * @return error code
+ */
+int cache_set_heat(void * cache, const cache_config_t * config, heat_level_t * heat);
+
+//=========================================================================
+/**
+ * @brief Adds statistics to the ones of a cache (e.g. of a copy of it
+ *        that simulated part of the accesses).
+ * @param cache the cache
+ * @param config its geometry
+ * @param stats the statistics to add
+ * @return error code
+ */
+int cache_stats_add(void * cache, const cache_config_t * config, const cache_stats_t * stats);
+
+//=========================================================================
+/**
+ * @brief Copies some sets of a cache into another one of the same
+ *        geometry: content and replacement state, not the cache-wide
+ *        state (statistics, links, DRRIP/BRRIP counters).
+ * @param cache (modified) the destination cache
+ * @param from the source cache
+ * @param config the geometry of both
+ * @param mask a power of 2 minus 1
+ * @param residue the sets copied are those whose index & mask is residue & mask
+ * @return error code
+ */
+int cache_copy_sets(void * cache, const void * from, const cache_config_t * config,
+                    uint16_t mask, uint16_t residue);
+
+//=========================================================================
+/**
+ * @brief Writes the content of a cache to a binary stream: its storage
+ *        (lines and replacement state) and the non-pointer part of its
+ *        cache-wide state (statistics, DRRIP/BRRIP counters), not its links.
+ *        The format is that of the host and of the geometry.
+ * @param output the stream to write to
+ * @param cache the cache
+ * @param config its geometry
+ * @return error code
+ */
+int cache_save(FILE* output, const void * cache, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Reads the content of a cache written by cache_save(), keeping
+ *        its links to the other caches.
+ * @param input the stream to read from
+ * @param cache (modified) the cache, of the geometry it was saved with
+ * @param config its geometry
+ * @return error code
+ */
+int cache_load(FILE* input, void * cache, const cache_config_t * config);
+
+//=========================================================================
+/**
+ * @brief Prints the statistics of a cache level on one line.
+ * @param output the stream to print to
+ * @param name the name of the level (e.g. "L1_ICACHE")
+ * @param stats the statistics to print
+ * @return error code
+ */
+int cache_stats_print(FILE* output, const char* name, const cache_stats_t * stats);
+
 //=========================================================================
 /**
  * @brief Clean a cache (invalidate, reset...).
  *
- * This function erases all cache data.
+ * This function erases all cache data. Statistics are kept, see cache_stats_reset().
  * @param cache pointer to the cache
- * @param cache_type an enum to distinguish between different caches
+ * @param config the cache geometry
  * @return error code
  */
-int cache_flush(void *cache, cache_t cache_type);
+int cache_flush(void *cache, const cache_config_t * config);
 
 //=========================================================================
 /**
@@ -45,6 +346,10 @@ int cache_flush(void *cache, cache_t cache_type);
  * On hit, update hit infos to corresponding index
  *         and update the cache-line-size chunk of data passed as the pointer to the function.
  * On miss, update hit infos to HIT_WAY_MISS or HIT_INDEX_MISS.
+ * The most recently used way of the set (see cache_way_hint()) is probed
+ * first, all the ways only if it misses; the hits on that way are counted
+ * in the mru_hits statistic. In a sectored cache, a line whose sector
+ * of paddr is not valid misses (and counts in sector_misses).
  *
  * @param mem_space starting address of the memory space
  * @param cache pointer to the beginning of the cache
@@ -52,7 +357,8 @@ int cache_flush(void *cache, cache_t cache_type);
  * @param p_line pointer to a cache-line-size chunk of data to return
  * @param hit_way (modified) cache way where hit was detected, HIT_WAY_MISS on miss
  * @param hit_index (modified) cache line index where hit was detected, HIT_INDEX_MISS on miss
- * @param cache_type to distinguish between different caches
+ * @param config the cache geometry
+ * @param replace replacement policy, updated on hit
  * @return error code
  */
 
@@ -62,7 +368,24 @@ int cache_hit (const void * mem_space,
                const uint32_t ** p_line,
                uint8_t *hit_way,
                uint16_t *hit_index,
-               cache_t cache_type);
+               const cache_config_t * config,
+               cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Gets the way predicted for an address: the most recently used
+ *        (hit or filled) way of its set, the one cache_hit() probes first.
+ *
+ * Meant for timing models of way-predicted caches: to be called before
+ * cache_hit(), a hit on the returned way takes the fast (predicted)
+ * latency, any other hit the slow one.
+ * @param cache the cache
+ * @param config its geometry
+ * @param paddr the physical address
+ * @param way (modified) the predicted way
+ * @return error code
+ */
+int cache_way_hint(const void * cache, const cache_config_t * config, const phy_addr_t * paddr, uint8_t * way);
 
 //=========================================================================
 /**
@@ -72,29 +395,32 @@ int cache_hit (const void * mem_space,
  * @param cache_way the number of the way where to insert
  * @param cache_line_in pointer to the cache line to insert
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
+ * @param config the cache geometry
  * @return error code
  */
 int cache_insert(uint16_t cache_line_index,
                  uint8_t cache_way,
                  const void * cache_line_in,
                  void * cache,
-                 cache_t cache_type);
+                 const cache_config_t * config);
 
 //=========================================================================
 /**
  * @brief Initialize a cache entry (write to the cache entry for the first time)
  *
+ * The entry is valid for the sector of paddr only (the whole line if the
+ * cache is not sectored), though all of the line is read from memory.
+ *
  * @param mem_space starting address of the memory space
  * @param paddr pointer to physical address, to extract the tag
- * @param cache_entry pointer to the entry to be initialized
- * @param cache_type to distinguish between different caches
+ * @param cache_entry pointer to the entry to be initialized (config->entry_size bytes)
+ * @param config the cache geometry
  * @return error code
  */
 int cache_entry_init(const void * mem_space,
                      const phy_addr_t * paddr,
                      void * cache_entry,
-                     cache_t cache_type);
+                     const cache_config_t * config);
 
 //=========================================================================
 /**
@@ -115,7 +441,9 @@ int cache_entry_init(const void * mem_space,
  * @param paddr pointer to a physical address
  * @param access to distinguish between fetching instructions and reading/writing data
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE (same line size as L1)
  * @param word pointer to the word of data that is returned by cache
  * @param replace replacement policy
  * @return error code
@@ -124,7 +452,9 @@ int cache_read(const void * mem_space,
                phy_addr_t * paddr,
                mem_access_t access,
                void * l1_cache,
+               const cache_config_t * l1_config,
                void * l2_cache,
+               const cache_config_t * l2_config,
                uint32_t * word,
                cache_replace_t replace);
 
@@ -136,7 +466,9 @@ int cache_read(const void * mem_space,
  * @param p_addr pointer to a physical address
  * @param access to distinguish between fetching instructions and reading/writing data
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE
  * @param byte pointer to the byte to be returned
  * @param replace replacement policy
  * @return error code
@@ -145,7 +477,9 @@ int cache_read_byte(const void * mem_space,
                     phy_addr_t * p_paddr,
                     mem_access_t access,
                     void * l1_cache,
+                    const cache_config_t * l1_config,
                     void * l2_cache,
+                    const cache_config_t * l2_config,
                     uint8_t * p_byte,
                     cache_replace_t replace);
 
@@ -157,7 +491,9 @@ int cache_read_byte(const void * mem_space,
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE (same line size as L1)
  * @param word const pointer to the word of data that is to be written to the cache
  * @param replace replacement policy
  * @return error code
@@ -165,7 +501,9 @@ int cache_read_byte(const void * mem_space,
 int cache_write(void * mem_space,
                 phy_addr_t * paddr,
                 void * l1_cache,
+                const cache_config_t * l1_config,
                 void * l2_cache,
+                const cache_config_t * l2_config,
                 const uint32_t * word,
                 cache_replace_t replace);
 
@@ -176,24 +514,154 @@ int cache_write(void * mem_space,
  * @param mem_space pointer to the memory space
  * @param paddr pointer to a physical address
  * @param l1_cache pointer to the beginning of L1 ICACHE
+ * @param l1_config geometry of L1 CACHE
  * @param l2_cache pointer to the beginning of L2 CACHE
- * @param p_byte pointer to the byte to be returned
+ * @param l2_config geometry of L2 CACHE
+ * @param p_byte the byte to be written
  * @param replace replacement policy
  * @return error code
  */
 int cache_write_byte(void * mem_space,
                      phy_addr_t * paddr,
                      void * l1_cache,
+                     const cache_config_t * l1_config,
                      void * l2_cache,
+                     const cache_config_t * l2_config,
                      uint8_t p_byte,
                      cache_replace_t replace);
 
+//=========================================================================
+/**
+ * @brief Ask cache for size bytes of data at any address (little endian
+ *        order). The access is resolved with one lookup in the line of its
+ *        first byte, and a second one in the next line if it crosses a line
+ *        boundary (see cache_read for the exclusive policy).
+ *
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address
+ * @param access to distinguish between fetching instructions and reading/writing data
+ * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE (same line size as L1)
+ * @param data pointer to the size bytes returned by cache (0 in tag-only mode)
+ * @param size number of bytes, at most a line, not crossing a page
+ * @param replace replacement policy
+ * @return error code
+ */
+int cache_read_bytes(const void * mem_space,
+                     phy_addr_t * paddr,
+                     mem_access_t access,
+                     void * l1_cache,
+                     const cache_config_t * l1_config,
+                     void * l2_cache,
+                     const cache_config_t * l2_config,
+                     void * data,
+                     size_t size,
+                     cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Write to cache size bytes of data at any address (little endian
+ *        order), with one lookup per line touched (at most two), each line
+ *        being write-allocated in L1.
+ *
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address
+ * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE (same line size as L1)
+ * @param data pointer to the size bytes to be written
+ * @param size number of bytes, at most a line, not crossing a page
+ * @param replace replacement policy
+ * @return error code
+ */
+int cache_write_bytes(void * mem_space,
+                      phy_addr_t * paddr,
+                      void * l1_cache,
+                      const cache_config_t * l1_config,
+                      void * l2_cache,
+                      const cache_config_t * l2_config,
+                      const void * data,
+                      size_t size,
+                      cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief Coherence snoop of a line in a cache and in all the caches attached
+ *        above it (see cache_attach_upper()): dirty copies are written back
+ *        to memory (and the copies below refreshed), then marked clean or,
+ *        if asked to, invalidated.
+ *
+ * @param mem_space pointer to the memory space
+ * @param cache pointer to the cache (e.g. the L2 of a core)
+ * @param config the cache geometry
+ * @param paddr pointer to a physical address (anywhere in the line)
+ * @param invalidate whether the copies are invalidated (write by another core)
+ *        or only cleaned (read by another core)
+ * @param found (modified) 1 if any copy of the line was found, 0 otherwise
+ * @param dirty (modified) 1 if any copy was dirty, 0 otherwise
+ * @return error code
+ */
+int cache_snoop(void * mem_space,
+                void * cache,
+                const cache_config_t * config,
+                const phy_addr_t * paddr,
+                int invalidate,
+                int * found,
+                int * dirty);
+
+//=========================================================================
+/**
+ * @brief Tells whether the line of an address is in a cache, without
+ *        touching its replacement state nor its statistics.
+ *
+ * @param cache pointer to the cache
+ * @param config the cache geometry
+ * @param paddr pointer to a physical address
+ * @param present (modified) 1 if the line is in the cache, 0 otherwise
+ * @return error code
+ */
+int cache_probe(const void * cache,
+                const cache_config_t * config,
+                const phy_addr_t * paddr,
+                int * present);
+
+//=========================================================================
+/**
+ * @brief Prefetches the line of an address into L1 (from L2 or memory)
+ *        or into L2 (from memory), through the same fill paths as a demand
+ *        access, but without counting any hit or miss. Nothing is done if
+ *        the line already is in the target level or above it.
+ *
+ * @param mem_space pointer to the memory space
+ * @param paddr pointer to a physical address (anywhere in the line)
+ * @param l1_cache pointer to the beginning of L1 CACHE
+ * @param l1_config geometry of L1 CACHE
+ * @param l2_cache pointer to the beginning of L2 CACHE
+ * @param l2_config geometry of L2 CACHE (same line size as L1)
+ * @param to_l2 whether the line is to be prefetched into L2 instead of L1
+ * @param replace replacement policy
+ * @param issued (modified) 1 if the line was brought into the target level, 0 otherwise
+ * @return error code
+ */
+int cache_prefetch(void * mem_space,
+                   const phy_addr_t * paddr,
+                   void * l1_cache,
+                   const cache_config_t * l1_config,
+                   void * l2_cache,
+                   const cache_config_t * l2_config,
+                   int to_l2,
+                   cache_replace_t replace,
+                   int * issued);
+
 //=========================================================================
 /**
  * @brief Print the contents of a cache to a stream.
  * @param output the stream to print to.
  * @param cache pointer to the cache
- * @param cache_type to distinguish between different caches
+ * @param config the cache geometry
  * @return error code
  */
-int cache_dump(FILE* output, const void* cache, cache_t cache_type);
+int cache_dump(FILE* output, const void* cache, const cache_config_t * config);
@@ -0,0 +1,180 @@
+/**
+ * @file checkpoint_mng.c
+ * @brief binary checkpoints of a hierarchy, to warm it once and run many
+ *        experiments from the same state
+ *
+ * @date 2019
+ */
+
+#include "checkpoint_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <string.h> // for memcmp, memcpy
+
+#define NB_CACHES 4 // L1I, L1D, L2, L3
+
+// Caches of a hierarchy, and their geometries, in the checkpoint order
+static void hrchy_caches(const cache_hrchy_t* hrchy, void* caches[], const cache_config_t* configs[]) {
+    caches[0] = hrchy->l1_icache;
+    caches[1] = hrchy->l1_dcache;
+    caches[2] = hrchy->l2_cache;
+    caches[3] = hrchy->l3_cache;
+    configs[0] = configs[1] = &hrchy->l1_config;
+    configs[2] = &hrchy->l2_config;
+    configs[3] = &hrchy->l3_config;
+}
+
+static inline int page_differs(const void* mem_space, const void* base_mem, size_t page) {
+    return memcmp((const byte_t*) mem_space + page * PAGE_SIZE,
+                  (const byte_t*) base_mem + page * PAGE_SIZE, PAGE_SIZE) != 0;
+}
+
+//=========================================================================
+int checkpoint_save(FILE * output, const cache_hrchy_t * hrchy, uint64_t position,
+                    const void * base_mem, size_t mem_size) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE((hrchy->mem_space == NULL) == (base_mem == NULL), ERR_BAD_PARAMETER, "%s",
+              "the memory image is required with a memory space");
+    M_REQUIRE(hrchy->sample_units == NULL && hrchy->classifiers == NULL && hrchy->heat == NULL
+              && !hrchy->l3_shared, ERR_BAD_PARAMETER, "%s",
+              "set sampling, miss classification, heat maps and shared L3 are not saved");
+    M_REQUIRE(!hrchy->stats_disabled, ERR_BAD_PARAMETER, "%s", "the statistics are disabled");
+
+    checkpoint_header_t header;
+    zero_init_var(header);
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.version = CHECKPOINT_VERSION;
+    header.flags = (hrchy->l3_cache != NULL ? CHECKPOINT_L3 : 0) | (hrchy->prefetcher != NULL ? CHECKPOINT_PREFETCH : 0);
+    header.l1_config = hrchy->l1_config;
+    header.l2_config = hrchy->l2_config;
+    header.l3_config = hrchy->l3_config;
+    header.replace = hrchy->replace;
+    header.l3_replace = hrchy->l3_replace;
+    header.position = position;
+    header.mem_size = hrchy->mem_space == NULL ? 0 : mem_size;
+
+    size_t nb_pages = (size_t) header.mem_size / PAGE_SIZE;
+    for (size_t page = 0; page < nb_pages; ++page) {
+        if (page_differs(hrchy->mem_space, base_mem, page)) ++header.nb_pages;
+    }
+
+    M_REQUIRE(fwrite(&header, sizeof(header), 1, output) == 1
+              && fwrite(hrchy->l1_itlb, sizeof(hrchy->l1_itlb), 1, output) == 1
+              && fwrite(hrchy->l1_dtlb, sizeof(hrchy->l1_dtlb), 1, output) == 1
+              && fwrite(hrchy->l2_tlb, sizeof(hrchy->l2_tlb), 1, output) == 1
+              && fwrite(&hrchy->tlb_hits, sizeof(hrchy->tlb_hits), 1, output) == 1
+              && fwrite(&hrchy->tlb_misses, sizeof(hrchy->tlb_misses), 1, output) == 1,
+              ERR_IO, "%s", "cannot write the checkpoint");
+
+    void* caches[NB_CACHES];
+    const cache_config_t* configs[NB_CACHES];
+    hrchy_caches(hrchy, caches, configs);
+    for (size_t c = 0; c < NB_CACHES; ++c) {
+        if (caches[c] != NULL) M_EXIT_IF_ERR_NOMSG(cache_save(output, caches[c], configs[c]));
+    }
+    if (hrchy->prefetcher != NULL) {
+        M_REQUIRE(fwrite(hrchy->prefetcher, sizeof(prefetcher_t), 1, output) == 1,
+                  ERR_IO, "%s", "cannot write the checkpoint");
+    }
+
+    for (size_t page = 0; page < nb_pages; ++page) {
+        if (!page_differs(hrchy->mem_space, base_mem, page)) continue;
+        uint32_t number = (uint32_t) page;
+        M_REQUIRE(fwrite(&number, sizeof(number), 1, output) == 1
+                  && fwrite((const byte_t*) hrchy->mem_space + page * PAGE_SIZE, PAGE_SIZE, 1, output) == 1,
+                  ERR_IO, "%s", "cannot write the checkpoint");
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+/**
+ * @brief Rebuilds a saved geometry from its parameters, so that no
+ *        inconsistent geometry ever sizes a read.
+ * @return error code
+ */
+static int checked_config(const cache_config_t* saved, cache_config_t* config) {
+    M_EXIT_IF_ERR_NOMSG(cache_config_init(config, saved->lines, saved->ways, saved->line_size, saved->word_size));
+    M_EXIT_IF_ERR_NOMSG(cache_config_set_layout(config, saved->layout));
+    M_EXIT_IF_ERR_NOMSG(cache_config_set_tag_only(config, saved->tag_only));
+    M_EXIT_IF_ERR_NOMSG(cache_config_set_write_back(config, saved->write_back));
+    M_EXIT_IF_ERR_NOMSG(cache_config_set_sector_size(config, saved->sector_size));
+    M_EXIT_IF_ERR_NOMSG(cache_config_set_inclusion(config, saved->inclusion));
+    M_REQUIRE(config->entry_size == saved->entry_size && config->state_offset == saved->state_offset,
+              ERR_BAD_PARAMETER, "%s", "inconsistent cache geometry in the checkpoint");
+    return ERR_NONE;
+}
+
+/**
+ * @brief Reads the TLBs, caches, prefetcher and memory delta of a
+ *        checkpoint into an initialized hierarchy.
+ * @return error code
+ */
+static int load_state(FILE* input, const checkpoint_header_t* header, cache_hrchy_t* hrchy,
+                      size_t mem_size, prefetcher_t* prefetcher) {
+    M_REQUIRE(fread(hrchy->l1_itlb, sizeof(hrchy->l1_itlb), 1, input) == 1
+              && fread(hrchy->l1_dtlb, sizeof(hrchy->l1_dtlb), 1, input) == 1
+              && fread(hrchy->l2_tlb, sizeof(hrchy->l2_tlb), 1, input) == 1
+              && fread(&hrchy->tlb_hits, sizeof(hrchy->tlb_hits), 1, input) == 1
+              && fread(&hrchy->tlb_misses, sizeof(hrchy->tlb_misses), 1, input) == 1,
+              ERR_IO, "%s", "cannot read the checkpoint");
+
+    void* caches[NB_CACHES];
+    const cache_config_t* configs[NB_CACHES];
+    hrchy_caches(hrchy, caches, configs);
+    for (size_t c = 0; c < NB_CACHES; ++c) {
+        if (caches[c] != NULL) M_EXIT_IF_ERR_NOMSG(cache_load(input, caches[c], configs[c]));
+    }
+
+    if (header->flags & CHECKPOINT_PREFETCH) {
+        M_REQUIRE(fread(prefetcher, sizeof(prefetcher_t), 1, input) == 1,
+                  ERR_IO, "%s", "cannot read the checkpoint");
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_set_prefetcher(hrchy, prefetcher));
+    }
+
+    for (uint64_t p = 0; p < header->nb_pages; ++p) {
+        uint32_t number = 0;
+        M_REQUIRE(fread(&number, sizeof(number), 1, input) == 1, ERR_IO, "%s", "cannot read the checkpoint");
+        M_REQUIRE((size_t) number < mem_size / PAGE_SIZE, ERR_ADDR, "%u: page out of memory", number);
+        M_REQUIRE(fread((byte_t*) hrchy->mem_space + (size_t) number * PAGE_SIZE, PAGE_SIZE, 1, input) == 1,
+                  ERR_IO, "%s", "cannot read the checkpoint");
+    }
+    return ERR_NONE;
+}
+
+int checkpoint_load(FILE * input, cache_hrchy_t * hrchy, void * mem_space, size_t mem_size,
+                    prefetcher_t * prefetcher, uint64_t * position) {
+    M_REQUIRE_NON_NULL(input);
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(position);
+
+    checkpoint_header_t header;
+    M_REQUIRE(fread(&header, sizeof(header), 1, input) == 1, ERR_IO, "%s", "cannot read the checkpoint");
+    M_REQUIRE(!memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))
+              && header.version == CHECKPOINT_VERSION, ERR_BAD_PARAMETER, "%s", "not a checkpoint of this version");
+    M_REQUIRE(header.mem_size == (mem_space == NULL ? 0 : mem_size), ERR_SIZE, "%s",
+              "the memory differs from the one of the checkpoint");
+    M_REQUIRE(!(header.flags & CHECKPOINT_PREFETCH) || prefetcher != NULL, ERR_BAD_PARAMETER, "%s",
+              "no room to restore the prefetcher of the checkpoint");
+
+    cache_config_t l1_config, l2_config, l3_config;
+    M_EXIT_IF_ERR_NOMSG(checked_config(&header.l1_config, &l1_config));
+    M_EXIT_IF_ERR_NOMSG(checked_config(&header.l2_config, &l2_config));
+    if (header.flags & CHECKPOINT_L3) M_EXIT_IF_ERR_NOMSG(checked_config(&header.l3_config, &l3_config));
+
+    M_EXIT_IF_ERR_NOMSG(cache_hrchy_init(hrchy, mem_space, &l1_config, &l2_config, (cache_replace_t) header.replace));
+    int err = ERR_NONE;
+    if (header.flags & CHECKPOINT_L3) {
+        err = cache_hrchy_add_l3(hrchy, &l3_config, (cache_replace_t) header.l3_replace);
+    }
+    if (err == ERR_NONE) err = load_state(input, &header, hrchy, mem_size, prefetcher);
+    if (err != ERR_NONE) {
+        cache_hrchy_free(hrchy);
+        return err;
+    }
+
+    *position = header.position;
+    return ERR_NONE;
+}
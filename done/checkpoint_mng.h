@@ -0,0 +1,78 @@
+#pragma once
+
+/**
+ * @file checkpoint_mng.h
+ * @brief binary checkpoints of a hierarchy, to warm it once and run many
+ *        experiments from the same state
+ *
+ * A checkpoint holds, in this order:
+ *  - a checkpoint_header_t: geometries and policies of the caches,
+ *    position in the program and size of the memory;
+ *  - the TLBs and their statistics;
+ *  - each cache (L1I, L1D, L2, then L3 if any), see cache_save();
+ *  - the prefetcher, if any;
+ *  - the memory pages that differ from the memory image the run started
+ *    from, each one preceded by its (uint32_t) page number.
+ *
+ * Restoring is a handful of reads straight into the storage of the caches
+ * and of the memory. The records are those of the host, so a checkpoint
+ * is only meant to be read back by the same build of the simulator.
+ *
+ * @date 2019
+ */
+
+#include "cache_hrchy_mng.h"
+
+#include <stdio.h> // for FILE
+
+#define CHECKPOINT_MAGIC   "i7ckpt"
+#define CHECKPOINT_VERSION 3u
+
+#define CHECKPOINT_L3       0x1u
+#define CHECKPOINT_PREFETCH 0x2u
+
+typedef struct {
+    char     magic[8];   // CHECKPOINT_MAGIC
+    uint32_t version;    // CHECKPOINT_VERSION
+    uint32_t flags;      // CHECKPOINT_L3, CHECKPOINT_PREFETCH
+    cache_config_t l1_config;
+    cache_config_t l2_config;
+    cache_config_t l3_config;
+    uint32_t replace;    // cache_replace_t
+    uint32_t l3_replace;
+    uint64_t position;   // commands of the program already executed
+    uint64_t mem_size;
+    uint64_t nb_pages;   // memory pages that follow
+} checkpoint_header_t;
+
+//=========================================================================
+/**
+ * @brief Writes a checkpoint of a hierarchy.
+ * @param output the stream to write to
+ * @param hrchy the hierarchy, without set sampling, miss classification,
+ *        heat maps nor shared L3, with its statistics enabled
+ * @param position the number of commands of the program already executed
+ * @param base_mem the memory image the program started from (mem_size bytes),
+ *        to which the memory of the hierarchy is compared
+ * @param mem_size the size of both memories
+ * @return error code
+ */
+int checkpoint_save(FILE * output, const cache_hrchy_t * hrchy, uint64_t position,
+                    const void * base_mem, size_t mem_size);
+
+//=========================================================================
+/**
+ * @brief Reads a checkpoint: initializes a hierarchy like the saved one
+ *        (to be freed with cache_hrchy_free()) and applies the memory delta.
+ * @param input the stream to read from
+ * @param hrchy (modified) the hierarchy to initialize
+ * @param mem_space (modified) the memory, initialized from the image the
+ *        saved run started from
+ * @param mem_size the size of the memory
+ * @param prefetcher (modified) where to restore the prefetcher, if the
+ *        checkpoint has one (may be NULL otherwise)
+ * @param position (modified) the number of commands already executed
+ * @return error code
+ */
+int checkpoint_load(FILE * input, cache_hrchy_t * hrchy, void * mem_space, size_t mem_size,
+                    prefetcher_t * prefetcher, uint64_t * position);
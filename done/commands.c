@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <inttypes.h>
 #include "commands.h"
 #include "addr.h"
@@ -27,6 +28,18 @@ static inline void set_write_data(FILE* input, command_t* command);
 
 static inline int set_data_size(FILE* input, command_t* command);
 
+static inline int read_directive(FILE* input, program_t* program);
+
+static inline int program_add_roi_bound(program_t* program, size_t bound);
+
+//letter of a data size (B, H, W, D), '\0' if not a valid size
+static inline char size_letter(size_t data_size) {
+    for(size_t i = 0; COMMAND_SIZES[i] != '\0'; ++i) {
+        if(data_size == (size_t) 1 << i) return COMMAND_SIZES[i];
+    }
+    return '\0';
+}
+
 
 int program_init(program_t* program){
     M_REQUIRE_NON_NULL(program);
@@ -35,6 +48,8 @@ int program_init(program_t* program){
 
     program->nb_lines = 0;
     program->allocated = LISTING_PADDING * sizeof(command_t);
+    program->roi = NULL;
+    program->nb_roi = 0;
 
     return ERR_NONE;
 }
@@ -46,6 +61,9 @@ int program_free(program_t* program) {
     free(program->listing);
     program->listing = NULL;
     program->nb_lines = program->allocated = 0;
+    free(program->roi);
+    program->roi = NULL;
+    program->nb_roi = 0;
 
     return ERR_NONE;
 }
@@ -71,9 +89,13 @@ int program_print(FILE* output, const program_t* program){
     M_REQUIRE_NON_NULL(program);
     M_REQUIRE_NON_NULL(program->listing);
 
-     //fprintf every entry(command) in the listing
+     //fprintf every entry(command) in the listing, and the ROI bounds before it
      size_t i;
+     size_t bound = 0;
      for(i = 0; i < program->nb_lines; ++i) {
+        for(; bound < program->nb_roi && program->roi[bound] == i; ++bound) {
+            fprintf(output, "%croi %s\n", PROGRAM_DIRECTIVE, bound % 2 == 0 ? "begin" : "end");
+        }
         command_t command = program->listing[i];
         //output if its a Read or Write
         if(command.order == READ) {
@@ -95,18 +117,10 @@ int program_print(FILE* output, const program_t* program){
 
         //if its command type is data
         //output data size
-        if(command.data_size == sizeof(char)){
-            fprintf(output, "B");
-        } else {
-            fprintf(output, "W");
-        }
-        //if its a write output the write data
+        fprintf(output, "%c", size_letter(command.data_size));
+        //if its a write output the write data, two hex digits per byte
         if(command.order == WRITE) {
-            if(command.data_size == sizeof(char)) {
-                 fprintf(output, " 0x%02" PRIX32, command.write_data);
-            } else {
-                fprintf(output, " 0x%08" PRIX32, command.write_data);
-            }
+            fprintf(output, " 0x%0*" PRIX64, (int) (2 * command.data_size), command.write_data);
         }
         //finally print vaddr and \n
         uint64_t addr = virt_addr_t_to_uint64_t(&command.vaddr);
@@ -114,6 +128,9 @@ int program_print(FILE* output, const program_t* program){
 
         fprintf(output, "\n");
      }
+     for(; bound < program->nb_roi; ++bound) {
+        fprintf(output, "%croi %s\n", PROGRAM_DIRECTIVE, bound % 2 == 0 ? "begin" : "end");
+     }
 
      return ERR_NONE;
 }
@@ -143,16 +160,18 @@ int program_add_command(program_t* program, const command_t* command){
         M_REQUIRE(command->order == READ, ERR_BAD_PARAMETER, "%s", "instruction are read only");
     }
     if(command->type == DATA) {
-        M_REQUIRE(command->data_size == sizeof(word_t) || command->data_size == sizeof(char),
+        M_REQUIRE(size_letter(command->data_size) != '\0',
                   ERR_BAD_PARAMETER, "%s", "data_size incorrect for data access");
+        M_REQUIRE(command->vaddr.page_offset + command->data_size <= PAGE_SIZE, ERR_BAD_PARAMETER,
+                  "%s", "a data access cannot cross a page");
+    } else {
+        M_REQUIRE((command->vaddr.page_offset % command->data_size) == 0, ERR_BAD_PARAMETER,
+                  "%s", "page_offset must be a multiple of data size");
     }
 
-    M_REQUIRE((command->vaddr.page_offset % command->data_size) == 0, ERR_BAD_PARAMETER,
-               "%s", "page_offset must be a multiple of data size");
-
     // Week 6: Dynamic allocation. Adds the command to our and enlarges listing if its too small.
     while (program->nb_lines * sizeof(command_t) >= program->allocated) {
-        M_EXIT_IF_ERR(program_resize(program, program->allocated * program->allocated),
+        M_EXIT_IF_ERR(program_resize(program, 2 * program->allocated / sizeof(command_t)),
                 "program_resize() failed. Cannot resize listing");
     }
     program->listing[program->nb_lines] = *command;
@@ -174,6 +193,17 @@ int program_read(const char* filename, program_t* program){
     //read command 1 by 1 and add it to program
     while(!feof(input) && !ferror(input)) {
         skip_whitespaces(input);
+        int first = fgetc(input);
+        if(first == PROGRAM_DIRECTIVE) {
+            int error = read_directive(input, program);
+            if(error != ERR_NONE) {
+                fclose(input);
+                return error;
+            }
+            skip_whitespaces(input);
+            continue;
+        }
+        ungetc(first, input);
         command_t command;
         int error = read_command(input, &command);
         if(error != ERR_NONE) {
@@ -181,6 +211,10 @@ int program_read(const char* filename, program_t* program){
 		}
         M_REQUIRE(error == ERR_NONE, ERR_IO, "%s", "bad input");
         error = program_add_command(program, &command);
+        if(error != ERR_NONE) {
+            fclose(input);
+            return error;
+        }
         //skip whitespaces just incase there are white spaces left at the end of the file
         skip_whitespaces(input);
     }
@@ -190,11 +224,74 @@ int program_read(const char* filename, program_t* program){
 	}
     fclose(input) ;
 
+    //a region left open ends with the program
+    if(program->nb_roi % 2 != 0) {
+        M_EXIT_IF_ERR_NOMSG(program_add_roi_bound(program, program->nb_lines));
+    }
     program_shrink(program);
 
     return error;
 }
 
+int program_roi(const program_t* program, size_t index, size_t* begin, size_t* end) {
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE_NON_NULL(begin);
+    M_REQUIRE_NON_NULL(end);
+
+    if(program->nb_roi == 0) {
+        *begin = 0;
+        *end = program->nb_lines;
+        return 1;
+    }
+    //the stretch ends at the first bound after index: an end bound if it is a ROI
+    size_t previous = 0;
+    for(size_t k = 0; k < program->nb_roi; ++k) {
+        if(index < program->roi[k]) {
+            *begin = previous;
+            *end = program->roi[k];
+            return k % 2 != 0;
+        }
+        previous = program->roi[k];
+    }
+    *begin = previous;
+    *end = program->nb_lines;
+    return 0;
+}
+
+//appends a ROI bound (begin or end, alternately) to the program
+int program_add_roi_bound(program_t* program, size_t bound) {
+    size_t* roi = realloc(program->roi, (program->nb_roi + 1) * sizeof(size_t));
+    M_EXIT_IF_NULL(roi, (program->nb_roi + 1) * sizeof(size_t));
+    program->roi = roi;
+    program->roi[program->nb_roi++] = bound;
+    return ERR_NONE;
+}
+
+//reads the rest of a directive line (after PROGRAM_DIRECTIVE)
+int read_directive(FILE* input, program_t* program) {
+    char line[64];
+    if(fgets(line, sizeof(line), input) == NULL) {
+        return ERR_NONE; //empty comment at the end of the file
+    }
+    //skip the rest of a long comment
+    if(strchr(line, '\n') == NULL) {
+        int c;
+        while((c = fgetc(input)) != '\n' && c != EOF);
+    }
+
+    char keyword[16], argument[16], trailing[2];
+    int nb = sscanf(line, "%15s %15s %1s", keyword, argument, trailing);
+    if(nb < 1 || strcmp(keyword, "roi")) {
+        return ERR_NONE; //a comment
+    }
+    int begin = (nb == 2 && !strcmp(argument, "begin"));
+    int end = (nb == 2 && !strcmp(argument, "end"));
+    //begin and end must alternate
+    M_REQUIRE((begin && program->nb_roi % 2 == 0) || (end && program->nb_roi % 2 != 0), ERR_IO,
+              "%s", "bad ROI directive");
+    return program_add_roi_bound(program, program->nb_lines);
+}
+
 int read_command(FILE* input, command_t* newCommand){
     int error = 0;
     char order = fgetc(input); //!= EOF
@@ -279,15 +376,11 @@ int handle_write_data(FILE* input, command_t* command) {
 //assumes next thing to read is data, and sets it in the command
 int set_data_size(FILE* input, command_t* command) {
     skip_whitespaces(input);
-    char data_size = fgetc(input);
-    if(data_size == 'B') {
-        command->data_size = sizeof(char); // 1 byte
-    }
-    if(data_size == 'W') {
-        command->data_size = sizeof(word_t);
-    } else {
-	}
-	return ERR_NONE;;
+    int data_size = fgetc(input);
+    const char* letter = data_size == EOF || data_size == '\0' ? NULL : strchr(COMMAND_SIZES, data_size);
+    M_REQUIRE(letter != NULL, ERR_IO, "%s", "unknown data size");
+    command->data_size = (size_t) 1 << (letter - COMMAND_SIZES); // B: 1 byte, ..., D: 8 bytes
+	return ERR_NONE;
 }
 //assumes next thing to read is is vaddr, and sets in the command
 int set_vaddr(FILE* input, command_t* command){
@@ -301,9 +394,9 @@ int set_vaddr(FILE* input, command_t* command){
 //assumes next thing to read is is write data, and sets in the command
 void set_write_data(FILE* input, command_t* command) {
     skip_whitespaces(input);
-    word_t word = 0;
-    fscanf(input, "%"SCNx32, &word);
-    command->write_data = word;
+    uint64_t data = 0;
+    fscanf(input, "%"SCNx64, &data);
+    command->write_data = data;
 }
 
 //skip whitespaces if there are
@@ -22,8 +22,8 @@ typedef enum command_word_type command_word_t;
  typedef struct{
     command_word_t order;  //indique lecture ou écriture (R, W)
     mem_access_t type;     //type d'information chercher(instruction ou donnée)(I ,D)
-    size_t data_size;      //indique taille en cotect des donnée manipuler(mot ou byte)(B ,W)
-    word_t write_data;     //si necessaire, valeur à écrire
+    size_t data_size;      //indique taille en cotect des donnée manipuler(B, H, W, D: 1, 2, 4, 8)
+    uint64_t write_data;   //si necessaire, valeur à écrire (data_size octets de poids faible)
     virt_addr_t vaddr;     //addresse virtuelle où acceder
  }command_t;
  
@@ -31,8 +31,25 @@ typedef enum command_word_type command_word_t;
     command_t* listing;     //contient les commandes
     size_t nb_lines;        //nombres de commandes dans listing
     size_t allocated;       //sem6 -> représentera la taille aloué a listing
+    size_t* roi;            //bornes des régions d'intérêt: commandes [roi[2k], roi[2k+1])
+    size_t nb_roi;          //nombre de bornes (paire), 0 si tout le programme est d'intérêt
  }program_t;
 
+/*
+ * Directives of command files: a line starting with '#' is a comment,
+ * except for "#roi begin" and "#roi end", which delimit a region of
+ * interest (ROI) of the program. A region left open ends with the program.
+ */
+#define PROGRAM_DIRECTIVE '#'
+
+/*
+ * Data sizes of commands: byte (B), halfword (H), word (W) and 64-bit
+ * double word (D). A data access may be unaligned and cross a cache line,
+ * but not a page; instructions are aligned words.
+ */
+#define COMMAND_SIZES "BHWD"  // letter of size 2^i at index i
+#define COMMAND_MAX_SIZE 8u
+
 
 /**
  * @brief A useful macro to loop over all program lines.
@@ -87,6 +104,18 @@ int program_print(FILE* output, const program_t* program);
  */
 int program_read(const char* filename, program_t* program);
 
+/**
+ * @brief Finds the stretch of commands around a command of a program that
+ *        is either a region of interest or out of all of them (the whole
+ *        program is a region of interest if it has no ROI directive).
+ * @param program the program.
+ * @param index the index of a command of the program.
+ * @param begin (modified) the first command of the stretch.
+ * @param end (modified) one past the last command of the stretch.
+ * @return whether the stretch is a region of interest.
+ */
+int program_roi(const program_t* program, size_t index, size_t* begin, size_t* end);
+
 /**
  * @brief "Destructor" for program_t: free its content.
  * @param program the program to be filled from file.
@@ -0,0 +1,206 @@
+/**
+ * @file heat_map_mng.c
+ * @brief heat maps of the hits, misses and evictions of a hierarchy, per
+ *        virtual page and per set of each cache level
+ *
+ * @date 2019
+ */
+
+#include "heat_map_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <inttypes.h> // for PRIu64, PRIx64
+
+static const char* const LEVEL_NAMES[HEAT_LEVELS] = { "L1I", "L1D", "L2", "L3" };
+
+static inline size_t hash_page(uint64_t key, size_t nb_slots) {
+    return (size_t) ((key * UINT64_C(0x9E3779B97F4A7C15)) >> 32) & (nb_slots - 1);
+}
+
+//=========================================================================
+int heat_map_init(heat_map_t * map, const uint32_t nb_sets[HEAT_LEVELS]) {
+    M_REQUIRE_NON_NULL(map);
+    M_REQUIRE_NON_NULL(nb_sets);
+
+    zero_init_ptr(map);
+    int err = ERR_NONE;
+    for (uint8_t level = 0; level < HEAT_LEVELS && err == ERR_NONE; ++level) {
+        heat_level_t* hl = &map->levels[level];
+        hl->map = map;
+        hl->level = level;
+        hl->nb_sets = nb_sets[level];
+        if (hl->nb_sets > 0 && (hl->sets = calloc(hl->nb_sets, sizeof(heat_counts_t))) == NULL) err = ERR_MEM;
+    }
+    map->nb_slots = HEAT_MIN_SLOTS;
+    if (err == ERR_NONE && (map->pages = calloc(map->nb_slots, sizeof(heat_page_t))) == NULL) err = ERR_MEM;
+    if (err != ERR_NONE) heat_map_free(map);
+    return err;
+}
+
+//=========================================================================
+int heat_map_free(heat_map_t * map) {
+    M_REQUIRE_NON_NULL(map);
+
+    for (uint8_t level = 0; level < HEAT_LEVELS; ++level) free(map->levels[level].sets);
+    free(map->pages);
+    zero_init_ptr(map);
+    return ERR_NONE;
+}
+
+//=========================================================================
+// Slot of a key: the one holding it, or the empty one where it goes
+static inline heat_page_t* find_slot(heat_page_t* pages, size_t nb_slots, uint64_t key) {
+    size_t slot = hash_page(key, nb_slots);
+    while (pages[slot].key != 0 && pages[slot].key != key) slot = (slot + 1) & (nb_slots - 1);
+    return &pages[slot];
+}
+
+// Doubles the page table
+static int grow(heat_map_t* map) {
+    size_t nb_slots = 2 * map->nb_slots;
+    heat_page_t* pages = calloc(nb_slots, sizeof(heat_page_t));
+    M_EXIT_IF_NULL(pages, nb_slots * sizeof(heat_page_t));
+
+    for (size_t s = 0; s < map->nb_slots; ++s) {
+        if (map->pages[s].key != 0) *find_slot(pages, nb_slots, map->pages[s].key) = map->pages[s];
+    }
+    free(map->pages);
+    map->pages = pages;
+    map->nb_slots = nb_slots;
+    return ERR_NONE;
+}
+
+int heat_map_page(heat_map_t * map, uint64_t vpn) {
+    M_REQUIRE_NON_NULL(map);
+
+    uint64_t key = vpn + 1;
+    heat_page_t* page = find_slot(map->pages, map->nb_slots, key);
+    if (page->key == 0) {
+        if (2 * (map->nb_pages + 1) > map->nb_slots) {
+            map->current = NULL;
+            M_EXIT_IF_ERR_NOMSG(grow(map));
+            page = find_slot(map->pages, map->nb_slots, key);
+        }
+        page->key = key;
+        ++map->nb_pages;
+    }
+    map->current = page;
+    return ERR_NONE;
+}
+
+//=========================================================================
+static inline uint64_t page_misses(const heat_page_t* page) {
+    uint64_t misses = 0;
+    for (uint8_t level = 0; level < HEAT_LEVELS; ++level) misses += page->levels[level].count[HEAT_MISSES];
+    return misses;
+}
+
+// Most misses first, then increasing page number
+static int compare_pages(const void* a, const void* b) {
+    const heat_page_t* x = *(const heat_page_t* const*) a;
+    const heat_page_t* y = *(const heat_page_t* const*) b;
+    uint64_t mx = page_misses(x), my = page_misses(y);
+    if (mx != my) return mx < my ? 1 : -1;
+    return (x->key > y->key) - (x->key < y->key);
+}
+
+// Most misses first, then increasing set index
+static int compare_sets(const void* a, const void* b) {
+    const heat_counts_t* x = *(const heat_counts_t* const*) a;
+    const heat_counts_t* y = *(const heat_counts_t* const*) b;
+    if (x->count[HEAT_MISSES] != y->count[HEAT_MISSES]) return x->count[HEAT_MISSES] < y->count[HEAT_MISSES] ? 1 : -1;
+    return (x > y) - (x < y);
+}
+
+static int print_top_pages(FILE* output, const heat_map_t* map, size_t n) {
+    const heat_page_t** sorted = malloc((map->nb_pages > 0 ? map->nb_pages : 1) * sizeof(heat_page_t*));
+    M_EXIT_IF_NULL(sorted, map->nb_pages * sizeof(heat_page_t*));
+    size_t nb = 0;
+    for (size_t s = 0; s < map->nb_slots; ++s) {
+        if (map->pages[s].key != 0) sorted[nb++] = &map->pages[s];
+    }
+    qsort(sorted, nb, sizeof(heat_page_t*), compare_pages);
+
+    fprintf(output, "%-9s: pages: %zu, top %zu by misses\n", "HEAT_PAGE", nb, n < nb ? n : nb);
+    fprintf(output, "%13s", "vpn");
+    for (uint8_t level = 0; level < HEAT_LEVELS; ++level) {
+        if (map->levels[level].nb_sets == 0) continue;
+        fprintf(output, " %7s_hit %6s_miss %7s_evict", LEVEL_NAMES[level], LEVEL_NAMES[level], LEVEL_NAMES[level]);
+    }
+    fputc('\n', output);
+    for (size_t i = 0; i < nb && i < n; ++i) {
+        fprintf(output, "0x%011" PRIx64, sorted[i]->key - 1);
+        for (uint8_t level = 0; level < HEAT_LEVELS; ++level) {
+            if (map->levels[level].nb_sets == 0) continue;
+            const uint64_t* count = sorted[i]->levels[level].count;
+            fprintf(output, " %11" PRIu64 " %11" PRIu64 " %13" PRIu64,
+                    count[HEAT_HITS], count[HEAT_MISSES], count[HEAT_EVICTIONS]);
+        }
+        fputc('\n', output);
+    }
+    free(sorted);
+    return ERR_NONE;
+}
+
+static int print_top_sets(FILE* output, const heat_level_t* hl, size_t n) {
+    const heat_counts_t** sorted = malloc(hl->nb_sets * sizeof(heat_counts_t*));
+    M_EXIT_IF_NULL(sorted, hl->nb_sets * sizeof(heat_counts_t*));
+    for (uint32_t set = 0; set < hl->nb_sets; ++set) sorted[set] = &hl->sets[set];
+    qsort(sorted, hl->nb_sets, sizeof(heat_counts_t*), compare_sets);
+
+    size_t shown = n < hl->nb_sets ? n : hl->nb_sets;
+    fprintf(output, "HEAT_%-4s: sets: %" PRIu32 ", top %zu by misses\n", LEVEL_NAMES[hl->level], hl->nb_sets, shown);
+    fprintf(output, "%6s %11s %11s %11s\n", "set", "hits", "misses", "evictions");
+    for (size_t i = 0; i < shown; ++i) {
+        const uint64_t* count = sorted[i]->count;
+        fprintf(output, "%6td %11" PRIu64 " %11" PRIu64 " %11" PRIu64 "\n", sorted[i] - hl->sets,
+                count[HEAT_HITS], count[HEAT_MISSES], count[HEAT_EVICTIONS]);
+    }
+    free(sorted);
+    return ERR_NONE;
+}
+
+int heat_map_print_top(FILE * output, const heat_map_t * map, size_t n) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(map);
+
+    M_EXIT_IF_ERR_NOMSG(print_top_pages(output, map, n));
+    for (uint8_t level = 0; level < HEAT_LEVELS; ++level) {
+        if (map->levels[level].nb_sets > 0) M_EXIT_IF_ERR_NOMSG(print_top_sets(output, &map->levels[level], n));
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+static inline int any_event(const heat_counts_t* counts) {
+    return counts->count[HEAT_HITS] != 0 || counts->count[HEAT_MISSES] != 0 || counts->count[HEAT_EVICTIONS] != 0;
+}
+
+int heat_map_print_csv(FILE * output, const heat_map_t * map) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(map);
+
+    fprintf(output, "kind,level,key,hits,misses,evictions\n");
+    for (size_t s = 0; s < map->nb_slots; ++s) {
+        const heat_page_t* page = &map->pages[s];
+        if (page->key == 0) continue;
+        for (uint8_t level = 0; level < HEAT_LEVELS; ++level) {
+            const heat_counts_t* c = &page->levels[level];
+            if (!any_event(c)) continue;
+            fprintf(output, "page,%s,0x%" PRIx64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", LEVEL_NAMES[level],
+                    page->key - 1, c->count[HEAT_HITS], c->count[HEAT_MISSES], c->count[HEAT_EVICTIONS]);
+        }
+    }
+    for (uint8_t level = 0; level < HEAT_LEVELS; ++level) {
+        const heat_level_t* hl = &map->levels[level];
+        for (uint32_t set = 0; set < hl->nb_sets; ++set) {
+            const heat_counts_t* c = &hl->sets[set];
+            if (!any_event(c)) continue;
+            fprintf(output, "set,%s,%" PRIu32 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", LEVEL_NAMES[level],
+                    set, c->count[HEAT_HITS], c->count[HEAT_MISSES], c->count[HEAT_EVICTIONS]);
+        }
+    }
+    return ERR_NONE;
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+/**
+ * @file heat_map_mng.h
+ * @brief heat maps of the hits, misses and evictions of a hierarchy, per
+ *        virtual page and per set of each cache level
+ *
+ * Each cache level has a heat_level_t, attached to the cache with
+ * cache_set_heat(), which counts the events of each of its sets in
+ * cache_hit() (hits, misses) and where lines are replaced (evictions).
+ * The same events are also counted for the virtual page of the access in
+ * flight (see heat_map_page()), in a hash table that only holds the pages
+ * accessed: open addressing with linear probing, at most half full,
+ * doubled when needed. The events caused by an access (including the
+ * evictions of the victims it pushes down) are thus charged to its page.
+ *
+ * @date 2019
+ */
+
+#include <stdint.h>
+#include <stddef.h> // for size_t
+#include <stdio.h> // for FILE
+
+#define HEAT_LEVELS 4u        // L1I, L1D, L2 and L3, in this order
+#define HEAT_MIN_SLOTS 1024u  // initial size of the page table
+
+typedef enum { HEAT_HITS, HEAT_MISSES, HEAT_EVICTIONS, HEAT_EVENTS } heat_event_t;
+
+typedef struct {
+    uint64_t count[HEAT_EVENTS];
+} heat_counts_t;
+
+/**
+ * A page of the hash table, empty if key is 0.
+ */
+typedef struct {
+    uint64_t key;          // virtual page number + 1
+    heat_counts_t levels[HEAT_LEVELS];
+} heat_page_t;
+
+struct heat_map;
+
+/**
+ * The counters of one cache level.
+ */
+typedef struct {
+    struct heat_map* map;  // the map the level belongs to
+    uint8_t level;         // index in HEAT_LEVELS order
+    uint32_t nb_sets;      // 0 for a level that is not counted
+    heat_counts_t* sets;
+} heat_level_t;
+
+typedef struct heat_map {
+    heat_level_t levels[HEAT_LEVELS];
+    heat_page_t* pages;    // nb_slots, a power of 2
+    size_t nb_slots;
+    size_t nb_pages;
+    heat_page_t* current;  // page of the access in flight, NULL for none
+    uint8_t paused;        // no counting (e.g. statistics disabled)
+} heat_map_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for heat_map_t.
+ * @param map (modified) the heat map to initialize
+ * @param nb_sets the number of sets of each level, in HEAT_LEVELS order
+ *        (0 for a level that is not counted)
+ * @return error code
+ */
+int heat_map_init(heat_map_t * map, const uint32_t nb_sets[HEAT_LEVELS]);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for heat_map_t.
+ * @param map the heat map
+ * @return error code
+ */
+int heat_map_free(heat_map_t * map);
+
+//=========================================================================
+/**
+ * @brief Sets the virtual page the next events are charged to, adding it
+ *        to the table if needed.
+ * @param map the heat map
+ * @param vpn the virtual page number
+ * @return error code
+ */
+int heat_map_page(heat_map_t * map, uint64_t vpn);
+
+//=========================================================================
+/**
+ * @brief Counts an event of a set of a cache level, and of the current page.
+ * @param hl the counters of the cache level
+ * @param set the set index
+ * @param event the event
+ */
+static inline void heat_count(heat_level_t * hl, uint32_t set, heat_event_t event) {
+    if (hl->map->paused) return;
+    ++hl->sets[set].count[event];
+    if (hl->map->current != NULL) ++hl->map->current->levels[hl->level].count[event];
+}
+
+//=========================================================================
+/**
+ * @brief Prints the n pages with the most misses (all levels together) and,
+ *        for each level, the n sets with the most misses.
+ * @param output the stream to print to
+ * @param map the heat map
+ * @param n the number of pages and sets
+ * @return error code
+ */
+int heat_map_print_top(FILE * output, const heat_map_t * map, size_t n);
+
+//=========================================================================
+/**
+ * @brief Prints all the counters in CSV, one line per page or set and
+ *        level with any event: kind (page or set), level, key (virtual
+ *        page number or set index), hits, misses, evictions.
+ * @param output the stream to print to
+ * @param map the heat map
+ * @return error code
+ */
+int heat_map_print_csv(FILE * output, const heat_map_t * map);
@@ -1,25 +1,174 @@
-// TODO Verify and do we need to include anything?
+#pragma once
+
+/**
+ * @file lru.h
+ * @brief true LRU replacement state of the caches.
+ *
+ * Only to be included by cache_kernels.h.
+ *
+ * @date 2019
+ */
 
 #include "cache.h"
 #include "cache_mng.h"
 
-#define LRU_age_increase(TYPE, WAYS, WAY_INDEX, LINE_INDEX) \
-    foreach_way(m_way_iterator, WAYS) { \
-        TYPE* cache_e = cache_entry(TYPE, WAYS, LINE_INDEX, m_way_iterator); \
-        if (m_way_iterator == WAY_INDEX) { \
-            cache_e->age = 0; \
-        } else { \
-            if(cache_e->age < WAYS - 1) cache_e->age =  cache_e->age + 1; \
-        } \
-    }
-
-#define LRU_age_update(TYPE, WAYS, WAY_INDEX, LINE_INDEX) \
-    uint8_t temp = cache_age(TYPE, WAYS, LINE_INDEX, WAY_INDEX); \
-    foreach_way(m_way_iterator, WAYS) { \
-        TYPE* cache_e = cache_entry(TYPE, WAYS, LINE_INDEX, m_way_iterator); \
-        if (m_way_iterator == WAY_INDEX) { \
-            cache_e->age = 0; \
-        } else if (cache_e->age < temp) { \
-            cache_e->age++; \
-        } \
+//=========================================================================
+// True LRU: the age of each way (0 for the most recent one) in its age
+// field. The layout is a parameter so that the specialized kernels (see
+// cache_kernels.h) get the accesses of their own layout only.
+
+// Cold start: the new way is the most recent one, all others get older
+static inline void lru_age_increase(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                    uint16_t line_index, uint8_t way) {
+    foreach_way(i, config->ways) {
+        uint8_t* age = cache_age_ptr_as(cache, config, layout, line_index, i);
+        if (i == way) {
+            *age = 0;
+        } else if (*age < config->ways - 1) {
+            ++*age;
+        }
+    }
+}
+
+// The way becomes the most recent one, the ones more recent than it get older
+static inline void lru_age_update(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                  uint16_t line_index, uint8_t way) {
+    uint8_t previous = *cache_age_ptr_as(cache, config, layout, line_index, way);
+    foreach_way(i, config->ways) {
+        uint8_t* age = cache_age_ptr_as(cache, config, layout, line_index, i);
+        if (i == way) {
+            *age = 0;
+        } else if (*age < previous) {
+            ++*age;
+        }
+    }
+}
+
+// The oldest way (the first one among equals)
+static inline uint8_t lru_victim(const void* cache, const cache_config_t* config, cache_layout_t layout,
+                                 uint16_t line_index) {
+    uint8_t way_max = 0;
+    uint8_t max = 0;
+    foreach_way(i, config->ways) {
+        uint8_t age = *cache_age_ptr_as(cache, config, layout, line_index, i);
+        if (max < age) {
+            max = age;
+            way_max = i;
+        }
+    }
+    return way_max;
+}
+
+//=========================================================================
+// Tree pseudo-LRU: the ways-1 nodes of a binary tree over the ways, stored
+// heap-wise (root at bit 1) in the set state. A node bit tells on which
+// side the next victim is (0: left, 1: right).
+
+// Points all nodes on the path to the accessed way away from it
+static inline void plru_tree_touch(uint64_t* bits, uint8_t ways, uint8_t way) {
+    unsigned int node = 1;
+    for (uint8_t half = ways >> 1; half != 0; half >>= 1) {
+        unsigned int right = (way & half) != 0;
+        if (right) *bits &= ~(UINT64_C(1) << node);
+        else       *bits |=  (UINT64_C(1) << node);
+        node = 2 * node + right;
+    }
+}
+
+// Follows the node bits down to the victim way
+static inline uint8_t plru_tree_victim(uint64_t bits, uint8_t ways) {
+    unsigned int node = 1;
+    while (node < ways) {
+        node = 2 * node + ((bits >> node) & 1u);
+    }
+    return (uint8_t) (node - ways);
+}
+
+//=========================================================================
+// Bit pseudo-LRU: one MRU bit per way in the set state. When all ways are
+// marked, all marks but the accessed way's one are cleared.
+
+static inline void plru_bit_touch(uint64_t* bits, uint8_t ways, uint8_t way) {
+    uint64_t all = ways == 64 ? ~UINT64_C(0) : (UINT64_C(1) << ways) - 1;
+    *bits |= UINT64_C(1) << way;
+    if ((*bits & all) == all) *bits = UINT64_C(1) << way;
+}
+
+// The first way that was not used recently
+static inline uint8_t plru_bit_victim(uint64_t bits, uint8_t ways) {
+    for (uint8_t way = 0; way < ways; ++way) {
+        if (!((bits >> way) & 1u)) return way;
+    }
+    return 0;
+}
+
+//=========================================================================
+// RRIP: the RRPV of each way is kept in its age field. A hit predicts a
+// near-immediate re-reference (RRPV 0); the victim is the first way with
+// a distant prediction (RRIP_MAX_RRPV), aging the whole set until one is.
+
+#define IS_RRIP(replace) ((replace) == SRRIP || (replace) == BRRIP || (replace) == DRRIP)
+
+typedef enum { RRIP_FOLLOWER, RRIP_SRRIP_LEADER, RRIP_BRRIP_LEADER } rrip_duel_t;
+
+// Role of a set in DRRIP set dueling
+static inline rrip_duel_t rrip_duel_role(const cache_config_t* config, uint16_t line_index) {
+    uint16_t period = config->lines < RRIP_DUEL_PERIOD ? config->lines : RRIP_DUEL_PERIOD;
+    uint16_t offset = line_index & (period - 1u);
+    if (period < 2) return RRIP_FOLLOWER;
+    if (offset == 0) return RRIP_SRRIP_LEADER;
+    if (offset == period - 1u) return RRIP_BRRIP_LEADER;
+    return RRIP_FOLLOWER;
+}
+
+// Insertion policy (SRRIP or BRRIP) actually used for a set
+static inline cache_replace_t rrip_insertion_policy(const void* cache, const cache_config_t* config,
+                                                    uint16_t line_index, cache_replace_t replace) {
+    if (replace != DRRIP) return replace;
+    switch (rrip_duel_role(config, line_index)) {
+    case RRIP_SRRIP_LEADER: return SRRIP;
+    case RRIP_BRRIP_LEADER: return BRRIP;
+    default: // SRRIP missing more than BRRIP in the leaders
+        return (cache_state(cache, config)->psel > RRIP_PSEL_MAX / 2) ? BRRIP : SRRIP;
+    }
+}
+
+// Sets the RRPV of a newly inserted way
+static inline void rrip_insert(void* cache, const cache_config_t* config, cache_layout_t layout,
+                               uint16_t line_index, uint8_t way, cache_replace_t replace) {
+    uint8_t rrpv = RRIP_MAX_RRPV - 1;
+    if (rrip_insertion_policy(cache, config, line_index, replace) == BRRIP) {
+        cache_state_t* state = cache_state(cache, config);
+        if (++state->brrip_tick < RRIP_BRRIP_LONG) rrpv = RRIP_MAX_RRPV;
+        else state->brrip_tick = 0;
+    }
+    *cache_age_ptr_as(cache, config, layout, line_index, way) = rrpv;
+}
+
+// DRRIP: a miss in a leader set votes against its policy
+static inline void rrip_miss(void* cache, const cache_config_t* config, uint16_t line_index) {
+    cache_state_t* state = cache_state(cache, config);
+    switch (rrip_duel_role(config, line_index)) {
+    case RRIP_SRRIP_LEADER:
+        if (state->psel < RRIP_PSEL_MAX) ++state->psel;
+        break;
+    case RRIP_BRRIP_LEADER:
+        if (state->psel > 0) --state->psel;
+        break;
+    default:
+        break;
+    }
+}
+
+// First way predicted to be re-referenced in the distant future
+static inline uint8_t rrip_victim(void* cache, const cache_config_t* config, cache_layout_t layout,
+                                  uint16_t line_index) {
+    for (;;) {
+        foreach_way(way, config->ways) {
+            if (*cache_age_ptr_as(cache, config, layout, line_index, way) >= RRIP_MAX_RRPV) return way;
+        }
+        foreach_way(way, config->ways) {
+            ++*cache_age_ptr_as(cache, config, layout, line_index, way);
+        }
     }
+}
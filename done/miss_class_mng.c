@@ -0,0 +1,164 @@
+/**
+ * @file miss_class_mng.c
+ * @brief 3C classification of the misses of a cache level (compulsory,
+ *        capacity, conflict)
+ *
+ * @date 2019
+ */
+
+#include "miss_class_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <inttypes.h> // for PRIu64
+
+#define CHUNK_WORDS ((1u << MISS_CLASS_CHUNK_BITS) / 64u)
+
+static inline uint32_t hash_line(const miss_class_t* mc, uint32_t line) {
+    return (line * 0x9E3779B1u) & mc->bucket_mask;
+}
+
+//=========================================================================
+int miss_class_init(miss_class_t * mc, uint8_t line_size, uint32_t capacity) {
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE(line_size != 0 && (line_size & (line_size - 1)) == 0, ERR_BAD_PARAMETER,
+              "%u: line size is not a power of 2", line_size);
+    M_REQUIRE(capacity >= 1 && capacity < MISS_CLASS_NIL / 2, ERR_BAD_PARAMETER, "%u: bad capacity", capacity);
+
+    zero_init_ptr(mc);
+    while ((1u << mc->line_bits) < line_size) ++mc->line_bits;
+    uint32_t line_bits_total = 32u - mc->line_bits;
+    mc->nb_chunks = line_bits_total > MISS_CLASS_CHUNK_BITS ? 1u << (line_bits_total - MISS_CLASS_CHUNK_BITS) : 1u;
+    mc->capacity = capacity;
+    mc->head = mc->tail = MISS_CLASS_NIL;
+
+    uint32_t nb_buckets = 1;
+    while (nb_buckets < 2 * capacity) nb_buckets <<= 1;
+    mc->bucket_mask = nb_buckets - 1;
+
+    mc->seen = calloc(mc->nb_chunks, sizeof(uint64_t*));
+    mc->nodes = calloc(capacity, sizeof(miss_class_node_t));
+    mc->buckets = malloc(nb_buckets * sizeof(uint32_t));
+    if (mc->seen == NULL || mc->nodes == NULL || mc->buckets == NULL) {
+        miss_class_free(mc);
+        return ERR_MEM;
+    }
+    for (uint32_t b = 0; b < nb_buckets; ++b) mc->buckets[b] = MISS_CLASS_NIL;
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+int miss_class_free(miss_class_t * mc) {
+    M_REQUIRE_NON_NULL(mc);
+
+    if (mc->seen != NULL) {
+        for (uint32_t c = 0; c < mc->nb_chunks; ++c) free(mc->seen[c]);
+    }
+    free(mc->seen);
+    free(mc->nodes);
+    free(mc->buckets);
+    zero_init_ptr(mc);
+    return ERR_NONE;
+}
+
+//=========================================================================
+// Sets the first touch bit of a line; returns whether it was already set.
+// Without memory for a new chunk, the line counts as already touched.
+static inline int touch(miss_class_t* mc, uint32_t line) {
+    uint64_t** chunk = &mc->seen[line >> MISS_CLASS_CHUNK_BITS];
+    if (*chunk == NULL && (*chunk = calloc(CHUNK_WORDS, sizeof(uint64_t))) == NULL) return 1;
+
+    uint32_t bit = line & ((1u << MISS_CLASS_CHUNK_BITS) - 1);
+    uint64_t mask = UINT64_C(1) << (bit % 64);
+    int seen = ((*chunk)[bit / 64] & mask) != 0;
+    (*chunk)[bit / 64] |= mask;
+    return seen;
+}
+
+// Shadow LRU list
+static inline void unlink_node(miss_class_t* mc, uint32_t n) {
+    miss_class_node_t* node = &mc->nodes[n];
+    if (node->prev != MISS_CLASS_NIL) mc->nodes[node->prev].next = node->next;
+    else                              mc->head = node->next;
+    if (node->next != MISS_CLASS_NIL) mc->nodes[node->next].prev = node->prev;
+    else                              mc->tail = node->prev;
+}
+
+static inline void push_front(miss_class_t* mc, uint32_t n) {
+    mc->nodes[n].prev = MISS_CLASS_NIL;
+    mc->nodes[n].next = mc->head;
+    if (mc->head != MISS_CLASS_NIL) mc->nodes[mc->head].prev = n;
+    mc->head = n;
+    if (mc->tail == MISS_CLASS_NIL) mc->tail = n;
+}
+
+// Shadow hash table
+static inline uint32_t find_node(const miss_class_t* mc, uint32_t line) {
+    uint32_t n = mc->buckets[hash_line(mc, line)];
+    while (n != MISS_CLASS_NIL && mc->nodes[n].line != line) n = mc->nodes[n].hnext;
+    return n;
+}
+
+static inline void unhash_node(miss_class_t* mc, uint32_t n) {
+    uint32_t* p = &mc->buckets[hash_line(mc, mc->nodes[n].line)];
+    while (*p != n) p = &mc->nodes[*p].hnext;
+    *p = mc->nodes[n].hnext;
+}
+
+static inline void hash_node(miss_class_t* mc, uint32_t n) {
+    uint32_t* bucket = &mc->buckets[hash_line(mc, mc->nodes[n].line)];
+    mc->nodes[n].hnext = *bucket;
+    *bucket = n;
+}
+
+// Accesses the shadow fully-associative LRU cache; returns whether it hit
+static inline int shadow_access(miss_class_t* mc, uint32_t line) {
+    uint32_t n = find_node(mc, line);
+    if (n != MISS_CLASS_NIL) {
+        if (n != mc->head) {
+            unlink_node(mc, n);
+            push_front(mc, n);
+        }
+        return 1;
+    }
+
+    if (mc->nb_nodes < mc->capacity) {
+        n = mc->nb_nodes++;
+    } else {
+        n = mc->tail;
+        unlink_node(mc, n);
+        unhash_node(mc, n);
+    }
+    mc->nodes[n].line = line;
+    hash_node(mc, n);
+    push_front(mc, n);
+    return 0;
+}
+
+void miss_class_access(miss_class_t * mc, uint32_t phy_addr, int hit) {
+    uint32_t line = phy_addr >> mc->line_bits;
+    int shadow_hit = shadow_access(mc, line);
+    int seen = touch(mc, line);
+    if (hit) return;
+
+    if (!seen)            ++mc->stats.compulsory;
+    else if (!shadow_hit) ++mc->stats.capacity;
+    else                  ++mc->stats.conflict;
+}
+
+//=========================================================================
+int miss_class_print(FILE * output, const char * name, const miss_class_t * mc) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(name);
+    M_REQUIRE_NON_NULL(mc);
+
+    const miss_class_stats_t* s = &mc->stats;
+    uint64_t misses = s->compulsory + s->capacity + s->conflict;
+    double scale = misses == 0 ? 0.0 : 100.0 / (double) misses;
+    fprintf(output, "%-9s: compulsory: %" PRIu64 " (%.2f%%), capacity: %" PRIu64 " (%.2f%%), conflict: %"
+            PRIu64 " (%.2f%%)\n", name, s->compulsory, scale * (double) s->compulsory,
+            s->capacity, scale * (double) s->capacity, s->conflict, scale * (double) s->conflict);
+    return ERR_NONE;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+/**
+ * @file miss_class_mng.h
+ * @brief 3C classification of the misses of a cache level (compulsory,
+ *        capacity, conflict)
+ *
+ * A miss is compulsory on the first access to its line, capacity if a
+ * fully-associative LRU cache of the same capacity misses too, conflict
+ * otherwise. The first touches are kept in a bitmap over the line
+ * numbers, allocated by chunks of 2^MISS_CLASS_CHUNK_BITS lines on demand;
+ * the shadow fully-associative cache is a hash table of its lines and an
+ * LRU list, both updated in O(1) per access.
+ *
+ * A classifier is attached to a cache with cache_set_classifier() and
+ * observes all its accesses in cache_hit(). The shadow cache only sees
+ * these accesses: for an exclusive L2 or L3, whose content also changes
+ * by promotions and victim inserts, a miss of the shadow cache is only an
+ * approximation of a capacity miss.
+ *
+ * @date 2019
+ */
+
+#include <stdint.h>
+#include <stdio.h> // for FILE
+
+#define MISS_CLASS_CHUNK_BITS  16u // 2^16 lines per bitmap chunk (8 KiB)
+#define MISS_CLASS_NIL         UINT32_MAX
+
+typedef struct {
+    uint64_t compulsory;
+    uint64_t capacity;
+    uint64_t conflict;
+} miss_class_stats_t;
+
+/**
+ * One line of the shadow fully-associative cache: in the LRU list
+ * (prev, next) and in a hash bucket (hnext).
+ */
+typedef struct {
+    uint32_t line;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t hnext;
+} miss_class_node_t;
+
+typedef struct {
+    uint8_t   line_bits;     // log2 of the line size
+    uint64_t** seen;         // bitmap chunks of the lines already accessed, NULL until touched
+    uint32_t  nb_chunks;
+    miss_class_node_t* nodes; // shadow lines, capacity of them
+    uint32_t  capacity;
+    uint32_t  nb_nodes;
+    uint32_t  head;          // most recently used
+    uint32_t  tail;          // least recently used
+    uint32_t* buckets;       // first node of each bucket
+    uint32_t  bucket_mask;
+    miss_class_stats_t stats;
+} miss_class_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for miss_class_t.
+ * @param mc (modified) the classifier to initialize
+ * @param line_size the line size of the cache (power of 2)
+ * @param capacity the number of lines of the cache (sets * ways)
+ * @return error code
+ */
+int miss_class_init(miss_class_t * mc, uint8_t line_size, uint32_t capacity);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for miss_class_t.
+ * @param mc the classifier
+ * @return error code
+ */
+int miss_class_free(miss_class_t * mc);
+
+//=========================================================================
+/**
+ * @brief Observes one access to the cache, and classifies it if a miss.
+ * @param mc the classifier
+ * @param phy_addr the physical address accessed
+ * @param hit whether the cache hit
+ */
+void miss_class_access(miss_class_t * mc, uint32_t phy_addr, int hit);
+
+//=========================================================================
+/**
+ * @brief Prints the classification of the misses of a cache level on one line.
+ * @param output the stream to print to
+ * @param name the name of the level (e.g. "L1_DCACHE")
+ * @param mc the classifier
+ * @return error code
+ */
+int miss_class_print(FILE * output, const char * name, const miss_class_t * mc);
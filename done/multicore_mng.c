@@ -0,0 +1,317 @@
+/**
+ * @file multicore_mng.c
+ * @brief multi-core simulation: one private hierarchy (TLBs, L1 and L2
+ *        caches) per core, an optional shared L3, and MESI coherence
+ *
+ * @date 2019
+ */
+
+#include "multicore_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <inttypes.h> // for PRIu64
+
+#define line_of(core, phy_addr) \
+    ((phy_addr) & ~(uint32_t) ((core)->hrchy.l1_config.line_size - 1))
+
+static inline uint32_t get_addr(const phy_addr_t* paddr) {
+    return ((uint32_t) paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset;
+}
+
+//=========================================================================
+// Owned (E or M) lines of a core
+
+static inline uint32_t* owned_slot(mc_core_t* core, uint32_t line) {
+    return &core->owned[(line >> core->hrchy.l1_config.line_bits) & (MULTICORE_OWNED_LINES - 1)];
+}
+
+static inline int owned(mc_core_t* core, uint32_t line) {
+    return *owned_slot(core, line) == (line | 1u);
+}
+
+static inline void owned_set(mc_core_t* core, uint32_t line) {
+    *owned_slot(core, line) = line | 1u;
+}
+
+// Clears the ownership of a line; returns whether it was owned
+static inline int owned_take(mc_core_t* core, uint32_t line) {
+    uint32_t* slot = owned_slot(core, line);
+    if (*slot != (line | 1u)) return 0;
+    *slot = 0;
+    return 1;
+}
+
+//=========================================================================
+int multicore_init(multicore_t * mc, uint8_t nb_cores, void * mem_space,
+                   const cache_config_t * l1_config, const cache_config_t * l2_config,
+                   const cache_config_t * l3_config, cache_replace_t replace) {
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE(nb_cores >= 1 && nb_cores <= MULTICORE_MAX_CORES, ERR_BAD_PARAMETER,
+              "%u: number of cores out of range", nb_cores);
+
+    zero_init_ptr(mc);
+    mc->mem_space = mem_space;
+    M_EXIT_IF_NULL(mc->cores = calloc(nb_cores, sizeof(mc_core_t)), nb_cores * sizeof(mc_core_t));
+    // multicore_free() destroys the bus lock whenever the cores array is
+    // allocated, and the locks of the nb_cores cores set up so far
+    pthread_mutex_init(&mc->bus, NULL);
+    if (l3_config != NULL) {
+        mc->l3_config = *l3_config;
+        int err = cache_alloc(&mc->l3_cache, &mc->l3_config);
+        if (err != ERR_NONE) {
+            multicore_free(mc);
+            return err;
+        }
+    }
+
+    for (; mc->nb_cores < nb_cores; ++mc->nb_cores) {
+        mc_core_t* core = &mc->cores[mc->nb_cores];
+        int err = cache_hrchy_init(&core->hrchy, mem_space, l1_config, l2_config, replace);
+        if (err == ERR_NONE && mc->l3_cache != NULL) {
+            err = cache_hrchy_share_l3(&core->hrchy, mc->l3_cache, &mc->l3_config, replace);
+            if (err != ERR_NONE) cache_hrchy_free(&core->hrchy);
+        }
+        if (err != ERR_NONE) {
+            multicore_free(mc);
+            return err;
+        }
+        pthread_mutex_init(&core->lock, NULL);
+    }
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+int multicore_free(multicore_t * mc) {
+    M_REQUIRE_NON_NULL(mc);
+
+    for (uint8_t i = 0; i < mc->nb_cores; ++i) {
+        cache_hrchy_free(&mc->cores[i].hrchy);
+        pthread_mutex_destroy(&mc->cores[i].lock);
+    }
+    if (mc->cores != NULL) pthread_mutex_destroy(&mc->bus);
+    free(mc->cores);
+    free(mc->l3_cache);
+    zero_init_ptr(mc);
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+/**
+ * @brief Serves an access from the L1 caches of its core only, if possible:
+ *        read hit, or write hit on an owned line of a write-back cache.
+ * @param done (modified) whether the access was served
+ * @return error code
+ */
+static int local_access(mc_core_t* core, const command_t* command, phy_addr_t* paddr, int* done) {
+    cache_hrchy_t* hrchy = &core->hrchy;
+    void* l1_cache = (command->type == INSTRUCTION) ? hrchy->l1_icache : hrchy->l1_dcache;
+    int present = 0;
+    *done = 0;
+
+    M_EXIT_IF_ERR_NOMSG(cache_probe(l1_cache, &hrchy->l1_config, paddr, &present));
+    if (!present) return ERR_NONE;
+    if (command->order == WRITE
+        && !(hrchy->l1_config.write_back && owned(core, line_of(core, get_addr(paddr))))) {
+        return ERR_NONE;
+    }
+
+    *done = 1;
+    ++core->stats.local;
+    return cache_hrchy_access_phy(hrchy, command, paddr);
+}
+
+/**
+ * @brief Serves an access on the bus: BusRd (read) or BusRdX (write) to
+ *        the other cores, then access to the private hierarchy, which may
+ *        go to the shared L3 and memory.
+ *
+ * The bus lock serializes the transactions; the lock of a snooped core
+ * is only held while it is snooped, unless the shared L3 is inclusive
+ * (its back-invalidations may then reach any core during the access).
+ * @return error code
+ */
+static int bus_access(multicore_t* mc, uint8_t c, const command_t* command, phy_addr_t* paddr) {
+    mc_core_t* core = &mc->cores[c];
+    uint32_t line = line_of(core, get_addr(paddr));
+    int is_write = (command->order == WRITE);
+    int lock_all = mc->l3_cache != NULL && mc->l3_config.inclusion == CACHE_INCLUSIVE;
+    int shared = 0;
+    int err = ERR_NONE;
+
+    pthread_mutex_lock(&mc->bus);
+    if (lock_all) {
+        for (uint8_t o = 0; o < mc->nb_cores; ++o) {
+            if (o != c) pthread_mutex_lock(&mc->cores[o].lock);
+        }
+    }
+
+    if (is_write) ++core->stats.bus_writes;
+    else          ++core->stats.bus_reads;
+
+    for (uint8_t o = 0; o < mc->nb_cores && err == ERR_NONE; ++o) {
+        if (o == c) continue;
+        mc_core_t* peer = &mc->cores[o];
+        int found = 0;
+        int dirty = 0;
+
+        if (!lock_all) pthread_mutex_lock(&peer->lock);
+        int was_owned = owned_take(peer, line);
+        err = cache_snoop(mc->mem_space, peer->hrchy.l2_cache, &peer->hrchy.l2_config, paddr,
+                          is_write, &found, &dirty);
+        if (found) {
+            shared = 1;
+            if (is_write) ++peer->stats.invalidations;
+            if (was_owned || dirty) ++peer->stats.transfers;
+        }
+        if (!lock_all) pthread_mutex_unlock(&peer->lock);
+    }
+
+    if (err == ERR_NONE) {
+        // a core only touches its own caches under the bus lock or its own lock
+        err = cache_hrchy_access_phy(&core->hrchy, command, paddr);
+        if (is_write || !shared) owned_set(core, line);
+        else                     (void) owned_take(core, line);
+    }
+
+    if (lock_all) {
+        for (uint8_t o = 0; o < mc->nb_cores; ++o) {
+            if (o != c) pthread_mutex_unlock(&mc->cores[o].lock);
+        }
+    }
+    pthread_mutex_unlock(&mc->bus);
+
+    return err;
+}
+
+//=========================================================================
+int multicore_access(multicore_t * mc, uint8_t core, const command_t * command) {
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE_NON_NULL(command);
+    M_REQUIRE(core < mc->nb_cores, ERR_BAD_PARAMETER, "%u: no such core", core);
+    M_REQUIRE(mc->cores[core].hrchy.prefetcher == NULL, ERR_BAD_PARAMETER, "%s",
+              "prefetchers are not coherent");
+
+    mc_core_t* c = &mc->cores[core];
+    phy_addr_t paddr;
+    M_EXIT_IF_ERR_NOMSG(cache_hrchy_translate(&c->hrchy, command, &paddr));
+
+    // a line-crossing access is one transaction per line
+    command_t parts[2];
+    phy_addr_t paddrs[2];
+    uint8_t nb = 0;
+    M_EXIT_IF_ERR_NOMSG(cache_hrchy_split(&c->hrchy, command, &paddr, parts, paddrs, &nb));
+    for (uint8_t p = 0; p < nb; ++p) {
+        int done = 0;
+        pthread_mutex_lock(&c->lock);
+        int err = local_access(c, &parts[p], &paddrs[p], &done);
+        pthread_mutex_unlock(&c->lock);
+        if (err == ERR_NONE && !done) err = bus_access(mc, core, &parts[p], &paddrs[p]);
+        M_EXIT_IF_ERR_NOMSG(err);
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+typedef struct {
+    multicore_t* mc;
+    uint8_t core;
+    const program_t* program;
+    int err;
+} mc_thread_t;
+
+static void* run_core(void* arg) {
+    mc_thread_t* t = arg;
+    t->err = ERR_NONE;
+    for_all_lines(line, t->program) {
+        if ((t->err = multicore_access(t->mc, t->core, line)) != ERR_NONE) break;
+    }
+    return NULL;
+}
+
+int multicore_run(multicore_t * mc, const program_t * programs, int threaded) {
+    M_REQUIRE_NON_NULL(mc);
+    M_REQUIRE_NON_NULL(programs);
+
+    if (!threaded) {
+        for (size_t i = 0, active = 1; active; ++i) {
+            active = 0;
+            for (uint8_t c = 0; c < mc->nb_cores; ++c) {
+                if (i >= programs[c].nb_lines) continue;
+                active = 1;
+                M_EXIT_IF_ERR_NOMSG(multicore_access(mc, c, &programs[c].listing[i]));
+            }
+        }
+        return ERR_NONE;
+    }
+
+    pthread_t threads[MULTICORE_MAX_CORES];
+    mc_thread_t args[MULTICORE_MAX_CORES];
+    uint8_t started = 0;
+    int err = ERR_NONE;
+    for (; started < mc->nb_cores; ++started) {
+        args[started] = (mc_thread_t) { .mc = mc, .core = started, .program = &programs[started], .err = ERR_NONE };
+        if (pthread_create(&threads[started], NULL, run_core, &args[started]) != 0) {
+            err = ERR_MEM;
+            break;
+        }
+    }
+    for (uint8_t c = 0; c < started; ++c) {
+        pthread_join(threads[c], NULL);
+        if (err == ERR_NONE) err = args[c].err;
+    }
+    return err;
+}
+
+//=========================================================================
+int multicore_clean(multicore_t * mc) {
+    M_REQUIRE_NON_NULL(mc);
+
+    if (mc->l3_cache != NULL) {
+        M_EXIT_IF_ERR_NOMSG(cache_clean(mc->mem_space, mc->l3_cache, &mc->l3_config));
+    }
+    for (uint8_t c = 0; c < mc->nb_cores; ++c) {
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_clean(&mc->cores[c].hrchy));
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+int multicore_print_stats(FILE * output, const multicore_t * mc) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(mc);
+
+    for (uint8_t c = 0; c < mc->nb_cores; ++c) {
+        const mesi_stats_t* s = &mc->cores[c].stats;
+        fprintf(output, "CORE %u\n", c);
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_print_stats(output, &mc->cores[c].hrchy));
+        fprintf(output, "%-9s: local: %" PRIu64 ", bus reads: %" PRIu64 ", bus writes: %" PRIu64
+                ", invalidations: %" PRIu64 ", transfers: %" PRIu64 "\n",
+                "MESI", s->local, s->bus_reads, s->bus_writes, s->invalidations, s->transfers);
+    }
+    if (mc->l3_cache != NULL) {
+        cache_stats_t stats;
+        M_EXIT_IF_ERR_NOMSG(cache_stats_get(mc->l3_cache, &mc->l3_config, &stats));
+        M_EXIT_IF_ERR_NOMSG(cache_stats_print(output, "L3_CACHE", &stats));
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+int multicore_dump(FILE * output, const multicore_t * mc) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(mc);
+
+    for (uint8_t c = 0; c < mc->nb_cores; ++c) {
+        fprintf(output, "CORE %u\n\n", c);
+        M_EXIT_IF_ERR_NOMSG(cache_hrchy_dump(output, &mc->cores[c].hrchy));
+    }
+    if (mc->l3_cache != NULL) {
+        fputs("L3_CACHE: \n\n", output);
+        M_EXIT_IF_ERR_NOMSG(cache_dump(output, mc->l3_cache, &mc->l3_config));
+    }
+    return ERR_NONE;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+ * @file multicore_mng.h
+ * @brief multi-core simulation: one private hierarchy (TLBs, L1 and L2
+ *        caches) per core, an optional shared L3, and MESI coherence
+ *
+ * Coherence is snoop based (bus): a core that misses in its L1 caches,
+ * or writes a line it does not own, takes the bus (global lock), snoops
+ * all the other cores and then accesses its own hierarchy. The MESI state
+ * of a line in a core is:
+ *  - I: no copy in the private caches of the core;
+ *  - S: a copy, the line not being owned by the core;
+ *  - E: a clean copy of an owned line;
+ *  - M: a dirty copy (write-back caches) of an owned line.
+ * Owned lines are kept per core in a small direct-mapped table; losing
+ * an entry to a conflict only costs a bus transaction.
+ *
+ * The cores can run on separate host threads: L1 read hits and write hits
+ * on owned lines (write-back caches) only take the lock of their core, all
+ * other accesses are serialized on the bus. The interleaving of the cores
+ * then depends on the host scheduling; multicore_run() can also interleave
+ * them round-robin on the calling thread, deterministically.
+ *
+ * @date 2019
+ */
+
+#include "cache_hrchy_mng.h"
+#include "commands.h"
+
+#include <pthread.h>
+#include <stdio.h> // for FILE
+
+#define MULTICORE_MAX_CORES   CACHE_MAX_UPPER // L2 caches above a shared L3
+#define MULTICORE_OWNED_LINES 4096u
+
+/**
+ * @brief Coherence statistics of one core.
+ */
+typedef struct {
+    uint64_t local;          // accesses served without taking the bus
+    uint64_t bus_reads;      // BusRd: read misses of this core
+    uint64_t bus_writes;     // BusRdX/BusUpgr: writes to lines not owned by this core
+    uint64_t invalidations;  // lines of this core invalidated by the writes of others
+    uint64_t transfers;      // lines supplied by this core (owned) to another one
+} mesi_stats_t;
+
+typedef struct {
+    cache_hrchy_t hrchy;
+    pthread_mutex_t lock;
+    uint32_t owned[MULTICORE_OWNED_LINES]; // line address | 1 for E/M lines, 0 if none
+    mesi_stats_t stats;
+} mc_core_t;
+
+typedef struct {
+    void* mem_space;
+    uint8_t nb_cores;
+    mc_core_t* cores;
+    cache_config_t l3_config;
+    void* l3_cache;          // shared L3, NULL for none
+    pthread_mutex_t bus;
+} multicore_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for multicore_t: allocates the private hierarchies
+ *        (all with the same geometries) and the shared L3, if any.
+ * @param mc (modified) the system to initialize
+ * @param nb_cores the number of cores (1 to MULTICORE_MAX_CORES)
+ * @param mem_space the memory space shared by the cores, see cache_hrchy_init()
+ * @param l1_config the geometry of the L1 caches
+ * @param l2_config the geometry of the private L2 caches
+ * @param l3_config the geometry of the shared L3 cache, NULL for none
+ * @param replace the replacement policy of the caches
+ * @return error code
+ */
+int multicore_init(multicore_t * mc, uint8_t nb_cores, void * mem_space,
+                   const cache_config_t * l1_config, const cache_config_t * l2_config,
+                   const cache_config_t * l3_config, cache_replace_t replace);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for multicore_t.
+ * @param mc the system
+ * @return error code
+ */
+int multicore_free(multicore_t * mc);
+
+//=========================================================================
+/**
+ * @brief Executes one command on one core. Thread-safe, as long as each
+ *        core is driven by a single thread.
+ * @param mc the system
+ * @param core the index of the core
+ * @param command the command
+ * @return error code
+ */
+int multicore_access(multicore_t * mc, uint8_t core, const command_t * command);
+
+//=========================================================================
+/**
+ * @brief Executes one program per core.
+ * @param mc the system
+ * @param programs mc->nb_cores programs, the one of core i first being programs[i]
+ * @param threaded whether each core runs on its own host thread, or all
+ *        the cores are interleaved round-robin (one command each) on the
+ *        calling thread
+ * @return error code
+ */
+int multicore_run(multicore_t * mc, const program_t * programs, int threaded);
+
+//=========================================================================
+/**
+ * @brief Writes the dirty lines of all the caches back to memory.
+ * @param mc the system
+ * @return error code
+ */
+int multicore_clean(multicore_t * mc);
+
+//=========================================================================
+/**
+ * @brief Prints the statistics of each core (caches and coherence), then
+ *        of the shared L3.
+ * @param output the stream to print to
+ * @param mc the system
+ * @return error code
+ */
+int multicore_print_stats(FILE * output, const multicore_t * mc);
+
+//=========================================================================
+/**
+ * @brief Dumps the caches of each core, then the shared L3.
+ * @param output the stream to print to
+ * @param mc the system
+ * @return error code
+ */
+int multicore_dump(FILE * output, const multicore_t * mc);
@@ -0,0 +1,173 @@
+/**
+ * @file prefetch_mng.c
+ * @brief hardware prefetcher models (next-line, stride, stream)
+ *
+ * @date 2019
+ */
+
+#include "prefetch_mng.h"
+#include "addr.h"
+#include "error.h"
+#include "util.h"
+
+#include <inttypes.h> // for PRIu64
+
+#define PAGE_OF(addr)  ((addr) >> PAGE_OFFSET)
+
+// Index of an address in the tracking table of issued prefetches
+static inline uint32_t track_index(const prefetcher_t* pf, uint32_t line_addr) {
+    return (line_addr >> pf->line_bits) & (PREFETCH_TRACK_SIZE - 1);
+}
+
+// Accounts a demand access to a line for the statistics: hit on a tracked
+// line is a useful prefetch; a miss on it means it was evicted unused
+static inline void track_access(prefetcher_t* pf, uint32_t line_addr, int hit) {
+    prefetch_track_t* t = &pf->track[track_index(pf, line_addr)];
+    int tracked = t->valid && t->line_addr == line_addr;
+
+    if (!hit) {
+        ++pf->stats.misses;
+    } else if (tracked) {
+        ++pf->stats.useful;
+        if (pf->accesses - t->issued_at < pf->late_window) ++pf->stats.late;
+    }
+    if (tracked) t->valid = 0;
+}
+
+// Adds the line at `offset` bytes from `base` to the candidates, unless it
+// leaves the page of `base` or is the line of `base` itself
+static inline void add_candidate(const prefetcher_t* pf, uint32_t base, int64_t offset,
+                                 uint32_t* candidates, uint8_t* nb) {
+    int64_t addr = (int64_t) base + offset;
+    if (addr < 0 || PAGE_OF((uint32_t) addr) != PAGE_OF(base)) return;
+
+    uint32_t line = (uint32_t) addr & ~((UINT32_C(1) << pf->line_bits) - 1);
+    if (line == (base & ~((UINT32_C(1) << pf->line_bits) - 1))) return;
+    if (*nb > 0 && candidates[*nb - 1] == line) return;
+    candidates[(*nb)++] = line;
+}
+
+// Trains the tracker of the page with a new access; it learns the byte
+// stride (stride prefetcher) or the line direction (stream prefetcher).
+// Returns the tracker if it is confident enough to prefetch, NULL otherwise.
+static inline const prefetch_entry_t* train(prefetcher_t* pf, uint32_t phy_addr) {
+    uint32_t page = PAGE_OF(phy_addr);
+    prefetch_entry_t* e = &pf->table[page & (PREFETCH_TABLE_SIZE - 1)];
+
+    if (!e->valid || e->page != page) {
+        e->valid = 1;
+        e->page = page;
+        e->last_addr = phy_addr;
+        e->stride = 0;
+        e->confidence = 0;
+        return NULL;
+    }
+
+    int32_t step = (int32_t) phy_addr - (int32_t) e->last_addr;
+    if (pf->kind == PREFETCH_STREAM) {
+        int32_t delta = (int32_t) (phy_addr >> pf->line_bits) - (int32_t) (e->last_addr >> pf->line_bits);
+        if (delta == 0) return e->confidence >= PREFETCH_CONFIDENT ? e : NULL; // same line
+        step = (delta > 0) ? 1 : -1;
+    }
+    if (step == 0) return NULL;
+
+    if (step == e->stride) {
+        if (e->confidence < UINT8_MAX) ++e->confidence;
+    } else {
+        e->stride = step;
+        e->confidence = 1;
+    }
+    e->last_addr = phy_addr;
+
+    return e->confidence >= PREFETCH_CONFIDENT ? e : NULL;
+}
+
+//=========================================================================
+int prefetcher_init(prefetcher_t * pf, prefetch_kind_t kind, prefetch_target_t target,
+                    uint8_t degree, uint8_t distance, uint8_t line_size) {
+    M_REQUIRE_NON_NULL(pf);
+    M_REQUIRE(kind >= PREFETCH_NONE && kind <= PREFETCH_STREAM, ERR_BAD_PARAMETER, "%d: unknown prefetcher", kind);
+    M_REQUIRE(target == PREFETCH_TO_L1 || target == PREFETCH_TO_L2, ERR_BAD_PARAMETER, "%d: unknown prefetch target", target);
+    M_REQUIRE(degree >= 1 && degree <= PREFETCH_MAX_DEGREE, ERR_BAD_PARAMETER, "%u: bad prefetch degree", degree);
+    M_REQUIRE(distance >= 1, ERR_BAD_PARAMETER, "%u: bad prefetch distance", distance);
+    M_REQUIRE(line_size != 0 && (line_size & (line_size - 1)) == 0, ERR_BAD_PARAMETER,
+              "%u: line size is not a power of 2", line_size);
+
+    zero_init_ptr(pf);
+    pf->kind = kind;
+    pf->target = target;
+    pf->degree = degree;
+    pf->distance = distance;
+    pf->late_window = PREFETCH_DEFAULT_LATE_WINDOW;
+    while ((1u << pf->line_bits) < line_size) ++pf->line_bits;
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+int prefetch_observe(prefetcher_t * pf, uint32_t phy_addr, int hit,
+                     uint32_t * candidates, uint8_t * nb_candidates) {
+    M_REQUIRE_NON_NULL(pf);
+    M_REQUIRE_NON_NULL(candidates);
+    M_REQUIRE_NON_NULL(nb_candidates);
+
+    uint32_t line_size = UINT32_C(1) << pf->line_bits;
+    ++pf->accesses;
+    *nb_candidates = 0;
+    track_access(pf, phy_addr & ~(line_size - 1), hit);
+
+    switch (pf->kind) {
+    case PREFETCH_NEXT_LINE:
+        if (hit) break;
+        for (uint8_t i = 0; i < pf->degree; ++i) {
+            add_candidate(pf, phy_addr, (int64_t) (pf->distance + i) * line_size, candidates, nb_candidates);
+        }
+        break;
+
+    case PREFETCH_STRIDE:
+    case PREFETCH_STREAM: {
+        const prefetch_entry_t* e = train(pf, phy_addr);
+        if (e == NULL) break;
+        // a stream advances by lines, a stride by its own step
+        int64_t step = (pf->kind == PREFETCH_STREAM) ? (int64_t) e->stride * line_size : e->stride;
+        for (uint8_t i = 0; i < pf->degree; ++i) {
+            add_candidate(pf, phy_addr, (int64_t) (pf->distance + i) * step, candidates, nb_candidates);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+int prefetch_issued(prefetcher_t * pf, uint32_t line_addr) {
+    M_REQUIRE_NON_NULL(pf);
+
+    prefetch_track_t* t = &pf->track[track_index(pf, line_addr)];
+    t->valid = 1;
+    t->line_addr = line_addr;
+    t->issued_at = pf->accesses;
+    ++pf->stats.issued;
+
+    return ERR_NONE;
+}
+
+//=========================================================================
+int prefetch_stats_print(FILE * output, const prefetcher_t * pf) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(pf);
+
+    const prefetch_stats_t* s = &pf->stats;
+    double accuracy = s->issued == 0 ? 0.0 : 100.0 * (double) s->useful / (double) s->issued;
+    double coverage = s->useful + s->misses == 0 ? 0.0 : 100.0 * (double) s->useful / (double) (s->useful + s->misses);
+    double timeliness = s->useful == 0 ? 0.0 : 100.0 * (double) (s->useful - s->late) / (double) s->useful;
+
+    fprintf(output, "%-9s: issued: %" PRIu64 ", useful: %" PRIu64 ", late: %" PRIu64
+            ", accuracy: %.2f%%, coverage: %.2f%%, timeliness: %.2f%%\n",
+            "PREFETCH", s->issued, s->useful, s->late, accuracy, coverage, timeliness);
+    return ERR_NONE;
+}
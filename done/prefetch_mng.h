@@ -0,0 +1,126 @@
+#pragma once
+
+/**
+ * @file prefetch_mng.h
+ * @brief hardware prefetcher models (next-line, stride, stream)
+ *
+ * A prefetcher observes the demand data accesses (physical address and
+ * whether they hit the prefetch target level) and proposes lines to
+ * prefetch; issuing them is left to the caller (see cache_prefetch()),
+ * which reports back with prefetch_issued(). Prefetches never cross a
+ * physical page boundary.
+ *
+ * There is no program counter in the traces, hence the stride prefetcher
+ * is indexed by physical page instead of by PC.
+ *
+ * @date 2019
+ */
+
+#include <stdint.h>
+#include <stdio.h> // for FILE
+
+typedef enum {
+    PREFETCH_NONE,
+    PREFETCH_NEXT_LINE, // on a miss, the next `degree` lines
+    PREFETCH_STRIDE,    // constant stride between the accesses to a page
+    PREFETCH_STREAM     // ascending or descending sequence of lines in a page
+} prefetch_kind_t;
+
+typedef enum { PREFETCH_TO_L1, PREFETCH_TO_L2 } prefetch_target_t;
+
+#define PREFETCH_MAX_DEGREE    16u
+#define PREFETCH_TABLE_SIZE    64u   // stride/stream trackers, direct mapped on the page
+#define PREFETCH_TRACK_SIZE    4096u // issued prefetches followed for the statistics
+#define PREFETCH_CONFIDENT     2u    // confirmations needed before prefetching
+#define PREFETCH_DEFAULT_LATE_WINDOW 8u
+
+/**
+ * Per page tracker of the stride and stream prefetchers.
+ */
+typedef struct {
+    uint32_t page;       // physical page number
+    uint32_t last_addr;  // last accessed physical address
+    int32_t  stride;     // bytes (stride) or +/-1 line (stream)
+    uint8_t  confidence;
+    uint8_t  valid;
+} prefetch_entry_t;
+
+/**
+ * An issued prefetch, until its first demand access.
+ */
+typedef struct {
+    uint32_t line_addr;
+    uint8_t  valid;
+    uint64_t issued_at;  // in demand accesses
+} prefetch_track_t;
+
+/**
+ * @brief Prefetcher statistics.
+ *
+ * accuracy = useful / issued, coverage = useful / (useful + misses),
+ * timeliness = (useful - late) / useful.
+ */
+typedef struct {
+    uint64_t issued;    // prefetches that brought a line
+    uint64_t useful;    // prefetched lines hit by a demand access
+    uint64_t late;      // useful, but hit less than late_window accesses after issue
+    uint64_t misses;    // demand misses left at the target level
+} prefetch_stats_t;
+
+typedef struct {
+    prefetch_kind_t kind;
+    prefetch_target_t target;
+    uint8_t  degree;       // lines per trigger
+    uint8_t  distance;     // how many lines ahead the first prefetched line is
+    uint8_t  line_bits;    // log2 of the line size
+    uint32_t late_window;  // memory latency, in demand accesses
+    uint64_t accesses;
+    prefetch_entry_t table[PREFETCH_TABLE_SIZE];
+    prefetch_track_t track[PREFETCH_TRACK_SIZE];
+    prefetch_stats_t stats;
+} prefetcher_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for prefetcher_t.
+ * @param pf (modified) the prefetcher to initialize
+ * @param kind its algorithm
+ * @param target the cache level it fills
+ * @param degree number of lines prefetched per trigger (1 to PREFETCH_MAX_DEGREE)
+ * @param distance how many lines ahead of the access it prefetches (at least 1)
+ * @param line_size the line size of the caches
+ * @return error code
+ */
+int prefetcher_init(prefetcher_t * pf, prefetch_kind_t kind, prefetch_target_t target,
+                    uint8_t degree, uint8_t distance, uint8_t line_size);
+
+//=========================================================================
+/**
+ * @brief Trains the prefetcher with a demand access and proposes lines to prefetch.
+ * @param pf the prefetcher
+ * @param phy_addr the physical address of the access
+ * @param hit whether the access hit the target level (or a level above it)
+ * @param candidates (modified) line addresses to prefetch, at most PREFETCH_MAX_DEGREE
+ * @param nb_candidates (modified) how many there are
+ * @return error code
+ */
+int prefetch_observe(prefetcher_t * pf, uint32_t phy_addr, int hit,
+                     uint32_t * candidates, uint8_t * nb_candidates);
+
+//=========================================================================
+/**
+ * @brief Tells the prefetcher that one of its candidates brought a line.
+ * @param pf the prefetcher
+ * @param line_addr the address of the line
+ * @return error code
+ */
+int prefetch_issued(prefetcher_t * pf, uint32_t line_addr);
+
+//=========================================================================
+/**
+ * @brief Prints the statistics of a prefetcher on one line.
+ * @param output the stream to print to
+ * @param pf the prefetcher
+ * @return error code
+ */
+int prefetch_stats_print(FILE * output, const prefetcher_t * pf);
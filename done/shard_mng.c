@@ -0,0 +1,173 @@
+/**
+ * @file shard_mng.c
+ * @brief set-sharded parallel execution of one program through a hierarchy
+ *
+ * @date 2019
+ */
+
+#include "shard_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#define NB_CACHES 4 // L1I, L1D, L2, L3
+
+typedef struct {
+    cache_hrchy_t* hrchy;      // the hierarchy the shard is merged into
+    cache_hrchy_t shard;       // private copy of its caches
+    uint16_t index;
+    uint16_t mask;             // nb_shards - 1
+    const program_t* program;
+    const phy_addr_t* paddrs;  // translations of the program commands
+    int err;
+} shard_t;
+
+static inline int sharded_policy(cache_replace_t replace) {
+    return replace != BRRIP && replace != DRRIP;
+}
+
+// Caches of a hierarchy, and their geometries, in the same order
+static void hrchy_caches(cache_hrchy_t* hrchy, void* caches[], const cache_config_t* configs[]) {
+    caches[0] = hrchy->l1_icache;
+    caches[1] = hrchy->l1_dcache;
+    caches[2] = hrchy->l2_cache;
+    caches[3] = hrchy->l3_cache;
+    configs[0] = configs[1] = &hrchy->l1_config;
+    configs[2] = &hrchy->l2_config;
+    configs[3] = &hrchy->l3_config;
+}
+
+//=========================================================================
+/**
+ * @brief Allocates the private caches of a shard, with the content of the
+ *        sets of the shard in the hierarchy.
+ * @return error code
+ */
+static int shard_init(shard_t* s) {
+    cache_hrchy_t* hrchy = s->hrchy;
+    M_EXIT_IF_ERR_NOMSG(cache_hrchy_init(&s->shard, hrchy->mem_space, &hrchy->l1_config,
+                                         &hrchy->l2_config, hrchy->replace));
+    int err = ERR_NONE;
+    if (hrchy->l3_cache != NULL) {
+        err = cache_hrchy_add_l3(&s->shard, &hrchy->l3_config, hrchy->l3_replace);
+    }
+
+    void* from[NB_CACHES];
+    void* to[NB_CACHES];
+    const cache_config_t* configs[NB_CACHES];
+    hrchy_caches(hrchy, from, configs);
+    hrchy_caches(&s->shard, to, configs);
+    for (size_t c = 0; c < NB_CACHES && err == ERR_NONE; ++c) {
+        if (from[c] != NULL) err = cache_copy_sets(to[c], from[c], configs[c], s->mask, s->index);
+    }
+    if (err != ERR_NONE) cache_hrchy_free(&s->shard);
+    return err;
+}
+
+// Executes the commands of a shard
+static void* shard_exec(void* arg) {
+    shard_t* s = arg;
+    uint8_t line_bits = s->shard.l1_config.line_bits;
+    for (size_t i = 0; i < s->program->nb_lines && s->err == ERR_NONE; ++i) {
+        // the two lines of a line-crossing access may belong to different shards
+        command_t parts[2];
+        phy_addr_t paddrs[2];
+        uint8_t nb = 0;
+        s->err = cache_hrchy_split(&s->shard, &s->program->listing[i], &s->paddrs[i], parts, paddrs, &nb);
+        for (uint8_t p = 0; p < nb && s->err == ERR_NONE; ++p) {
+            uint32_t phy_addr = ((uint32_t) paddrs[p].phy_page_num << PAGE_OFFSET) | paddrs[p].page_offset;
+            if (((phy_addr >> line_bits) & s->mask) != s->index) continue;
+            s->err = cache_hrchy_access_phy(&s->shard, &parts[p], &paddrs[p]);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copies the sets of a shard back into the hierarchy, adds its
+ *        statistics and frees it.
+ * @return error code
+ */
+static int shard_merge(shard_t* s) {
+    void* from[NB_CACHES];
+    void* to[NB_CACHES];
+    const cache_config_t* configs[NB_CACHES];
+    hrchy_caches(&s->shard, from, configs);
+    hrchy_caches(s->hrchy, to, configs);
+
+    int err = ERR_NONE;
+    for (size_t c = 0; c < NB_CACHES && err == ERR_NONE; ++c) {
+        if (to[c] == NULL) continue;
+        cache_stats_t stats;
+        err = cache_copy_sets(to[c], from[c], configs[c], s->mask, s->index);
+        if (err == ERR_NONE) err = cache_stats_get(from[c], configs[c], &stats);
+        if (err == ERR_NONE) err = cache_stats_add(to[c], configs[c], &stats);
+    }
+    cache_hrchy_free(&s->shard);
+    return err;
+}
+
+//=========================================================================
+int shard_run(cache_hrchy_t * hrchy, const program_t * program, uint8_t nb_shards) {
+    M_REQUIRE_NON_NULL(hrchy);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(nb_shards >= 1 && nb_shards <= SHARD_MAX && (nb_shards & (nb_shards - 1)) == 0,
+              ERR_BAD_PARAMETER, "%u: number of shards not a power of 2 up to SHARD_MAX", nb_shards);
+    M_REQUIRE(nb_shards <= hrchy->l1_config.lines && nb_shards <= hrchy->l2_config.lines
+              && (hrchy->l3_cache == NULL || nb_shards <= hrchy->l3_config.lines),
+              ERR_BAD_PARAMETER, "%u: more shards than sets", nb_shards);
+    M_REQUIRE(hrchy->prefetcher == NULL && hrchy->sample_units == NULL && hrchy->classifiers == NULL
+              && hrchy->heat == NULL && !hrchy->l3_shared, ERR_BAD_PARAMETER, "%s",
+              "prefetchers, set sampling, miss classification, heat maps and shared L3 cross the shards");
+    M_REQUIRE(sharded_policy(hrchy->replace) && (hrchy->l3_cache == NULL || sharded_policy(hrchy->l3_replace)),
+              ERR_POLICY, "%s", "BRRIP and DRRIP have cache-wide state");
+
+    phy_addr_t* paddrs = calloc(program->nb_lines > 0 ? program->nb_lines : 1, sizeof(phy_addr_t));
+    shard_t* shards = calloc(nb_shards, sizeof(shard_t));
+    if (paddrs == NULL || shards == NULL) {
+        free(paddrs);
+        free(shards);
+        return ERR_MEM;
+    }
+
+    // the TLBs see all the accesses, in order
+    int err = ERR_NONE;
+    for (size_t i = 0; i < program->nb_lines && err == ERR_NONE; ++i) {
+        err = cache_hrchy_translate(hrchy, &program->listing[i], &paddrs[i]);
+    }
+
+    uint16_t nb_init = 0;
+    for (; nb_init < nb_shards && err == ERR_NONE; ++nb_init) {
+        shards[nb_init] = (shard_t) { .hrchy = hrchy, .index = nb_init, .mask = (uint16_t) (nb_shards - 1),
+                                      .program = program, .paddrs = paddrs, .err = ERR_NONE };
+        err = shard_init(&shards[nb_init]);
+        if (err != ERR_NONE) break;
+    }
+
+    if (err == ERR_NONE) {
+        // shard 0 on the calling thread; a shard whose thread cannot be
+        // started is executed there too
+        pthread_t threads[SHARD_MAX];
+        int started[SHARD_MAX] = { 0 };
+        for (uint16_t k = 1; k < nb_shards; ++k) {
+            started[k] = pthread_create(&threads[k], NULL, shard_exec, &shards[k]) == 0;
+        }
+        for (uint16_t k = 0; k < nb_shards; ++k) {
+            if (!started[k]) shard_exec(&shards[k]);
+        }
+        for (uint16_t k = 1; k < nb_shards; ++k) {
+            if (started[k]) pthread_join(threads[k], NULL);
+        }
+        for (uint16_t k = 0; k < nb_shards && err == ERR_NONE; ++k) err = shards[k].err;
+    }
+
+    for (uint16_t k = 0; k < nb_init; ++k) {
+        int merged = shard_merge(&shards[k]);
+        if (err == ERR_NONE) err = merged;
+    }
+    free(paddrs);
+    free(shards);
+    return err;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+/**
+ * @file shard_mng.h
+ * @brief set-sharded parallel execution of one program through a hierarchy
+ *
+ * The caches all have the same line size, so the low bits of the line
+ * number are part of the set index of every level. Split on these bits,
+ * the accesses form independent shards: a set of any level, and hence its
+ * replacements, victims, promotions and back-invalidations, only ever
+ * holds lines of one shard. (Sharding on the L2 index bits instead would
+ * split the L1 sets, whose lines compete with each other.)
+ *
+ * The TLBs are shared by all the accesses, so the program is first
+ * translated serially; each shard then runs on its own host thread in a
+ * private copy of the caches, and its sets and statistics are merged back.
+ * The hierarchy ends up exactly as after cache_hrchy_run(), as long as no
+ * cache-wide state steers the replacements: BRRIP and DRRIP are refused.
+ *
+ * @date 2019
+ */
+
+#include "cache_hrchy_mng.h"
+#include "commands.h"
+
+#define SHARD_MAX 64u
+
+//=========================================================================
+/**
+ * @brief Executes all the commands of a program, like cache_hrchy_run()
+ *        (without dump), on several host threads.
+ * @param hrchy the hierarchy, without prefetcher, set sampling, miss
+ *        classification, heat maps nor shared L3, whose caches are LRU, PLRU or SRRIP
+ * @param program the program to execute
+ * @param nb_shards number of shards (threads): a power of 2, at most
+ *        SHARD_MAX and the number of sets of each cache
+ * @return error code
+ */
+int shard_run(cache_hrchy_t * hrchy, const program_t * program, uint8_t nb_shards);
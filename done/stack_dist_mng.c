@@ -0,0 +1,223 @@
+/**
+ * @file stack_dist_mng.c
+ * @brief single-pass LRU stack distance analysis (Mattson) and miss-ratio
+ *        curves for every number of sets and associativity
+ *
+ * @date 2019
+ */
+
+#include "stack_dist_mng.h"
+#include "addr_mng.h"
+#include "page_walk.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <string.h> // for memset
+#include <inttypes.h> // for PRIu64
+
+#define NB_BUCKETS (STACK_DIST_MAX_WAYS + 1u)
+
+//=========================================================================
+int stack_dist_init(stack_dist_t * sd, uint8_t line_size, uint8_t max_set_bits) {
+    M_REQUIRE_NON_NULL(sd);
+    M_REQUIRE(line_size != 0 && (line_size & (line_size - 1)) == 0, ERR_BAD_PARAMETER,
+              "%u: line size is not a power of 2", line_size);
+    M_REQUIRE(max_set_bits <= STACK_DIST_MAX_SET_BITS, ERR_BAD_PARAMETER,
+              "%u: too many sets", max_set_bits);
+
+    zero_init_ptr(sd);
+    while ((1u << sd->line_bits) < line_size) ++sd->line_bits;
+    sd->max_set_bits = max_set_bits;
+
+    size_t nb = (size_t) max_set_bits + 1;
+    M_EXIT_IF_NULL(sd->cold = calloc(nb, sizeof(uint64_t)), nb * sizeof(uint64_t));
+    if ((sd->histogram = calloc(nb * NB_BUCKETS, sizeof(uint64_t))) == NULL) {
+        free(sd->cold);
+        sd->cold = NULL;
+        M_EXIT_IF_NULL(sd->histogram, nb * NB_BUCKETS * sizeof(uint64_t));
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+int stack_dist_free(stack_dist_t * sd) {
+    M_REQUIRE_NON_NULL(sd);
+
+    free(sd->cold);
+    free(sd->histogram);
+    zero_init_ptr(sd);
+    return ERR_NONE;
+}
+
+//=========================================================================
+// Fenwick tree (1-based) of counts
+
+static inline void fenwick_add(uint32_t* tree, size_t size, size_t pos, int32_t delta) {
+    for (; pos <= size; pos += pos & (~pos + 1)) tree[pos] += (uint32_t) delta;
+}
+
+static inline uint32_t fenwick_prefix(const uint32_t* tree, size_t pos) {
+    uint32_t sum = 0;
+    for (; pos > 0; pos &= pos - 1) sum += tree[pos];
+    return sum;
+}
+
+//=========================================================================
+static int compare_u32(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Translates the accesses of a program to line numbers.
+ * @param lines (modified) program->nb_lines line numbers, to be freed
+ * @return error code
+ */
+static int program_lines(const stack_dist_t* sd, const void* mem_space, const program_t* program,
+                         uint32_t** lines) {
+    M_EXIT_IF_NULL(*lines = calloc(program->nb_lines > 0 ? program->nb_lines : 1, sizeof(uint32_t)),
+                   program->nb_lines * sizeof(uint32_t));
+
+    for (size_t i = 0; i < program->nb_lines; ++i) {
+        const virt_addr_t* vaddr = &program->listing[i].vaddr;
+        phy_addr_t paddr;
+        if (mem_space == NULL) {
+            paddr.phy_page_num = (uint32_t) (virt_addr_t_to_virtual_page_number(vaddr) & ((UINT32_C(1) << PHY_PAGE_NUM) - 1));
+            paddr.page_offset = vaddr->page_offset;
+        } else {
+            int err = page_walk(mem_space, vaddr, &paddr);
+            if (err != ERR_NONE) {
+                free(*lines);
+                *lines = NULL;
+                return err;
+            }
+        }
+        (*lines)[i] = (((uint32_t) paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset) >> sd->line_bits;
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+/**
+ * @brief Accumulates the distances for one number of sets.
+ * @param ids dense identifiers of the lines of the accesses
+ * @param last (modified, scratch) per line identifier, Fenwick position of
+ *        its last access, 0 for none
+ * @return error code
+ */
+static int run_set_count(stack_dist_t* sd, uint8_t set_bits, const uint32_t* lines, const uint32_t* ids,
+                         size_t n, uint32_t* last, size_t nb_ids) {
+    size_t nb_sets = (size_t) 1 << set_bits;
+    uint32_t* next = calloc(nb_sets, sizeof(uint32_t));    // next Fenwick position of each set
+    uint32_t* tree = calloc(n + 1, sizeof(uint32_t));
+    if (next == NULL || tree == NULL) {
+        free(next);
+        free(tree);
+        return ERR_MEM;
+    }
+
+    // the accesses are laid out set by set in the tree, each set in order
+    for (size_t i = 0; i < n; ++i) ++next[lines[i] & (nb_sets - 1)];
+    uint32_t start = 1;
+    for (size_t s = 0; s < nb_sets; ++s) {
+        uint32_t count = next[s];
+        next[s] = start;
+        start += count;
+    }
+    memset(last, 0, nb_ids * sizeof(uint32_t));
+
+    uint64_t* histogram = &sd->histogram[set_bits * NB_BUCKETS];
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t pos = next[lines[i] & (nb_sets - 1)]++;
+        uint32_t prev = last[ids[i]];
+        if (prev == 0) {
+            ++sd->cold[set_bits];
+        } else {
+            // lines of the set whose last access is between the two ones
+            uint32_t distance = fenwick_prefix(tree, pos) - fenwick_prefix(tree, prev);
+            ++histogram[distance < STACK_DIST_MAX_WAYS ? distance : STACK_DIST_MAX_WAYS];
+            fenwick_add(tree, n, prev, -1);
+        }
+        fenwick_add(tree, n, pos, 1);
+        last[ids[i]] = pos;
+    }
+
+    free(next);
+    free(tree);
+    return ERR_NONE;
+}
+
+int stack_dist_run(stack_dist_t * sd, const void * mem_space, const program_t * program) {
+    M_REQUIRE_NON_NULL(sd);
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE(program->nb_lines < UINT32_MAX, ERR_BAD_PARAMETER, "%s", "program too long");
+
+    size_t n = program->nb_lines;
+    uint32_t* lines = NULL;
+    M_EXIT_IF_ERR_NOMSG(program_lines(sd, mem_space, program, &lines));
+
+    // dense identifiers of the lines: their ranks among the distinct ones
+    uint32_t* sorted = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+    uint32_t* ids = malloc((n > 0 ? n : 1) * sizeof(uint32_t));
+    if (sorted == NULL || ids == NULL) {
+        free(lines);
+        free(sorted);
+        free(ids);
+        return ERR_MEM;
+    }
+    memcpy(sorted, lines, n * sizeof(uint32_t));
+    qsort(sorted, n, sizeof(uint32_t), compare_u32);
+    size_t nb_ids = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (nb_ids == 0 || sorted[nb_ids - 1] != sorted[i]) sorted[nb_ids++] = sorted[i];
+    }
+    for (size_t i = 0; i < n; ++i) {
+        ids[i] = (uint32_t) ((uint32_t*) bsearch(&lines[i], sorted, nb_ids, sizeof(uint32_t), compare_u32) - sorted);
+    }
+
+    int err = ERR_NONE;
+    for (uint8_t set_bits = 0; set_bits <= sd->max_set_bits && err == ERR_NONE; ++set_bits) {
+        // the same scratch array (sorted) holds the last positions
+        err = run_set_count(sd, set_bits, lines, ids, n, sorted, nb_ids);
+    }
+    if (err == ERR_NONE) sd->accesses += n;
+
+    free(lines);
+    free(sorted);
+    free(ids);
+    return err;
+}
+
+//=========================================================================
+int stack_dist_miss_ratio(const stack_dist_t * sd, uint8_t set_bits, uint16_t ways, double * ratio) {
+    M_REQUIRE_NON_NULL(sd);
+    M_REQUIRE_NON_NULL(ratio);
+    M_REQUIRE(set_bits <= sd->max_set_bits, ERR_BAD_PARAMETER, "%u: set count not analysed", set_bits);
+    M_REQUIRE(ways >= 1 && ways <= STACK_DIST_MAX_WAYS, ERR_BAD_PARAMETER, "%u: bad associativity", ways);
+
+    const uint64_t* histogram = &sd->histogram[set_bits * NB_BUCKETS];
+    uint64_t misses = sd->cold[set_bits];
+    for (size_t d = ways; d < NB_BUCKETS; ++d) misses += histogram[d];
+    *ratio = sd->accesses == 0 ? 0.0 : (double) misses / (double) sd->accesses;
+    return ERR_NONE;
+}
+
+//=========================================================================
+int stack_dist_print(FILE * output, const stack_dist_t * sd) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(sd);
+
+    fprintf(output, "%-9s: accesses: %" PRIu64 ", line size: %u\n", "STACKDIST",
+            sd->accesses, 1u << sd->line_bits);
+    fprintf(output, "%6s %5s %12s %9s\n", "sets", "ways", "bytes", "miss");
+    for (uint8_t set_bits = 0; set_bits <= sd->max_set_bits; ++set_bits) {
+        for (uint16_t ways = 1; ways <= STACK_DIST_MAX_WAYS; ways *= 2) {
+            double ratio = 0.0;
+            M_EXIT_IF_ERR_NOMSG(stack_dist_miss_ratio(sd, set_bits, ways, &ratio));
+            fprintf(output, "%6u %5u %12" PRIu64 " %8.2f%%\n", 1u << set_bits, ways,
+                    ((uint64_t) ways << (set_bits + sd->line_bits)), 100.0 * ratio);
+        }
+    }
+    return ERR_NONE;
+}
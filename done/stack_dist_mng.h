@@ -0,0 +1,89 @@
+#pragma once
+
+/**
+ * @file stack_dist_mng.h
+ * @brief single-pass LRU stack distance analysis (Mattson) and miss-ratio
+ *        curves for every number of sets and associativity
+ *
+ * The stack distance of an access is the number of distinct other lines
+ * of its set accessed since the previous access to its line; an access
+ * hits an LRU cache of `ways` ways iff its distance is below `ways`. One
+ * pass over the program computes the distances for every power-of-2
+ * number of sets at once: for each of them, a Fenwick tree over the
+ * accesses, grouped set by set, marks the most recent access to each line,
+ * so that a distance is a range count (O(log n) per access and set count).
+ *
+ * The analysis is of a single unified cache seeing all the accesses of the
+ * program (instructions and data), e.g. for LLC sizing; it ignores the
+ * filtering done by the levels above it.
+ *
+ * @date 2019
+ */
+
+#include "commands.h"
+
+#include <stdint.h>
+#include <stdio.h> // for FILE
+
+#define STACK_DIST_MAX_WAYS     256u // deeper distances are only counted as misses
+#define STACK_DIST_MAX_SET_BITS 15u  // up to 32768 sets, as cache_config_t
+
+typedef struct {
+    uint8_t  line_bits;      // log2 of the line size
+    uint8_t  max_set_bits;   // set counts analysed: 1, 2, 4... 2^max_set_bits
+    uint64_t accesses;
+    uint64_t* cold;          // per set count: first accesses to a line
+    uint64_t* histogram;     // per set count: STACK_DIST_MAX_WAYS + 1 distance buckets,
+                             // the last one for all the deeper ones
+} stack_dist_t;
+
+//=========================================================================
+/**
+ * @brief "Constructor" for stack_dist_t.
+ * @param sd (modified) the analysis to initialize
+ * @param line_size the line size (power of 2)
+ * @param max_set_bits log2 of the largest number of sets analysed
+ *        (at most STACK_DIST_MAX_SET_BITS)
+ * @return error code
+ */
+int stack_dist_init(stack_dist_t * sd, uint8_t line_size, uint8_t max_set_bits);
+
+//=========================================================================
+/**
+ * @brief "Destructor" for stack_dist_t.
+ * @param sd the analysis
+ * @return error code
+ */
+int stack_dist_free(stack_dist_t * sd);
+
+//=========================================================================
+/**
+ * @brief Accumulates the stack distances of all the accesses of a program.
+ * @param sd the analysis
+ * @param mem_space the memory space, to translate the virtual addresses;
+ *        if NULL, virtual addresses are used as physical ones
+ * @param program the program
+ * @return error code
+ */
+int stack_dist_run(stack_dist_t * sd, const void * mem_space, const program_t * program);
+
+//=========================================================================
+/**
+ * @brief Miss ratio of an LRU cache of the given geometry.
+ * @param sd the analysis
+ * @param set_bits log2 of the number of sets (at most sd->max_set_bits)
+ * @param ways the associativity (1 to STACK_DIST_MAX_WAYS)
+ * @param ratio (modified) misses / accesses, 0 without any access
+ * @return error code
+ */
+int stack_dist_miss_ratio(const stack_dist_t * sd, uint8_t set_bits, uint16_t ways, double * ratio);
+
+//=========================================================================
+/**
+ * @brief Prints the miss-ratio curves: one line per number of sets and
+ *        power-of-2 associativity, with the capacity and the miss ratio.
+ * @param output the stream to print to
+ * @param sd the analysis
+ * @return error code
+ */
+int stack_dist_print(FILE * output, const stack_dist_t * sd);
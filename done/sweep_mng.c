@@ -0,0 +1,174 @@
+/**
+ * @file sweep_mng.c
+ * @brief configuration sweeps: one program simulated through many cache
+ *        hierarchies, concurrently on a pool of host threads
+ *
+ * @date 2019
+ */
+
+#include "sweep_mng.h"
+#include "error.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <inttypes.h> // for PRIu64
+
+static const char* const REPLACE_NAMES[] = { "lru", "plru-tree", "plru-bit", "srrip", "brrip", "drrip" };
+static const char* const INCLUSION_NAMES[] = { "excl", "incl", "nine" };
+
+//=========================================================================
+/**
+ * @brief Simulates the program through one configuration, in a private
+ *        hierarchy, and copies its statistics.
+ * @return error code
+ */
+static int simulate(const void* mem_space, const program_t* program, sweep_config_t* config) {
+    cache_hrchy_t* hrchy = calloc(1, sizeof(cache_hrchy_t));
+    M_EXIT_IF_NULL(hrchy, sizeof(cache_hrchy_t));
+
+    // tag-only caches never write to memory: sharing it is safe
+    int err = cache_hrchy_init(hrchy, (void*) mem_space, &config->l1_config, &config->l2_config, config->replace);
+    if (err != ERR_NONE) {
+        free(hrchy);
+        return err;
+    }
+    if (config->with_l3) {
+        err = cache_hrchy_add_l3(hrchy, &config->l3_config, config->l3_replace);
+    }
+    if (err == ERR_NONE) err = cache_hrchy_run(hrchy, program, NULL);
+    // like --stats: the final write-backs count in the memory traffic
+    if (err == ERR_NONE) err = cache_hrchy_clean(hrchy);
+
+    if (err == ERR_NONE) {
+        config->tlb_hits = hrchy->tlb_hits;
+        config->tlb_misses = hrchy->tlb_misses;
+        (void) cache_stats_get(hrchy->l1_icache, &hrchy->l1_config, &config->l1i_stats);
+        (void) cache_stats_get(hrchy->l1_dcache, &hrchy->l1_config, &config->l1d_stats);
+        (void) cache_stats_get(hrchy->l2_cache, &hrchy->l2_config, &config->l2_stats);
+        if (hrchy->l3_cache != NULL) {
+            (void) cache_stats_get(hrchy->l3_cache, &hrchy->l3_config, &config->l3_stats);
+        }
+    }
+
+    cache_hrchy_free(hrchy);
+    free(hrchy);
+    return err;
+}
+
+//=========================================================================
+typedef struct {
+    const void* mem_space;
+    const program_t* program;
+    sweep_config_t* configs;
+    size_t nb_configs;
+    size_t next;           // next configuration to simulate
+    pthread_mutex_t lock;  // protects next
+} sweep_pool_t;
+
+static void* worker(void* arg) {
+    sweep_pool_t* pool = arg;
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        size_t i = pool->next++;
+        pthread_mutex_unlock(&pool->lock);
+        if (i >= pool->nb_configs) break;
+
+        pool->configs[i].err = simulate(pool->mem_space, pool->program, &pool->configs[i]);
+    }
+    return NULL;
+}
+
+int sweep_run(const void * mem_space, const program_t * program,
+              sweep_config_t * configs, size_t nb_configs, unsigned int nb_threads) {
+    M_REQUIRE_NON_NULL(program);
+    M_REQUIRE_NON_NULL(configs);
+    M_REQUIRE(nb_threads >= 1 && nb_threads <= SWEEP_MAX_THREADS, ERR_BAD_PARAMETER,
+              "%u: number of threads out of range", nb_threads);
+
+    for (size_t i = 0; i < nb_configs; ++i) {
+        sweep_config_t* c = &configs[i];
+        M_EXIT_IF_ERR_NOMSG(cache_config_set_tag_only(&c->l1_config, 1));
+        M_EXIT_IF_ERR_NOMSG(cache_config_set_tag_only(&c->l2_config, 1));
+        M_EXIT_IF_ERR_NOMSG(cache_config_set_tag_only(&c->l3_config, 1));
+        c->err = ERR_NONE;
+        zero_init_var(c->l1i_stats);
+        zero_init_var(c->l1d_stats);
+        zero_init_var(c->l2_stats);
+        zero_init_var(c->l3_stats);
+        c->tlb_hits = c->tlb_misses = 0;
+    }
+
+    sweep_pool_t pool = { .mem_space = mem_space, .program = program, .configs = configs,
+                          .nb_configs = nb_configs, .next = 0 };
+    pthread_mutex_init(&pool.lock, NULL);
+
+    // the calling thread is one of the workers; failing to start the
+    // others only makes the sweep slower
+    pthread_t threads[SWEEP_MAX_THREADS];
+    unsigned int started = 0;
+    while (started + 1 < nb_threads && started + 1 < nb_configs
+           && pthread_create(&threads[started], NULL, worker, &pool) == 0) {
+        ++started;
+    }
+    worker(&pool);
+    for (unsigned int t = 0; t < started; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&pool.lock);
+
+    for (size_t i = 0; i < nb_configs; ++i) {
+        if (configs[i].err != ERR_NONE) return configs[i].err;
+    }
+    return ERR_NONE;
+}
+
+//=========================================================================
+static inline double miss_rate(const cache_stats_t* s) {
+    uint64_t total = s->hits + s->misses;
+    return total == 0 ? 0.0 : 100.0 * (double) s->misses / (double) total;
+}
+
+static inline void print_geometry(FILE* output, const cache_config_t* config) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u:%u:%u", config->lines, config->ways, config->line_size);
+    fprintf(output, " %-11s", buf);
+}
+
+int sweep_print_table(FILE * output, const sweep_config_t * configs, size_t nb_configs) {
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL(configs);
+
+    fprintf(output, "%4s %-11s %-11s %-11s %-9s %-4s %-4s %3s %8s %8s %8s %8s %8s %12s\n",
+            "#", "L1", "L2", "L3", "replace", "incl", "l3in", "wb",
+            "TLB%", "L1I%", "L1D%", "L2%", "L3%", "mem bytes");
+    for (size_t i = 0; i < nb_configs; ++i) {
+        const sweep_config_t* c = &configs[i];
+        fprintf(output, "%4zu", i);
+        print_geometry(output, &c->l1_config);
+        print_geometry(output, &c->l2_config);
+        if (c->with_l3) print_geometry(output, &c->l3_config);
+        else            fprintf(output, " %-11s", "-");
+        fprintf(output, " %-9s %-4s %-4s %3s", REPLACE_NAMES[c->replace],
+                INCLUSION_NAMES[c->l2_config.inclusion],
+                c->with_l3 ? INCLUSION_NAMES[c->l3_config.inclusion] : "-",
+                c->l2_config.write_back ? "yes" : "no");
+        if (c->err != ERR_NONE) {
+            fprintf(output, " ERROR: %s\n", ERR_MESSAGES[c->err - ERR_NONE]);
+            continue;
+        }
+
+        uint64_t tlb_total = c->tlb_hits + c->tlb_misses;
+        uint64_t mem_bytes = c->l1i_stats.mem_read_bytes + c->l1i_stats.mem_write_bytes
+                             + c->l1d_stats.mem_read_bytes + c->l1d_stats.mem_write_bytes
+                             + c->l2_stats.mem_read_bytes + c->l2_stats.mem_write_bytes
+                             + c->l3_stats.mem_read_bytes + c->l3_stats.mem_write_bytes;
+        fprintf(output, " %7.2f%% %7.2f%% %7.2f%% %7.2f%%",
+                tlb_total == 0 ? 0.0 : 100.0 * (double) c->tlb_misses / (double) tlb_total,
+                miss_rate(&c->l1i_stats), miss_rate(&c->l1d_stats), miss_rate(&c->l2_stats));
+        if (c->with_l3) fprintf(output, " %7.2f%%", miss_rate(&c->l3_stats));
+        else            fprintf(output, " %8s", "-");
+        fprintf(output, " %12" PRIu64 "\n", mem_bytes);
+    }
+    return ERR_NONE;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+/**
+ * @file sweep_mng.h
+ * @brief configuration sweeps: one program simulated through many cache
+ *        hierarchies, concurrently on a pool of host threads
+ *
+ * The memory space and the program are loaded once and shared, read-only,
+ * by all the configurations; each one gets its private hierarchy. The
+ * caches are therefore always simulated in tag-only mode (see
+ * cache_config_set_tag_only()): the memory is only read, by the page walks.
+ *
+ * @date 2019
+ */
+
+#include "cache_hrchy_mng.h"
+#include "commands.h"
+
+#include <stdio.h> // for FILE
+
+#define SWEEP_MAX_THREADS 64u
+
+/**
+ * @brief One configuration of a sweep, and its results once simulated.
+ */
+typedef struct {
+    cache_config_t l1_config;
+    cache_config_t l2_config;
+    cache_config_t l3_config;
+    int with_l3;
+    cache_replace_t replace;
+    cache_replace_t l3_replace;
+    // results
+    int err;
+    uint64_t tlb_hits;
+    uint64_t tlb_misses;
+    cache_stats_t l1i_stats;
+    cache_stats_t l1d_stats;
+    cache_stats_t l2_stats;
+    cache_stats_t l3_stats;
+} sweep_config_t;
+
+//=========================================================================
+/**
+ * @brief Simulates a program through each configuration of a sweep.
+ * @param mem_space the memory space, only read
+ * @param program the program, only read
+ * @param configs (modified) the configurations; their caches are switched
+ *        to tag-only mode and their results filled in
+ * @param nb_configs how many there are
+ * @param nb_threads size of the thread pool (1 to SWEEP_MAX_THREADS);
+ *        1 runs the configurations one after the other on the calling thread
+ * @return error code: the one of the first configuration that failed, if
+ *         any (each configuration also gets its own, in err)
+ */
+int sweep_run(const void * mem_space, const program_t * program,
+              sweep_config_t * configs, size_t nb_configs, unsigned int nb_threads);
+
+//=========================================================================
+/**
+ * @brief Prints the results of a sweep, one configuration per row.
+ * @param output the stream to print to
+ * @param configs the simulated configurations
+ * @param nb_configs how many there are
+ * @return error code
+ */
+int sweep_print_table(FILE * output, const sweep_config_t * configs, size_t nb_configs);
@@ -16,13 +16,21 @@
 // #include "addr_mng.h" // for init_virt_addr64()
 
 #include "cache_mng.h"
+#include "cache_hrchy_mng.h"
+#include "multicore_mng.h"
+#include "sweep_mng.h"
+#include "stack_dist_mng.h"
+#include "shard_mng.h"
+#include "checkpoint_mng.h"
 #include "commands.h"
 #include "memory.h"
-#include "page_walk.h"
 
 // #include <stdio.h>
 #include <assert.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h> // for sysconf()
+#include <inttypes.h> // for SCNu64
 // #include <ctype.h> // for isspace()
 // #include <inttypes.h> // for SCNx macro
 
@@ -32,45 +40,305 @@ static void error(const char* pgm, const char* msg)
     assert(msg != NULL);
     fputs("ERROR: ", stderr);
     fputs(msg, stderr);
-    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename\n", pgm);
+    fprintf(stderr, "\nusage:    %s (dump|desc) mem_filename command_filename [options]\n", pgm);
+    fprintf(stderr, "options:  --l1 LINES:WAYS:LINE_SIZE   geometry of both L1 caches\n");
+    fprintf(stderr, "          --l2 LINES:WAYS:LINE_SIZE   geometry of the L2 cache\n");
+    fprintf(stderr, "          --l3 (LINES:WAYS:LINE_SIZE|default)\n");
+    fprintf(stderr, "                                      adds an L3 cache (default: none)\n");
+    fprintf(stderr, "          --line-size (16|32|64|128)  bytes per line of the default geometries, keeping\n");
+    fprintf(stderr, "                                      their capacity and ways (default: 16; 64 is the\n");
+    fprintf(stderr, "                                      line size of the i7)\n");
+    fprintf(stderr, "          --sector SIZE               sectored caches, with SIZE bytes per sector\n");
+    fprintf(stderr, "                                      (default: not sectored)\n");
+    fprintf(stderr, "          --layout (aos|soa)          storage layout of all caches (default: aos)\n");
+    fprintf(stderr, "          --replace (lru|plru-tree|plru-bit|srrip|brrip|drrip)\n");
+    fprintf(stderr, "                                      replacement policy\n");
+    fprintf(stderr, "          --stats                     only print the statistics at the end\n");
+    fprintf(stderr, "          --final-dump                only dump the caches at the end\n");
+    fprintf(stderr, "          --tag-only                  simulate tags only, no data\n");
+    fprintf(stderr, "          --write-back                write-back caches (default: write-through)\n");
+    fprintf(stderr, "          --inclusion (exclusive|inclusive|nine)\n");
+    fprintf(stderr, "                                      inclusion policy of L2\n");
+    fprintf(stderr, "          --l3-inclusion (exclusive|inclusive|nine)\n");
+    fprintf(stderr, "                                      inclusion policy of L3 (default: exclusive)\n");
+    fprintf(stderr, "          --l3-replace POLICY         replacement policy of L3 (default: --replace one)\n");
+    fprintf(stderr, "          --prefetch (next-line|stride|stream)\n");
+    fprintf(stderr, "                                      data prefetcher (default: none)\n");
+    fprintf(stderr, "          --prefetch-to (l1|l2)       level filled by the prefetcher (default: l1)\n");
+    fprintf(stderr, "          --prefetch-degree N         lines prefetched per trigger (default: 1)\n");
+    fprintf(stderr, "          --prefetch-distance N       lines ahead of the access (default: 1)\n");
+    fprintf(stderr, "          --trace command_filename     adds a core running this program (the first\n");
+    fprintf(stderr, "                                      core runs command_filename), with private\n");
+    fprintf(stderr, "                                      L1/L2 caches, a shared L3 and MESI coherence\n");
+    fprintf(stderr, "          --threads                   runs each core on its own host thread\n");
+    fprintf(stderr, "                                      (default: round-robin interleaving)\n");
+    fprintf(stderr, "          --sweep sweep_filename      simulates, in tag-only mode, one configuration\n");
+    fprintf(stderr, "                                      per line of the file (options --l1, --l2,\n");
+    fprintf(stderr, "                                      --l3 (geometry|default|none), --replace,\n");
+    fprintf(stderr, "                                      --l3-replace, --inclusion, --l3-inclusion,\n");
+    fprintf(stderr, "                                      --layout, --write-back, applied to the ones\n");
+    fprintf(stderr, "                                      of the command line) and prints a table\n");
+    fprintf(stderr, "          --jobs N                    threads of the sweep (default: host cores)\n");
+    fprintf(stderr, "          --classify                  classifies the misses of each cache as\n");
+    fprintf(stderr, "                                      compulsory, capacity or conflict (with --stats)\n");
+    fprintf(stderr, "          --sample N                  only simulates 1 in N (power of 2) L1 sets and\n");
+    fprintf(stderr, "                                      extrapolates the statistics (with --tag-only)\n");
+    fprintf(stderr, "          --shards N                  splits the accesses in N (power of 2) shards\n");
+    fprintf(stderr, "                                      of sets, simulated on N host threads (with\n");
+    fprintf(stderr, "                                      --stats or --final-dump)\n");
+    fprintf(stderr, "          --stack-distance            prints the LRU miss-ratio curves of a unified\n");
+    fprintf(stderr, "                                      cache with the L2 line size, for every number\n");
+    fprintf(stderr, "                                      of sets and associativity, in one pass\n");
+    fprintf(stderr, "          --heat-map N                prints the N virtual pages with the most misses\n");
+    fprintf(stderr, "                                      and the N sets of each cache with the most\n");
+    fprintf(stderr, "                                      misses (one core only)\n");
+    fprintf(stderr, "          --heat-csv csv_filename     writes the hits, misses and evictions of each\n");
+    fprintf(stderr, "                                      virtual page and set to a CSV file\n");
+    fprintf(stderr, "          --warmup N                  the first N commands of each region of interest\n");
+    fprintf(stderr, "                                      (\"#roi begin\" to \"#roi end\" lines of the command\n");
+    fprintf(stderr, "                                      file, default: the whole program) only warm the\n");
+    fprintf(stderr, "                                      caches up: no statistics (one core only)\n");
+    fprintf(stderr, "          --fast-forward              only executes the commands out of the regions\n");
+    fprintf(stderr, "                                      of interest functionally, without the caches\n");
+    fprintf(stderr, "                                      (default: they warm the caches up)\n");
+    fprintf(stderr, "          --checkpoint checkpoint_filename\n");
+    fprintf(stderr, "                                      saves the simulator state after --checkpoint-at\n");
+    fprintf(stderr, "                                      commands (default: all of them) and goes on\n");
+    fprintf(stderr, "          --checkpoint-at N           position of the checkpoint in the program\n");
+    fprintf(stderr, "          --restore checkpoint_filename\n");
+    fprintf(stderr, "                                      starts from a saved state (whose caches and\n");
+    fprintf(stderr, "                                      prefetcher replace the ones of the options) and\n");
+    fprintf(stderr, "                                      resumes the program where it was saved\n");
     fprintf(stderr, "examples: %s dump memory_dump.bin commands01.txt\n", pgm);
     fprintf(stderr, "          %s desc memory_description.txt commands01.txt\n", pgm);
+    fprintf(stderr, "          %s dump memory_dump.bin commands01.txt --l1 128:2:16 --l2 1024:16:16\n", pgm);
 }
 
 // ======================================================================
-void execute_command(void *mem_space,
-                     const command_t* command,
-                     l1_icache_entry_t *l1_icache,
-                     l1_icache_entry_t *l1_dcache,
-                     l2_cache_entry_t *l2_cache)
+static int parse_geometry(const char* arg, cache_config_t* config)
 {
-    phy_addr_t paddr;
-    assert(page_walk(mem_space, &command->vaddr, &paddr) == ERR_NONE);
-    uint8_t byte;
-    uint32_t word;
-    void *l1_cache;
-
-    switch (command->order) {
-    case READ:
-        l1_cache = (command->type == INSTRUCTION)? l1_icache: l1_dcache;
-        if(command->data_size == 4)
-            cache_read(mem_space, &paddr, command->type, l1_cache,
-                       l2_cache, &word, LRU);
-        else
-            cache_read_byte(mem_space, &paddr, command->type, l1_cache,
-                            l2_cache, &byte, LRU);
-        break;
-    case WRITE:
-        if(command->data_size == 4)
-            cache_write(mem_space, &paddr, l1_dcache,
-                        l2_cache, &command->write_data, LRU);
-        else
-            cache_write_byte(mem_space, &paddr, l1_dcache,
-                             l2_cache, (uint8_t)command->write_data, LRU);
-        break;
-    default:
-        assert(0);
+    unsigned int lines = 0, ways = 0, line_size = 0;
+    char trailing;
+    if (sscanf(arg, "%u:%u:%u%c", &lines, &ways, &line_size, &trailing) != 3
+        || lines > UINT16_MAX || ways > UINT8_MAX || line_size > UINT8_MAX) {
+        return ERR_BAD_PARAMETER;
     }
+    return cache_config_init(config, (uint16_t) lines, (uint8_t) ways,
+                             (uint8_t) line_size, sizeof(word_t));
+}
+
+// ======================================================================
+// Changes the line size of a geometry, keeping its capacity and associativity
+static int rescale_line(cache_config_t* config, uint8_t line_size)
+{
+    uint32_t capacity = (uint32_t) config->lines * config->ways * config->line_size;
+    uint32_t lines = capacity / ((uint32_t) config->ways * line_size);
+    if (lines == 0 || lines > UINT16_MAX) return ERR_SIZE;
+    return cache_config_init(config, (uint16_t) lines, config->ways, line_size, config->word_size);
+}
+
+// ======================================================================
+static int parse_replace(const char* arg, cache_replace_t* replace)
+{
+    if (!strcmp(arg, "lru")) {
+        *replace = LRU;
+    } else if (!strcmp(arg, "plru-tree")) {
+        *replace = PLRU_TREE;
+    } else if (!strcmp(arg, "plru-bit")) {
+        *replace = PLRU_BIT;
+    } else if (!strcmp(arg, "srrip")) {
+        *replace = SRRIP;
+    } else if (!strcmp(arg, "brrip")) {
+        *replace = BRRIP;
+    } else if (!strcmp(arg, "drrip")) {
+        *replace = DRRIP;
+    } else {
+        return ERR_BAD_PARAMETER;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+static int parse_inclusion(const char* arg, cache_inclusion_t* inclusion)
+{
+    if (!strcmp(arg, "exclusive")) {
+        *inclusion = CACHE_EXCLUSIVE;
+    } else if (!strcmp(arg, "inclusive")) {
+        *inclusion = CACHE_INCLUSIVE;
+    } else if (!strcmp(arg, "nine")) {
+        *inclusion = CACHE_NINE;
+    } else {
+        return ERR_BAD_PARAMETER;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+static int parse_u8(const char* arg, uint8_t* value)
+{
+    unsigned int parsed = 0;
+    char trailing;
+    if (sscanf(arg, "%u%c", &parsed, &trailing) != 1 || parsed > UINT8_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    *value = (uint8_t) parsed;
+    return ERR_NONE;
+}
+
+// ======================================================================
+// Changes the geometry of a cache, keeping its other settings
+static int set_geometry(const char* arg, cache_config_t* config)
+{
+    cache_config_t parsed;
+    if (parse_geometry(arg, &parsed) != ERR_NONE
+        || cache_config_set_layout(&parsed, config->layout) != ERR_NONE
+        || cache_config_set_tag_only(&parsed, config->tag_only) != ERR_NONE
+        || cache_config_set_write_back(&parsed, config->write_back) != ERR_NONE
+        || cache_config_set_inclusion(&parsed, config->inclusion) != ERR_NONE
+        || (config->sectors > 1 && cache_config_set_sector_size(&parsed, config->sector_size) != ERR_NONE)) {
+        return ERR_BAD_PARAMETER;
+    }
+    *config = parsed;
+    return ERR_NONE;
+}
+
+// ======================================================================
+// Applies the options of one line of a sweep file to a copy of base
+static int parse_sweep_line(char* line, const sweep_config_t* base, sweep_config_t* config)
+{
+    *config = *base;
+    int l3_replace_set = 0;
+    for (char* opt = strtok(line, " \t\r\n"); opt != NULL; opt = strtok(NULL, " \t\r\n")) {
+        int err = ERR_NONE;
+        if (!strcmp(opt, "--write-back")) {
+            err = cache_config_set_write_back(&config->l1_config, 1);
+            if (err == ERR_NONE) err = cache_config_set_write_back(&config->l2_config, 1);
+            if (err == ERR_NONE) err = cache_config_set_write_back(&config->l3_config, 1);
+            if (err != ERR_NONE) return err;
+            continue;
+        }
+
+        char* arg = strtok(NULL, " \t\r\n");
+        if (arg == NULL) {
+            err = ERR_BAD_PARAMETER;
+        } else if (!strcmp(opt, "--l1")) {
+            err = set_geometry(arg, &config->l1_config);
+        } else if (!strcmp(opt, "--l2")) {
+            err = set_geometry(arg, &config->l2_config);
+        } else if (!strcmp(opt, "--l3")) {
+            config->with_l3 = strcmp(arg, "none") != 0;
+            if (config->with_l3 && strcmp(arg, "default")) err = set_geometry(arg, &config->l3_config);
+        } else if (!strcmp(opt, "--replace")) {
+            err = parse_replace(arg, &config->replace);
+        } else if (!strcmp(opt, "--l3-replace")) {
+            err = parse_replace(arg, &config->l3_replace);
+            l3_replace_set = 1;
+        } else if (!strcmp(opt, "--inclusion") || !strcmp(opt, "--l3-inclusion")) {
+            cache_config_t* c = strcmp(opt, "--inclusion") ? &config->l3_config : &config->l2_config;
+            cache_inclusion_t inclusion;
+            err = parse_inclusion(arg, &inclusion);
+            if (err == ERR_NONE) err = cache_config_set_inclusion(c, inclusion);
+        } else if (!strcmp(opt, "--layout") && (!strcmp(arg, "aos") || !strcmp(arg, "soa"))) {
+            cache_layout_t layout = strcmp(arg, "soa") ? CACHE_LAYOUT_AOS : CACHE_LAYOUT_SOA;
+            err = cache_config_set_layout(&config->l1_config, layout);
+            if (err == ERR_NONE) err = cache_config_set_layout(&config->l2_config, layout);
+            if (err == ERR_NONE) err = cache_config_set_layout(&config->l3_config, layout);
+        } else {
+            err = ERR_BAD_PARAMETER;
+        }
+        if (err != ERR_NONE) return err;
+    }
+    if (!l3_replace_set && config->replace != base->replace) config->l3_replace = config->replace;
+
+    if (config->l1_config.line_size != config->l2_config.line_size
+        || (config->with_l3 && config->l3_config.line_size != config->l2_config.line_size)
+        || !cache_replace_supported(&config->l1_config, config->replace)
+        || !cache_replace_supported(&config->l2_config, config->replace)
+        || (config->with_l3 && !cache_replace_supported(&config->l3_config, config->l3_replace))) {
+        return ERR_BAD_PARAMETER;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+// Reads a sweep file: one configuration per non-empty line
+static int read_sweep(const char* filename, const sweep_config_t* base,
+                      sweep_config_t** configs, size_t* nb_configs)
+{
+    FILE* input = fopen(filename, "r");
+    if (input == NULL) return ERR_IO;
+
+    char line[1024];
+    size_t allocated = 0;
+    unsigned int line_nb = 0;
+    int err = ERR_NONE;
+    *configs = NULL;
+    *nb_configs = 0;
+    while (err == ERR_NONE && fgets(line, sizeof(line), input) != NULL) {
+        ++line_nb;
+        if (strspn(line, " \t\r\n") == strlen(line)) continue;
+        if (*nb_configs == allocated) {
+            allocated = allocated == 0 ? 16 : 2 * allocated;
+            sweep_config_t* grown = realloc(*configs, allocated * sizeof(sweep_config_t));
+            if (grown == NULL) {
+                err = ERR_MEM;
+                break;
+            }
+            *configs = grown;
+        }
+        err = parse_sweep_line(line, base, &(*configs)[*nb_configs]);
+        if (err != ERR_NONE) {
+            fprintf(stderr, "%s:%u: invalid configuration\n", filename, line_nb);
+        } else {
+            ++*nb_configs;
+        }
+    }
+    fclose(input);
+    if (err != ERR_NONE) {
+        free(*configs);
+        *configs = NULL;
+        *nb_configs = 0;
+    }
+    return err;
+}
+
+// ======================================================================
+// Executes the commands [from, to) of a program (see cache_hrchy_run_range()),
+// dumping the caches after each one if step_dump
+static int run_lines(cache_hrchy_t* hrchy, const program_t* pgm, size_t from, size_t to,
+                     size_t warmup, int fast_forward, int step_dump)
+{
+    if (!step_dump) return cache_hrchy_run_range(hrchy, pgm, from, to, warmup, fast_forward);
+
+    for (size_t i = from; i < to; ++i) {
+        int err = cache_hrchy_run_range(hrchy, pgm, i, i + 1, warmup, fast_forward);
+        if (err != ERR_NONE) return err;
+        cache_hrchy_dump(stdout, hrchy);
+        printf("\n=======================================\n\n");
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+static int write_checkpoint(const char* filename, const cache_hrchy_t* hrchy, uint64_t position,
+                            const void* base_mem, size_t mem_size)
+{
+    FILE* output = fopen(filename, "wb");
+    if (output == NULL) return ERR_IO;
+    int err = checkpoint_save(output, hrchy, position, base_mem, mem_size);
+    if (fclose(output) != 0 && err == ERR_NONE) err = ERR_IO;
+    return err;
+}
+
+// ======================================================================
+static int read_checkpoint(const char* filename, cache_hrchy_t* hrchy, void* mem_space, size_t mem_size,
+                           prefetcher_t* prefetcher, uint64_t* position)
+{
+    FILE* input = fopen(filename, "rb");
+    if (input == NULL) return ERR_IO;
+    int err = checkpoint_load(input, hrchy, mem_space, mem_size, prefetcher, position);
+    fclose(input);
+    return err;
 }
 
 // ======================================================================
@@ -89,6 +357,312 @@ int main(int argc, char *argv[])
         dump = 0;
     }
 
+    cache_config_t l1_config, l2_config, l3_config;
+    if (cache_config_default(&l1_config, L1_ICACHE) != ERR_NONE
+        || cache_config_default(&l2_config, L2_CACHE) != ERR_NONE
+        || cache_config_default(&l3_config, L3_CACHE) != ERR_NONE) {
+        error(argv[0], "invalid default cache geometry.");
+        return 1;
+    }
+    int with_l3 = 0;
+    cache_inclusion_t l3_inclusion = CACHE_EXCLUSIVE;
+    cache_replace_t l3_replace = LRU;
+    int l3_replace_set = 0;
+    cache_layout_t layout = CACHE_LAYOUT_AOS;
+    cache_replace_t replace = LRU;
+    int stats_only = 0;
+    int final_dump = 0;
+    int tag_only = 0;
+    int write_back = 0;
+    uint8_t line_size = 0;
+    uint8_t sector_size = 0;
+    unsigned int custom = 0; // levels given a geometry, as (1 << cache_t)
+    cache_inclusion_t inclusion = CACHE_EXCLUSIVE;
+    prefetch_kind_t prefetch_kind = PREFETCH_NONE;
+    prefetch_target_t prefetch_target = PREFETCH_TO_L1;
+    uint8_t prefetch_degree = 1;
+    uint8_t prefetch_distance = 1;
+    const char* traces[MULTICORE_MAX_CORES] = { argv[3] };
+    uint8_t nb_cores = 1;
+    int threaded = 0;
+    const char* sweep_file = NULL;
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int stack_distance = 0;
+    uint8_t sample_bits = 0;
+    int sampling = 0;
+    uint8_t nb_shards = 1;
+    int classify = 0;
+    const char* checkpoint_file = NULL;
+    uint64_t checkpoint_at = UINT64_MAX;
+    const char* restore_file = NULL;
+    uint64_t warmup = 0;
+    int fast_forward = 0;
+    uint64_t heat_top = 0;
+    const char* heat_csv = NULL;
+    for (int i = 4; i < argc; ++i) {
+        cache_config_t* config = NULL;
+        if (!strcmp(argv[i], "--stats")) {
+            stats_only = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--final-dump")) {
+            final_dump = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--tag-only")) {
+            tag_only = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--write-back")) {
+            write_back = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--sample")) {
+            uint8_t ratio = 0;
+            if (++i >= argc || parse_u8(argv[i], &ratio) != ERR_NONE || ratio == 0 || (ratio & (ratio - 1)) != 0) {
+                error(argv[0], "invalid sampling ratio.");
+                return 1;
+            }
+            sampling = 1;
+            for (sample_bits = 0; (1u << sample_bits) < ratio; ++sample_bits);
+            continue;
+        } else if (!strcmp(argv[i], "--line-size") || !strcmp(argv[i], "--sector")) {
+            uint8_t* value = strcmp(argv[i], "--sector") ? &line_size : &sector_size;
+            if (++i >= argc || parse_u8(argv[i], value) != ERR_NONE || *value == 0) {
+                error(argv[0], "invalid line or sector size.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--classify")) {
+            classify = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--shards")) {
+            if (++i >= argc || parse_u8(argv[i], &nb_shards) != ERR_NONE || nb_shards == 0
+                || nb_shards > SHARD_MAX || (nb_shards & (nb_shards - 1)) != 0) {
+                error(argv[0], "invalid number of shards.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--checkpoint") || !strcmp(argv[i], "--restore")) {
+            const char** file = strcmp(argv[i], "--restore") ? &checkpoint_file : &restore_file;
+            if (++i >= argc) {
+                error(argv[0], "missing checkpoint file.");
+                return 1;
+            }
+            *file = argv[i];
+            continue;
+        } else if (!strcmp(argv[i], "--checkpoint-at") || !strcmp(argv[i], "--warmup")
+                   || !strcmp(argv[i], "--heat-map")) {
+            uint64_t* value = !strcmp(argv[i], "--warmup") ? &warmup
+                              : !strcmp(argv[i], "--heat-map") ? &heat_top : &checkpoint_at;
+            char trailing;
+            if (++i >= argc || sscanf(argv[i], "%" SCNu64 "%c", value, &trailing) != 1) {
+                error(argv[0], "invalid number of commands.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--heat-csv")) {
+            if (++i >= argc) {
+                error(argv[0], "missing CSV file.");
+                return 1;
+            }
+            heat_csv = argv[i];
+            continue;
+        } else if (!strcmp(argv[i], "--fast-forward")) {
+            fast_forward = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--stack-distance")) {
+            stack_distance = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--threads")) {
+            threaded = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--trace")) {
+            if (++i >= argc || nb_cores >= MULTICORE_MAX_CORES) {
+                error(argv[0], "missing trace or too many cores.");
+                return 1;
+            }
+            traces[nb_cores++] = argv[i];
+            continue;
+        } else if (!strcmp(argv[i], "--sweep")) {
+            if (++i >= argc) {
+                error(argv[0], "missing sweep file.");
+                return 1;
+            }
+            sweep_file = argv[i];
+            continue;
+        } else if (!strcmp(argv[i], "--jobs")) {
+            char trailing;
+            if (++i >= argc || sscanf(argv[i], "%ld%c", &jobs, &trailing) != 1
+                || jobs < 1 || jobs > SWEEP_MAX_THREADS) {
+                error(argv[0], "invalid number of jobs.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--inclusion") || !strcmp(argv[i], "--l3-inclusion")) {
+            cache_inclusion_t* value = strcmp(argv[i], "--inclusion") ? &l3_inclusion : &inclusion;
+            if (++i >= argc || parse_inclusion(argv[i], value) != ERR_NONE) {
+                error(argv[0], "invalid inclusion policy.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--prefetch")) {
+            if (++i >= argc) {
+                error(argv[0], "missing prefetcher.");
+                return 1;
+            } else if (!strcmp(argv[i], "next-line")) {
+                prefetch_kind = PREFETCH_NEXT_LINE;
+            } else if (!strcmp(argv[i], "stride")) {
+                prefetch_kind = PREFETCH_STRIDE;
+            } else if (!strcmp(argv[i], "stream")) {
+                prefetch_kind = PREFETCH_STREAM;
+            } else {
+                error(argv[0], "invalid prefetcher.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--prefetch-to")) {
+            if (++i >= argc || (strcmp(argv[i], "l1") && strcmp(argv[i], "l2"))) {
+                error(argv[0], "invalid prefetch target.");
+                return 1;
+            }
+            prefetch_target = strcmp(argv[i], "l2") ? PREFETCH_TO_L1 : PREFETCH_TO_L2;
+            continue;
+        } else if (!strcmp(argv[i], "--prefetch-degree") || !strcmp(argv[i], "--prefetch-distance")) {
+            uint8_t* value = strcmp(argv[i], "--prefetch-degree") ? &prefetch_distance : &prefetch_degree;
+            if (++i >= argc || parse_u8(argv[i], value) != ERR_NONE) {
+                error(argv[0], "invalid prefetch degree or distance.");
+                return 1;
+            }
+            continue;
+        } else if (!strcmp(argv[i], "--replace") || !strcmp(argv[i], "--l3-replace")) {
+            int l3 = strcmp(argv[i], "--replace") != 0;
+            if (++i >= argc || parse_replace(argv[i], l3 ? &l3_replace : &replace) != ERR_NONE) {
+                error(argv[0], "invalid replacement policy.");
+                return 1;
+            }
+            if (l3) l3_replace_set = 1;
+            continue;
+        } else if (!strcmp(argv[i], "--layout")) {
+            if (++i >= argc || (strcmp(argv[i], "aos") && strcmp(argv[i], "soa"))) {
+                error(argv[0], "invalid cache layout.");
+                return 1;
+            }
+            layout = strcmp(argv[i], "soa") ? CACHE_LAYOUT_AOS : CACHE_LAYOUT_SOA;
+            continue;
+        } else if (!strcmp(argv[i], "--l1")) {
+            config = &l1_config;
+        } else if (!strcmp(argv[i], "--l2")) {
+            config = &l2_config;
+        } else if (!strcmp(argv[i], "--l3")) {
+            config = &l3_config;
+            with_l3 = 1;
+            if (i + 1 < argc && !strcmp(argv[i + 1], "default")) {
+                ++i;
+                continue;
+            }
+        } else {
+            error(argv[0], "unknown option.");
+            return 1;
+        }
+        if (++i >= argc || parse_geometry(argv[i], config) != ERR_NONE) {
+            error(argv[0], "invalid cache geometry.");
+            return 1;
+        }
+        custom |= 1u << (config == &l1_config ? L1_ICACHE : config == &l2_config ? L2_CACHE : L3_CACHE);
+    }
+    if (line_size != 0
+        && ((!(custom & (1u << L1_ICACHE)) && rescale_line(&l1_config, line_size) != ERR_NONE)
+            || (!(custom & (1u << L2_CACHE)) && rescale_line(&l2_config, line_size) != ERR_NONE)
+            || (!(custom & (1u << L3_CACHE)) && rescale_line(&l3_config, line_size) != ERR_NONE))) {
+        error(argv[0], "invalid line size.");
+        return 1;
+    }
+    if (cache_config_set_layout(&l1_config, layout) != ERR_NONE
+        || cache_config_set_layout(&l2_config, layout) != ERR_NONE
+        || cache_config_set_tag_only(&l1_config, tag_only) != ERR_NONE
+        || cache_config_set_tag_only(&l2_config, tag_only) != ERR_NONE
+        || cache_config_set_write_back(&l1_config, write_back) != ERR_NONE
+        || cache_config_set_write_back(&l2_config, write_back) != ERR_NONE
+        || cache_config_set_inclusion(&l2_config, inclusion) != ERR_NONE
+        || cache_config_set_layout(&l3_config, layout) != ERR_NONE
+        || cache_config_set_tag_only(&l3_config, tag_only) != ERR_NONE
+        || cache_config_set_write_back(&l3_config, write_back) != ERR_NONE
+        || cache_config_set_inclusion(&l3_config, l3_inclusion) != ERR_NONE) {
+        error(argv[0], "invalid cache configuration.");
+        return 1;
+    }
+    if (!l3_replace_set) l3_replace = replace;
+    if (l1_config.line_size != l2_config.line_size || (with_l3 && l3_config.line_size != l2_config.line_size)) {
+        error(argv[0], "L1, L2 and L3 must have the same line size.");
+        return 1;
+    }
+    if (sector_size != 0
+        && (cache_config_set_sector_size(&l1_config, sector_size) != ERR_NONE
+            || cache_config_set_sector_size(&l2_config, sector_size) != ERR_NONE
+            || (with_l3 && cache_config_set_sector_size(&l3_config, sector_size) != ERR_NONE))) {
+        error(argv[0], "invalid sector size.");
+        return 1;
+    }
+    if (!cache_replace_supported(&l1_config, replace) || !cache_replace_supported(&l2_config, replace)
+        || (with_l3 && !cache_replace_supported(&l3_config, l3_replace))) {
+        error(argv[0], "replacement policy not supported by the cache geometry.");
+        return 1;
+    }
+    if (nb_cores > 1 && prefetch_kind != PREFETCH_NONE) {
+        error(argv[0], "prefetchers are not supported with several cores.");
+        return 1;
+    }
+    if (sampling && (!tag_only || nb_cores > 1 || prefetch_kind != PREFETCH_NONE || sweep_file != NULL)) {
+        error(argv[0], "sampling requires --tag-only, one core and no prefetcher nor sweep.");
+        return 1;
+    }
+    if (classify && (nb_cores > 1 || sampling || nb_shards > 1 || sweep_file != NULL)) {
+        error(argv[0], "miss classification requires one core and no sampling, sharding nor sweep.");
+        return 1;
+    }
+    if (nb_shards > 1 && (!(stats_only || final_dump) || nb_cores > 1 || sampling
+                          || prefetch_kind != PREFETCH_NONE || sweep_file != NULL)) {
+        error(argv[0], "sharding requires --stats or --final-dump, one core and no sampling, prefetcher nor sweep.");
+        return 1;
+    }
+    if (sweep_file != NULL && (nb_cores > 1 || prefetch_kind != PREFETCH_NONE)) {
+        error(argv[0], "sweeps support neither several cores nor prefetchers.");
+        return 1;
+    }
+    if ((checkpoint_file != NULL || restore_file != NULL)
+        && (nb_cores > 1 || sweep_file != NULL || stack_distance || sampling || classify || nb_shards > 1)) {
+        error(argv[0], "checkpoints support neither several cores, sweeps, stack distances, sampling,"
+              " miss classification nor sharding.");
+        return 1;
+    }
+    if ((warmup > 0 || fast_forward)
+        && (nb_cores > 1 || sweep_file != NULL || stack_distance || sampling || nb_shards > 1)) {
+        error(argv[0], "warm-up and fast-forward support neither several cores, sweeps, stack distances,"
+              " sampling nor sharding.");
+        return 1;
+    }
+    int heat = heat_top > 0 || heat_csv != NULL;
+    if (heat && (nb_cores > 1 || sweep_file != NULL || stack_distance || sampling || nb_shards > 1
+                 || checkpoint_file != NULL || restore_file != NULL)) {
+        error(argv[0], "heat maps support neither several cores, sweeps, stack distances, sampling,"
+              " sharding nor checkpoints.");
+        return 1;
+    }
+    sweep_config_t* sweep = NULL;
+    size_t sweep_size = 0;
+    if (sweep_file != NULL) {
+        sweep_config_t base = { .l1_config = l1_config, .l2_config = l2_config, .l3_config = l3_config,
+                                .with_l3 = with_l3, .replace = replace, .l3_replace = l3_replace };
+        if (read_sweep(sweep_file, &base, &sweep, &sweep_size) != ERR_NONE) {
+            error(argv[0], "problem reading the sweep file.");
+            return 1;
+        }
+    }
+    prefetcher_t prefetcher;
+    if (prefetch_kind != PREFETCH_NONE
+        && prefetcher_init(&prefetcher, prefetch_kind, prefetch_target, prefetch_degree,
+                           prefetch_distance, l1_config.line_size) != ERR_NONE) {
+        error(argv[0], "invalid prefetcher configuration.");
+        return 1;
+    }
+
     void* mem_space = NULL;
     size_t mem_size = 0;
     int err = ERR_NONE;
@@ -97,32 +671,186 @@ int main(int argc, char *argv[])
     else
         err = mem_init_from_description(argv[2], &mem_space, &mem_size);
 
+    if (err == ERR_NONE && stack_distance) {
+        program_t pgm;
+        if (program_read(argv[3], &pgm) != ERR_NONE) {
+            error(argv[0], "problem initializing program from provided file.");
+            free(sweep);
+            free(mem_space);
+            return 3;
+        }
+        stack_dist_t sd;
+        err = stack_dist_init(&sd, l2_config.line_size, STACK_DIST_MAX_SET_BITS);
+        if (err == ERR_NONE) {
+            err = stack_dist_run(&sd, mem_space, &pgm);
+            if (err == ERR_NONE) err = stack_dist_print(stdout, &sd);
+            stack_dist_free(&sd);
+        }
+        if (err != ERR_NONE) {
+            fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+        }
+        (void)program_free(&pgm);
+        free(sweep);
+        free(mem_space);
+        return err == ERR_NONE ? 0 : 2;
+    }
+
+    if (err == ERR_NONE && sweep != NULL) {
+        program_t pgm;
+        if (program_read(argv[3], &pgm) != ERR_NONE) {
+            error(argv[0], "problem initializing program from provided file.");
+            free(sweep);
+            free(mem_space);
+            return 3;
+        }
+        if (jobs < 1) jobs = 1;
+        if (jobs > SWEEP_MAX_THREADS) jobs = SWEEP_MAX_THREADS;
+        err = sweep_run(mem_space, &pgm, sweep, sweep_size, (unsigned int) jobs);
+        // the table also shows which configurations failed, if any
+        int table_err = sweep_print_table(stdout, sweep, sweep_size);
+        if (err == ERR_NONE) err = table_err;
+        if (err != ERR_NONE) {
+            fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+        }
+        (void)program_free(&pgm);
+        free(sweep);
+        free(mem_space);
+        return err == ERR_NONE ? 0 : 2;
+    }
+
+    if (err == ERR_NONE && nb_cores > 1) {
+        program_t pgms[MULTICORE_MAX_CORES];
+        uint8_t nb_read = 0;
+        for (; nb_read < nb_cores; ++nb_read) {
+            if (program_read(traces[nb_read], &pgms[nb_read]) != ERR_NONE) break;
+        }
+        if (nb_read < nb_cores) {
+            error(argv[0], "problem initializing program from provided file.");
+            err = ERR_IO;
+        } else {
+            multicore_t mc;
+            // multicore_init() frees what it set up when it fails
+            err = multicore_init(&mc, nb_cores, mem_space, &l1_config, &l2_config,
+                                 with_l3 ? &l3_config : NULL, replace);
+            if (err == ERR_NONE) {
+                err = multicore_run(&mc, pgms, threaded);
+                if (err == ERR_NONE && final_dump) {
+                    err = multicore_dump(stdout, &mc);
+                } else if (err == ERR_NONE) {
+                    err = multicore_clean(&mc);
+                    multicore_print_stats(stdout, &mc);
+                }
+                multicore_free(&mc);
+            }
+            if (err != ERR_NONE) {
+                fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+            }
+        }
+        for (uint8_t c = 0; c < nb_read; ++c) (void)program_free(&pgms[c]);
+        free(mem_space);
+        return err == ERR_NONE ? 0 : (nb_read < nb_cores ? 3 : 2);
+    }
+
+    // memory image the run starts from, which the checkpoint records the changes to
+    void* base_mem = NULL;
+    if (err == ERR_NONE && checkpoint_file != NULL) {
+        if ((base_mem = malloc(mem_size > 0 ? mem_size : 1)) == NULL) {
+            err = ERR_MEM;
+        } else {
+            memcpy(base_mem, mem_space, mem_size);
+        }
+    }
 
     program_t pgm;
     if (err == ERR_NONE) {
         if(program_read(argv[3], &pgm) == ERR_NONE) {
-            l1_icache_entry_t l1_icache[L1_ICACHE_LINES * L1_ICACHE_WAYS];
-            l1_icache_entry_t l1_dcache[L1_DCACHE_LINES * L1_DCACHE_WAYS];
-            l2_cache_entry_t l2_cache[L2_CACHE_LINES * L2_CACHE_WAYS];
-            memset(l1_icache, 0, sizeof(l1_icache));
-            memset(l1_dcache, 0, sizeof(l1_dcache));
-            memset(l2_cache,  0, sizeof(l2_cache));
-
-            /* Flush caches before use */
-            assert(cache_flush(l1_icache, L1_ICACHE) == ERR_NONE);
-            assert(cache_flush(l1_dcache, L1_DCACHE) == ERR_NONE);
-            assert(cache_flush(l2_cache, L2_CACHE) == ERR_NONE);
-
-            for_all_lines(line, &pgm) {
-                execute_command(mem_space, line, l1_icache, l1_dcache, l2_cache);
-
-                printf("L1_ICACHE: \n\n");
-                cache_dump(stdout, l1_icache, L1_ICACHE);
-                printf("L1_DCACHE: \n\n");
-                cache_dump(stdout, l1_dcache, L1_DCACHE);
-                printf("L2_CACHE: \n\n");
-                cache_dump(stdout, l2_cache, L2_CACHE);
-                printf("\n=======================================\n\n");
+            cache_hrchy_t hrchy;
+            uint64_t start = 0;
+            if (restore_file != NULL) {
+                err = read_checkpoint(restore_file, &hrchy, mem_space, mem_size, &prefetcher, &start);
+                if (err == ERR_NONE && start > pgm.nb_lines) {
+                    cache_hrchy_free(&hrchy);
+                    err = ERR_BAD_PARAMETER;
+                }
+                if (err != ERR_NONE) {
+                    error(argv[0], "problem restoring the checkpoint.");
+                    (void)program_free(&pgm);
+                    free(base_mem);
+                    free(mem_space);
+                    return 3;
+                }
+            } else {
+                // cache_hrchy_init() frees what it set up when it fails
+                err = cache_hrchy_init(&hrchy, mem_space, &l1_config, &l2_config, replace);
+                if (err != ERR_NONE) {
+                    fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+                    (void)program_free(&pgm);
+                    free(base_mem);
+                    free(mem_space);
+                    return 2;
+                }
+                if (with_l3) err = cache_hrchy_add_l3(&hrchy, &l3_config, l3_replace);
+                if (err == ERR_NONE && prefetch_kind != PREFETCH_NONE) {
+                    err = cache_hrchy_set_prefetcher(&hrchy, &prefetcher);
+                }
+                if (err == ERR_NONE && classify) err = cache_hrchy_classify_misses(&hrchy);
+                if (err == ERR_NONE && heat) err = cache_hrchy_heat_map(&hrchy);
+                if (err == ERR_NONE && sampling && cache_hrchy_set_sampling(&hrchy, sample_bits) != ERR_NONE) {
+                    error(argv[0], "sampling ratio larger than the number of L1 sets, or fewer L2 (L3) sets than L1 sets.");
+                    cache_hrchy_free(&hrchy);
+                    (void)program_free(&pgm);
+                    free(base_mem);
+                    free(mem_space);
+                    return 1;
+                }
+                if (err != ERR_NONE) {
+                    fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
+                    cache_hrchy_free(&hrchy);
+                    (void)program_free(&pgm);
+                    free(base_mem);
+                    free(mem_space);
+                    return 2;
+                }
+            }
+
+            if (nb_shards > 1 && pgm.nb_roi > 0) {
+                error(argv[0], "sharding does not support regions of interest.");
+                err = ERR_BAD_PARAMETER;
+            } else if (nb_shards > 1) {
+                err = shard_run(&hrchy, &pgm, nb_shards);
+                if (err == ERR_NONE && !stats_only) err = cache_hrchy_dump(stdout, &hrchy);
+                if (err == ERR_NONE && stats_only) {
+                    err = cache_hrchy_clean(&hrchy);
+                    cache_hrchy_print_stats(stdout, &hrchy);
+                }
+            } else {
+                int step_dump = !(stats_only || final_dump);
+                uint64_t stop = pgm.nb_lines;
+                if (checkpoint_file != NULL && checkpoint_at < stop) stop = checkpoint_at > start ? checkpoint_at : start;
+                err = run_lines(&hrchy, &pgm, start, stop, warmup, fast_forward, step_dump);
+                if (err == ERR_NONE && checkpoint_file != NULL) {
+                    err = write_checkpoint(checkpoint_file, &hrchy, stop, base_mem, mem_size);
+                }
+                if (err == ERR_NONE) err = run_lines(&hrchy, &pgm, stop, pgm.nb_lines, warmup, fast_forward, step_dump);
+                if (err == ERR_NONE && final_dump && !stats_only) err = cache_hrchy_dump(stdout, &hrchy);
+                if (err == ERR_NONE && stats_only) {
+                    err = cache_hrchy_clean(&hrchy);
+                    cache_hrchy_print_stats(stdout, &hrchy);
+                }
+            }
+
+            if (err == ERR_NONE && heat_top > 0) {
+                err = heat_map_print_top(stdout, hrchy.heat, (size_t) heat_top);
+            }
+            if (err == ERR_NONE && heat_csv != NULL) {
+                FILE* csv = fopen(heat_csv, "w");
+                err = csv == NULL ? ERR_IO : heat_map_print_csv(csv, hrchy.heat);
+                if (csv != NULL && fclose(csv) != 0 && err == ERR_NONE) err = ERR_IO;
+            }
+
+            cache_hrchy_free(&hrchy);
+            if (err != ERR_NONE) {
+                fprintf(stderr, "ERROR: %s\n", ERR_MESSAGES[err - ERR_NONE]);
             }
         } else {
             error(argv[0], "problem initializing program from provided file.");
@@ -134,6 +862,7 @@ int main(int argc, char *argv[])
     }
 
     (void)program_free(&pgm);
+    free(base_mem);
     free(mem_space);
-    return 0;
+    return err == ERR_NONE ? 0 : 2;
 }
@@ -0,0 +1,282 @@
+/**
+ * @file test-cache_data.c
+ * @brief black-box testing of the data held by a cache hierarchy: every
+ *        read must return, and memory must hold once the caches are
+ *        cleaned, what a plain memory (without caches) would
+ *
+ * @date 2019
+ */
+
+#if defined _WIN32  || defined _WIN64
+#define __USE_MINGW_ANSI_STDIO 1
+#endif
+
+#include "error.h"
+#include "cache_mng.h"
+#include "cache_hrchy_mng.h"
+#include "commands.h"
+#include "memory.h"
+#include "page_walk.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h> // for PRIx64
+
+// ======================================================================
+static void error(const char* pgm, const char* msg)
+{
+    assert(msg != NULL);
+    fputs("ERROR: ", stderr);
+    fputs(msg, stderr);
+    fprintf(stderr, "\nusage:    %s mem_dump_filename command_filename [options]\n", pgm);
+    fprintf(stderr, "options:  --l1 LINES:WAYS:LINE_SIZE   geometry of both L1 caches (default: 8:2:16)\n");
+    fprintf(stderr, "          --l2 LINES:WAYS:LINE_SIZE   geometry of the L2 cache (default: 32:4:16)\n");
+    fprintf(stderr, "          --l3 LINES:WAYS:LINE_SIZE   adds an L3 cache (default: none)\n");
+    fprintf(stderr, "          --sector SIZE               sectored caches, with SIZE bytes per sector\n");
+    fprintf(stderr, "          --write-back                write-back caches (default: write-through)\n");
+    fprintf(stderr, "          --inclusion (exclusive|inclusive|nine)\n");
+    fprintf(stderr, "                                      inclusion policy of L2 (default: exclusive)\n");
+    fprintf(stderr, "          --l3-inclusion (exclusive|inclusive|nine)\n");
+    fprintf(stderr, "                                      inclusion policy of L3 (default: exclusive)\n");
+    fprintf(stderr, "          --layout (aos|soa)          storage layout of all caches (default: aos)\n");
+    fprintf(stderr, "          --line-accesses             each command accesses a line size of bytes from its\n");
+    fprintf(stderr, "                                      address on (up to the end of the page) instead of\n");
+    fprintf(stderr, "                                      its own size, across several sectors\n");
+    fprintf(stderr, "example:  %s memory_dump.bin commands03.txt --l3 128:8:16 --sector 8 --write-back\n", pgm);
+}
+
+// ======================================================================
+static int parse_geometry(const char* arg, cache_config_t* config)
+{
+    unsigned int lines = 0, ways = 0, line_size = 0;
+    char trailing;
+    if (sscanf(arg, "%u:%u:%u%c", &lines, &ways, &line_size, &trailing) != 3
+        || lines > UINT16_MAX || ways > UINT8_MAX || line_size > UINT8_MAX) {
+        return ERR_BAD_PARAMETER;
+    }
+    return cache_config_init(config, (uint16_t) lines, (uint8_t) ways,
+                             (uint8_t) line_size, sizeof(word_t));
+}
+
+// ======================================================================
+static int parse_inclusion(const char* arg, cache_inclusion_t* inclusion)
+{
+    if (!strcmp(arg, "exclusive")) {
+        *inclusion = CACHE_EXCLUSIVE;
+    } else if (!strcmp(arg, "inclusive")) {
+        *inclusion = CACHE_INCLUSIVE;
+    } else if (!strcmp(arg, "nine")) {
+        *inclusion = CACHE_NINE;
+    } else {
+        return ERR_BAD_PARAMETER;
+    }
+    return ERR_NONE;
+}
+
+// ======================================================================
+// Applies the options shared by all the levels to one of them
+static int set_options(cache_config_t* config, uint8_t sector_size, int write_back,
+                       cache_inclusion_t inclusion, cache_layout_t layout)
+{
+    int err = cache_config_set_write_back(config, write_back);
+    if (err == ERR_NONE) err = cache_config_set_inclusion(config, inclusion);
+    if (err == ERR_NONE) err = cache_config_set_layout(config, layout);
+    if (err == ERR_NONE && sector_size != 0) err = cache_config_set_sector_size(config, sector_size);
+    return err;
+}
+
+// ======================================================================
+// Line-sized access of a command, by cache_read_bytes()/cache_write_bytes():
+// the bytes written repeat the ones of the command, each xored with its
+// position; returns the error code and sets *mismatch on a wrong read
+static int line_access(cache_hrchy_t* hrchy, const command_t* command, phy_addr_t* paddr,
+                       byte_t* plain, int* mismatch)
+{
+    uint32_t phy_addr = ((uint32_t) paddr->phy_page_num << PAGE_OFFSET) | paddr->page_offset;
+    size_t size = hrchy->l1_config.line_size;
+    if (paddr->page_offset + size > PAGE_SIZE) size = PAGE_SIZE - paddr->page_offset;
+    byte_t data[UINT8_MAX];
+
+    if (command->order == WRITE) {
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = (byte_t) (((const byte_t*) &command->write_data)[i % command->data_size] ^ i);
+        }
+        memcpy(plain + phy_addr, data, size);
+        return cache_write_bytes(hrchy->mem_space, paddr, hrchy->l1_dcache, &hrchy->l1_config,
+                                 hrchy->l2_cache, &hrchy->l2_config, data, size, hrchy->replace);
+    }
+
+    void* l1_cache = command->type == INSTRUCTION ? hrchy->l1_icache : hrchy->l1_dcache;
+    int err = cache_read_bytes(hrchy->mem_space, paddr, command->type, l1_cache, &hrchy->l1_config,
+                               hrchy->l2_cache, &hrchy->l2_config, data, size, hrchy->replace);
+    *mismatch = err == ERR_NONE && memcmp(data, plain + phy_addr, size);
+    return err;
+}
+
+// ======================================================================
+// Runs a program on the hierarchy and on a plain copy of memory, checking
+// every read against that copy; returns the number of wrong reads
+static size_t run_checked(cache_hrchy_t* hrchy, const program_t* pgm, byte_t* plain, int line_accesses)
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < pgm->nb_lines; ++i) {
+        const command_t* command = &pgm->listing[i];
+        phy_addr_t paddr;
+        int err = page_walk(hrchy->mem_space, &command->vaddr, &paddr);
+        uint32_t phy_addr = ((uint32_t) paddr.phy_page_num << PAGE_OFFSET) | paddr.page_offset;
+
+        if (err == ERR_NONE && line_accesses) {
+            int mismatch = 0;
+            err = line_access(hrchy, command, &paddr, plain, &mismatch);
+            if (mismatch) {
+                if (mismatches == 0) {
+                    fprintf(stderr, "command %zu: wrong line-sized read at 0x%08" PRIx32 "\n", i + 1, phy_addr);
+                }
+                ++mismatches;
+            }
+        } else if (err == ERR_NONE && command->order == WRITE) {
+            memcpy(plain + phy_addr, &command->write_data, command->data_size);
+            err = cache_hrchy_access(hrchy, command);
+        } else if (err == ERR_NONE) {
+            uint64_t data = 0;
+            void* l1_cache = command->type == INSTRUCTION ? hrchy->l1_icache : hrchy->l1_dcache;
+            err = cache_read_bytes(hrchy->mem_space, &paddr, command->type, l1_cache, &hrchy->l1_config,
+                                   hrchy->l2_cache, &hrchy->l2_config, &data, command->data_size,
+                                   hrchy->replace);
+            uint64_t expected = 0;
+            memcpy(&expected, plain + phy_addr, command->data_size);
+            if (err == ERR_NONE && data != expected) {
+                if (mismatches == 0) {
+                    fprintf(stderr, "command %zu: read 0x%" PRIx64 " at 0x%08" PRIx32 ", expected 0x%" PRIx64 "\n",
+                            i + 1, data, phy_addr, expected);
+                }
+                ++mismatches;
+            }
+        }
+        if (err != ERR_NONE) {
+            fprintf(stderr, "command %zu: %s\n", i + 1, ERR_MESSAGES[err - ERR_NONE]);
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+// ======================================================================
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        error(argv[0], "please provide the memory dump and command files.");
+        return 1;
+    }
+
+    cache_config_t l1_config, l2_config, l3_config;
+    if (cache_config_init(&l1_config, 8, 2, 16, sizeof(word_t)) != ERR_NONE
+        || cache_config_init(&l2_config, 32, 4, 16, sizeof(word_t)) != ERR_NONE) {
+        error(argv[0], "invalid default geometry.");
+        return 1;
+    }
+    int with_l3 = 0;
+    uint8_t sector_size = 0;
+    int write_back = 0;
+    int line_accesses = 0;
+    cache_inclusion_t inclusion = CACHE_EXCLUSIVE;
+    cache_inclusion_t l3_inclusion = CACHE_EXCLUSIVE;
+    cache_layout_t layout = CACHE_LAYOUT_AOS;
+    for (int i = 3; i < argc; ++i) {
+        if (!strcmp(argv[i], "--write-back")) {
+            write_back = 1;
+            continue;
+        }
+        if (!strcmp(argv[i], "--line-accesses")) {
+            line_accesses = 1;
+            continue;
+        }
+        if (++i >= argc) {
+            error(argv[0], "missing option value.");
+            return 1;
+        }
+        int err = ERR_NONE;
+        if (!strcmp(argv[i - 1], "--l1")) {
+            err = parse_geometry(argv[i], &l1_config);
+        } else if (!strcmp(argv[i - 1], "--l2")) {
+            err = parse_geometry(argv[i], &l2_config);
+        } else if (!strcmp(argv[i - 1], "--l3")) {
+            err = parse_geometry(argv[i], &l3_config);
+            with_l3 = 1;
+        } else if (!strcmp(argv[i - 1], "--sector")) {
+            unsigned int parsed = 0;
+            char trailing;
+            if (sscanf(argv[i], "%u%c", &parsed, &trailing) != 1 || parsed == 0 || parsed > UINT8_MAX) {
+                err = ERR_BAD_PARAMETER;
+            }
+            sector_size = (uint8_t) parsed;
+        } else if (!strcmp(argv[i - 1], "--inclusion")) {
+            err = parse_inclusion(argv[i], &inclusion);
+        } else if (!strcmp(argv[i - 1], "--l3-inclusion")) {
+            err = parse_inclusion(argv[i], &l3_inclusion);
+        } else if (!strcmp(argv[i - 1], "--layout") && (!strcmp(argv[i], "aos") || !strcmp(argv[i], "soa"))) {
+            layout = strcmp(argv[i], "soa") ? CACHE_LAYOUT_AOS : CACHE_LAYOUT_SOA;
+        } else {
+            err = ERR_BAD_PARAMETER;
+        }
+        if (err != ERR_NONE) {
+            error(argv[0], "invalid option.");
+            return 1;
+        }
+    }
+
+    if (set_options(&l1_config, sector_size, write_back, CACHE_EXCLUSIVE, layout) != ERR_NONE
+        || set_options(&l2_config, sector_size, write_back, inclusion, layout) != ERR_NONE
+        || (with_l3 && set_options(&l3_config, sector_size, write_back, l3_inclusion, layout) != ERR_NONE)) {
+        error(argv[0], "invalid configuration.");
+        return 1;
+    }
+
+    void* mem_space = NULL;
+    size_t mem_size = 0;
+    program_t pgm;
+    if (mem_init_from_dumpfile(argv[1], &mem_space, &mem_size) != ERR_NONE) {
+        error(argv[0], "cannot read the memory dump.");
+        return 1;
+    }
+    if (program_read(argv[2], &pgm) != ERR_NONE) {
+        error(argv[0], "cannot read the commands.");
+        free(mem_space);
+        return 1;
+    }
+    byte_t* plain = malloc(mem_size);
+    if (plain == NULL) {
+        error(argv[0], "out of memory.");
+        program_free(&pgm);
+        free(mem_space);
+        return 1;
+    }
+    memcpy(plain, mem_space, mem_size);
+
+    cache_hrchy_t hrchy;
+    int err = cache_hrchy_init(&hrchy, mem_space, &l1_config, &l2_config, LRU);
+    if (err == ERR_NONE && with_l3) {
+        err = cache_hrchy_add_l3(&hrchy, &l3_config, LRU);
+        if (err != ERR_NONE) cache_hrchy_free(&hrchy);
+    }
+    if (err != ERR_NONE) {
+        error(argv[0], "cannot create the caches.");
+        free(plain);
+        program_free(&pgm);
+        free(mem_space);
+        return 1;
+    }
+
+    size_t mismatches = run_checked(&hrchy, &pgm, plain, line_accesses);
+    err = cache_hrchy_clean(&hrchy);
+    int same = err == ERR_NONE && !memcmp(mem_space, plain, mem_size);
+    printf("reads: %s, memory: %s\n", mismatches ? "FAIL" : "OK", same ? "OK" : "FAIL");
+
+    cache_hrchy_free(&hrchy);
+    free(plain);
+    program_free(&pgm);
+    free(mem_space);
+    return mismatches || !same;
+}
@@ -0,0 +1,96 @@
+#!/bin/bash
+
+## Data tests of the cache hierarchy: write-back, inclusion policies, L3,
+## sectors, line sizes, and accesses of all sizes across lines and sectors
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function: runs the commands of $2 on the memory dump $1 through the
+# caches configured by the other arguments, and checks every read and the
+# memory once the caches are cleaned against a plain memory
+check_data() {
+
+    checkX "Test cache data" test-cache_data
+
+    ref='tests/files'
+    memfile="${ref}/$1"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$2"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    shift 2
+    mytmp="$(new_tmp_file)"
+    # gets stdout in case of success, stdout and stderr in case of error
+    ACTUAL_OUTPUT="$(test-cache_data "$memfile" "$cmdfile" "$@" 2>"$mytmp" || cat "$mytmp")"
+
+    diff -w <(echo "$ACTUAL_OUTPUT") <(echo "reads: OK, memory: OK") >/dev/null \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            echo -e "Actual:\n$ACTUAL_OUTPUT"; \
+            exit 1)
+}
+
+# ======================================================================
+printf "Test %1d (write-through): " $((++test))
+check_data memory-dump-01.mem commands03.txt
+
+printf "Test %1d (write-back): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back
+
+printf "Test %1d (inclusive L2): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --inclusion inclusive
+
+printf "Test %1d (NINE L2): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --inclusion nine
+
+printf "Test %1d (exclusive L3): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --l3 128:8:16 --l3-inclusion exclusive
+
+printf "Test %1d (inclusive L3): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --inclusion inclusive \
+           --l3 128:8:16 --l3-inclusion inclusive
+
+printf "Test %1d (NINE L3): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --inclusion nine --l3 128:8:16 --l3-inclusion nine
+
+printf "Test %1d (sectors): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --sector 8
+
+printf "Test %1d (sectors, inclusive L2): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --sector 8 --inclusion inclusive
+
+printf "Test %1d (sectors, inclusive L3): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --sector 8 --l3 128:8:16 --l3-inclusion inclusive
+
+printf "Test %1d (sectors, NINE L2 and L3): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --sector 8 --inclusion nine \
+           --l3 128:8:16 --l3-inclusion nine
+
+printf "Test %1d (32-byte lines): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --l1 4:2:32 --l2 16:4:32 --inclusion inclusive \
+           --l3 64:8:32 --l3-inclusion nine
+
+printf "Test %1d (64-byte lines, sectors): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --l1 2:2:64 --l2 8:4:64 --sector 16 \
+           --inclusion inclusive --l3 32:8:64 --l3-inclusion inclusive
+
+printf "Test %1d (SoA layout): " $((++test))
+check_data memory-dump-01.mem commands03.txt --write-back --sector 8 --inclusion inclusive --layout soa
+
+printf "Test %1d (line-sized accesses, sectors): " $((++test))
+check_data memory-dump-01.mem commands03.txt --line-accesses --sector 8
+
+printf "Test %1d (line-sized accesses, sectors, write-back): " $((++test))
+check_data memory-dump-01.mem commands03.txt --line-accesses --write-back --sector 8 --inclusion inclusive \
+           --l3 128:8:16 --l3-inclusion inclusive
+
+printf "Test %1d (line-sized accesses, 64-byte lines, sectors): " $((++test))
+check_data memory-dump-01.mem commands03.txt --line-accesses --write-back --l1 2:2:64 --l2 8:4:64 --sector 16 \
+           --inclusion nine --l3 32:8:64 --l3-inclusion nine
+
+# ======================================================================
+echo "SUCCESS"
@@ -0,0 +1,285 @@
+#!/bin/bash
+
+## Tests of the simulation features of test-cache: reference outputs, and
+## results that must agree with the ones of another way to compute them
+
+source $(dirname ${BASH_SOURCE[0]})/test_env.sh
+
+test=0
+
+# ======================================================================
+# tool function: runs test-cache on memory-dump-01.mem and the command file
+# $1 with the options that follow; gets stdout in case of success, stdout
+# and stderr in case of error
+run_cache() {
+
+    checkX "Test Cache hierarchy" test-cache
+
+    ref='tests/files'
+    memfile="${ref}/memory-dump-01.mem"
+    [ -f "$memfile" ] || error "Expected mem dump file \"$memfile\" not found."
+
+    cmdfile="${ref}/$1"
+    [ -f "$cmdfile" ] || error "Expected command file \"$cmdfile\" not found."
+
+    shift
+    mytmp="$(new_tmp_file)"
+    test-cache dump "$memfile" "$cmdfile" "$@" 2>"$mytmp" || cat "$mytmp"
+}
+
+# ======================================================================
+# tool function: compares the actual output $1 with the expected one $2
+check_same() {
+    diff -w <(echo "$1") <(echo "$2") >/dev/null \
+        && echo "PASS" \
+        || (echo "FAIL"; \
+            diff -w <(echo "$1") <(echo "$2") | head -20; \
+            exit 1)
+}
+
+# ======================================================================
+# tool function: compares the output of run_cache on the arguments that
+# follow $1 with the reference output file $1
+check_output_with_file() {
+
+    refoutput="tests/files/$1"
+    [ -f "$refoutput" ] || error "Expected output file \"$refoutput\" not found."
+
+    shift
+    check_same "$(run_cache "$@")" "$(cat "$refoutput")"
+}
+
+# ======================================================================
+# set sampling
+
+SMALL="--l1 16:2:16 --l2 64:4:16"
+
+printf "Test %1d (sampling 1 in 4 sets): " $((++test))
+check_output_with_file output/sampling-04-out.txt commands04.txt --tag-only --stats --sample 4 $SMALL --l3 256:8:16
+
+# sampling all the sets extrapolates the statistics of a run without sampling
+printf "Test %1d (sampling 1 in 1 set): " $((++test))
+check_same "$(run_cache commands04.txt --tag-only --stats --sample 1 $SMALL --l3 256:8:16 \
+              | sed -n 's/^\(L[0-9A-Z_]* *\): estimated accesses: \([0-9]*\), misses: \([0-9]*\),.*/\1 \2 \3/p')" \
+           "$(run_cache commands04.txt --tag-only --stats $SMALL --l3 256:8:16 \
+              | sed -n 's/^\(L[0-9A-Z_]* *\): accesses: \([0-9]*\), hits: [0-9]*, misses: \([0-9]*\) .*/\1 \2 \3/p')"
+
+# each L2 set must only hold lines of one L1 set
+printf "Test %1d (sampling with fewer L2 sets than L1 sets): " $((++test))
+check_same "$(run_cache commands04.txt --tag-only --stats --sample 4 --l1 1024:2:16 --l2 256:4:16 | head -1)" \
+           "ERROR: sampling ratio larger than the number of L1 sets, or fewer L2 (L3) sets than L1 sets."
+
+# ======================================================================
+# sharding: the shards must end up exactly as a serial run
+
+# tool function: compares the output of run_cache on the arguments that
+# follow $1 with and without --shards $1
+check_shards() {
+    local nb_shards="$1"
+    shift
+    check_same "$(run_cache "$@" --shards "$nb_shards")" "$(run_cache "$@")"
+}
+
+printf "Test %1d (2 shards, statistics): " $((++test))
+check_shards 2 commands04.txt --stats $SMALL
+
+printf "Test %1d (4 shards, write-back, inclusive L2 and L3): " $((++test))
+check_shards 4 commands03.txt --stats --write-back --inclusion inclusive $SMALL --l3 256:8:16 --l3-inclusion inclusive
+
+printf "Test %1d (16 shards, final dump, sectors): " $((++test))
+check_shards 16 commands03.txt --final-dump --write-back --sector 8 --inclusion nine $SMALL --l3 256:8:16 --l3-inclusion nine
+
+printf "Test %1d (8 shards, tag-only, PLRU and SRRIP): " $((++test))
+check_shards 8 commands04.txt --final-dump --tag-only --replace plru-tree --l1 16:4:16 --l2 64:8:16 \
+             --l3 256:8:16 --l3-replace srrip
+
+# the cache-wide state of DRRIP would differ from shard to shard
+printf "Test %1d (shards refuse DRRIP): " $((++test))
+check_same "$(run_cache commands04.txt --stats --replace drrip $SMALL --shards 4 | head -1 | cut -c1-6)" "ERROR:"
+
+# ======================================================================
+# multicore MESI coherence
+
+printf "Test %1d (two cores, round robin): " $((++test))
+check_output_with_file output/mesi-04-out.txt commands04.txt --stats --trace tests/files/commands03.txt --write-back \
+                       $SMALL --l3 256:8:16
+
+# every L1 access of a core is either served locally or goes on the bus,
+# whatever the interleaving of the host threads
+printf "Test %1d (three cores, host threads): " $((++test))
+check_same "$(run_cache commands04.txt --stats --trace tests/files/commands03.txt --trace tests/files/commands04.txt \
+              --threads --write-back $SMALL \
+              | awk -F '[:,] *' '/^CORE/ { core = $0; l1 = 0 }
+                                 /^L1_/ { l1 += $3 }
+                                 /^MESI/ { print core, ($3 + $5 + $7 == l1) ? "ok" : "mismatch" }')" \
+           "$(printf "CORE %d ok\n" 0 1 2)"
+
+# ======================================================================
+# stack distance analysis
+
+printf "Test %1d (miss-ratio curves): " $((++test))
+check_output_with_file output/stack-dist-05-out.txt commands05.txt --stack-distance
+
+# each miss ratio must be the one of an LRU L1 data cache of that geometry
+# (the L2 is large enough to never back-invalidate it)
+STACK_DIST="$(run_cache commands05.txt --stack-distance)"
+for geometry in 1:1 4:2 16:2 8:4 32:4 64:1 4:16 2:32 1:64 16:8; do
+    sets=${geometry%:*}
+    ways=${geometry#*:}
+    printf "Test %1d (stack distance of %d sets of %d ways): " $((++test)) $sets $ways
+    check_same "$(echo "$STACK_DIST" | awk -v sets=$sets -v ways=$ways '$1 == sets && $2 == ways { print $4 }')" \
+               "$(run_cache commands05.txt --stats --tag-only --l1 $sets:$ways:16 --l2 256:16:16 \
+                  | sed -n 's/^L1_DCACHE.*misses: [0-9]* (\([0-9.]*%\)).*/\1/p')"
+done
+
+# ======================================================================
+# checkpoints: saving and restoring must not change the results
+
+# tool function: checks that a run of the command file $3 with the output
+# option $2 (--stats or --final-dump) and the options that follow is the
+# same when it saves a checkpoint after $1 commands, and when it restores
+# that checkpoint without the options of the caches
+check_checkpoint() {
+    local at="$1"
+    local output="$2"
+    local cmdfile="$3"
+    shift 3
+    local checkpoint="$(new_tmp_file)"
+    local expected="$(run_cache "$cmdfile" "$output" "$@")"
+    printf "saving: "
+    check_same "$(run_cache "$cmdfile" "$output" "$@" --checkpoint "$checkpoint" --checkpoint-at "$at")" "$expected"
+    printf "         restoring: "
+    check_same "$(run_cache "$cmdfile" "$output" --restore "$checkpoint")" "$expected"
+}
+
+printf "Test %1d (checkpoint of statistics, prefetcher and L3): " $((++test))
+check_checkpoint 1000 --stats commands04.txt --write-back --prefetch stride $SMALL --l3 256:8:16
+
+printf "Test %1d (checkpoint of data and memory): " $((++test))
+check_checkpoint 50 --final-dump commands03.txt --write-back --inclusion nine $SMALL
+
+# ======================================================================
+# heat maps
+
+printf "Test %1d (pages and sets with the most misses): " $((++test))
+check_output_with_file output/heat-map-04-out.txt commands04.txt --stats --heat-map 4 $SMALL --l3 256:8:16
+
+# the hits and misses of all the pages, as of all the sets, of a cache
+# add up to its statistics
+HEAT_CSV="$(new_tmp_file)"
+HEAT_STATS="$(run_cache commands04.txt --stats --heat-csv "$HEAT_CSV" $SMALL --l3 256:8:16 \
+              | sed -n 's/^L\([0-9]\)_\?\([ID]\?\)[A-Z_]* *: accesses: [0-9]*, hits: \([0-9]*\), misses: \([0-9]*\) .*/L\1\2 \3 \4/p' \
+              | sort)"
+for kind in page set; do
+    printf "Test %1d (%s heat map sums): " $((++test)) $kind
+    check_same "$(awk -F , -v kind=$kind '$1 == kind { hits[$2] += $4; misses[$2] += $5 }
+                                          END { for (level in hits) print level, hits[level], misses[level] }' \
+                  "$HEAT_CSV" | sort)" \
+               "$HEAT_STATS"
+done
+
+# ======================================================================
+# classification of the misses (3C)
+
+CLASSIFY_L1="--l1 4:1:16 --l2 64:4:16 --l3 256:8:16"
+
+printf "Test %1d (compulsory, capacity and conflict misses): " $((++test))
+check_output_with_file output/classify-04-out.txt commands04.txt --stats --classify $CLASSIFY_L1
+
+# the three kinds of misses of a cache add up to its misses
+printf "Test %1d (3C sums): " $((++test))
+CLASSIFY="$(run_cache commands04.txt --stats --classify $CLASSIFY_L1)"
+check_same "$(echo "$CLASSIFY" \
+              | sed -n 's/^L\([0-9]\)\([ID]\?\)_3C *: compulsory: \([0-9]*\) .*capacity: \([0-9]*\) .*conflict: \([0-9]*\) .*/L\1\2 \3 \4 \5/p' \
+              | awk '{ print $1, $2 + $3 + $4 }' | sort)" \
+           "$(echo "$CLASSIFY" \
+              | sed -n 's/^L\([0-9]\)_\?\([ID]\?\)[A-Z_]* *: accesses: [0-9]*, hits: [0-9]*, misses: \([0-9]*\) .*/L\1\2 \3/p' \
+              | sort)"
+
+# a fully associative LRU cache has no conflict misses
+printf "Test %1d (no conflict misses in a fully associative L1): " $((++test))
+check_same "$(run_cache commands04.txt --stats --classify --l1 1:32:16 --l2 1:64:16 | grep "^L1D_3C" | sed 's/.*conflict: //')" \
+           "0 (0.00%)"
+
+# ======================================================================
+# data prefetchers
+
+printf "Test %1d (next-line prefetcher): " $((++test))
+check_output_with_file output/prefetch-next-line-04-out.txt commands04.txt --stats --write-back --prefetch next-line $SMALL
+
+printf "Test %1d (stride prefetcher, degree 2, distance 4): " $((++test))
+check_output_with_file output/prefetch-stride-04-out.txt commands04.txt --stats --prefetch stride \
+                       --prefetch-degree 2 --prefetch-distance 4 $SMALL
+
+printf "Test %1d (stream prefetcher into L2): " $((++test))
+check_output_with_file output/prefetch-stream-04-out.txt commands04.txt --stats --prefetch stream --prefetch-to l2 \
+                       $SMALL --l3 256:8:16
+
+# ======================================================================
+# configuration sweeps
+
+printf "Test %1d (table of a sweep): " $((++test))
+check_output_with_file output/sweep-04-out.txt commands04.txt --sweep tests/files/sweep04.txt --jobs 3
+
+printf "Test %1d (sweep on one thread): " $((++test))
+check_same "$(run_cache commands04.txt --sweep tests/files/sweep04.txt --jobs 1)" \
+           "$(cat tests/files/output/sweep-04-out.txt)"
+
+# each row of the table must report the miss ratios of a tag-only run of
+# its configuration
+SWEEP="$(run_cache commands04.txt --sweep tests/files/sweep04.txt --jobs 3)"
+row=0
+while read -r sweep_line; do
+    printf "Test %1d (sweep row %d): " $((++test)) $row
+    check_same "$(echo "$SWEEP" | awk -v row=$row '$1 == row { print $10, $11, $12, $13 }')" \
+               "$(run_cache commands04.txt --stats --tag-only $sweep_line \
+                  | sed -n 's/^L[0-9A-Z_]* *: accesses: .* misses: [0-9]* (\([0-9.]*%\)).*/\1/p' \
+                  | awk '{ ratios = ratios $1 " " } END { print ratios (NR == 3 ? "-" : "") }')"
+    row=$((row + 1))
+done < tests/files/sweep04.txt
+
+# ======================================================================
+# shared L3 cache
+
+printf "Test %1d (L3 statistics): " $((++test))
+check_output_with_file output/l3-04-out.txt commands04.txt --stats --write-back --inclusion nine \
+                       --l1 16:2:16 --l2 16:2:16 --l3 128:4:16 --l3-inclusion inclusive --l3-replace srrip
+
+# whatever the inclusion policies, the L3 is looked up on each L2 miss
+for inclusion in exclusive inclusive nine; do
+    for l3_inclusion in exclusive inclusive nine; do
+        printf "Test %1d (L3 accesses, %s L2 and %s L3): " $((++test)) $inclusion $l3_inclusion
+        L3_STATS="$(run_cache commands04.txt --stats --write-back --inclusion $inclusion $SMALL \
+                    --l3 256:8:16 --l3-inclusion $l3_inclusion)"
+        check_same "$(echo "$L3_STATS" | sed -n 's/^L3_CACHE *: accesses: \([0-9]*\),.*/\1/p')" \
+                   "$(echo "$L3_STATS" | sed -n 's/^L2_CACHE *: accesses: [0-9]*, hits: [0-9]*, misses: \([0-9]*\) .*/\1/p')"
+    done
+done
+
+# ======================================================================
+# warm-up and regions of interest (commands06.txt: 400 and 584 commands)
+
+printf "Test %1d (warm-up in regions of interest): " $((++test))
+check_output_with_file output/roi-06-out.txt commands06.txt --stats --write-back $SMALL --l3 256:8:16 --warmup 100
+
+printf "Test %1d (warm-up in fast-forwarded regions of interest): " $((++test))
+check_output_with_file output/roi-fast-forward-06-out.txt commands06.txt --stats --write-back $SMALL --l3 256:8:16 \
+                       --fast-forward --warmup 100
+
+# only the commands of the regions of interest, after their warm-ups, count
+for warmup in 0 100 399; do
+    for fast_forward in "" --fast-forward; do
+        printf "Test %1d (accesses after a warm-up of %d%s): " $((++test)) $warmup "${fast_forward:+, fast-forwarded}"
+        check_same "$(run_cache commands06.txt --stats $SMALL --warmup $warmup $fast_forward \
+                      | sed -n 's/^L1_[ID]CACHE: accesses: \([0-9]*\),.*/\1/p' | awk '{ sum += $1 } END { print sum }')" \
+                   "$((400 + 584 - 2 * warmup))"
+    done
+done
+
+# without regions of interest, the whole program is one
+printf "Test %1d (fast-forward without regions of interest): " $((++test))
+check_same "$(run_cache commands04.txt --stats --write-back $SMALL --fast-forward)" \
+           "$(run_cache commands04.txt --stats --write-back $SMALL)"
+
+# ======================================================================
+echo "SUCCESS"
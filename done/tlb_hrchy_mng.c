@@ -163,8 +163,8 @@ int tlb_search( const void * mem_space,
 			M_EXIT_IF_ERR_NOMSG(tlb_insert(vpn % L1_ITLB_LINES, &new_l1i_entry, l1_itlb, L1_ITLB));
 		} else {
 			l1_dtlb_entry_t new_l1d_entry;
-			M_EXIT_IF_ERR_NOMSG(tlb_entry_init(vaddr, paddr, &new_l1d_entry, L1_ITLB));
-			M_EXIT_IF_ERR_NOMSG(tlb_insert(vpn % L1_ITLB_LINES, &new_l1d_entry, l1_itlb, L1_ITLB));
+			M_EXIT_IF_ERR_NOMSG(tlb_entry_init(vaddr, paddr, &new_l1d_entry, L1_DTLB));
+			M_EXIT_IF_ERR_NOMSG(tlb_insert(vpn % L1_DTLB_LINES, &new_l1d_entry, l1_dtlb, L1_DTLB));
 		}
 
 		return ERR_NONE;
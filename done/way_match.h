@@ -0,0 +1,115 @@
+#pragma once
+
+/**
+ * @file way_match.h
+ * @brief vectorized tag matching over the ways of a set (SoA tag blocks).
+ *
+ * The kernel is chosen at build time: AVX2 when compiled with -mavx2 (8
+ * ways per step), SSE2 otherwise on x86 (4 ways per step). Without either,
+ * or when CACHE_NO_SIMD is defined, WAY_MATCH_SIMD is 0 and the scalar
+ * loops of cache_kernels.h do all the work. The vector kernels only check
+ * whole steps of ways: the scalar loops finish the remaining ones.
+ *
+ * Only to be included by cache_kernels.h (and bench-cache.c).
+ *
+ * @date 2019
+ */
+
+#include <stdint.h>
+
+#if !defined(CACHE_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define WAY_MATCH_SIMD   1
+#define WAY_MATCH_KERNEL "avx2"
+#elif !defined(CACHE_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define WAY_MATCH_SIMD   1
+#define WAY_MATCH_KERNEL "sse2"
+#else
+#define WAY_MATCH_SIMD   0
+#define WAY_MATCH_KERNEL "scalar"
+#endif
+
+#if WAY_MATCH_SIMD
+
+#include <string.h> // for memcpy()
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit of a non-zero movemask
+static inline int way_match_lowest(unsigned int mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+#else
+    int index = 0;
+    for (; !(mask & 1u); mask >>= 1) ++index;
+    return index;
+#endif
+}
+
+//=========================================================================
+/**
+ * @brief First valid way holding tag, among the whole vector steps of ways.
+ * @param tags the tags of the set
+ * @param valids the valid bytes of the set
+ * @param ways the number of ways
+ * @param tag the tag to look for
+ * @param checked set to the number of ways checked, when none matches
+ * @return the way index, -1 if none of the checked ways matches
+ */
+static inline int way_match(const uint32_t* tags, const uint8_t* valids, uint8_t ways, uint32_t tag,
+                            uint8_t* checked) {
+    uint8_t i = 0;
+#if defined(__AVX2__)
+    const __m256i key = _mm256_set1_epi32((int) tag);
+    for (; i + 8 <= ways; i += 8) {
+        __m256i valid = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*) (valids + i)));
+        __m256i hit = _mm256_andnot_si256(_mm256_cmpeq_epi32(valid, _mm256_setzero_si256()),
+                      _mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i*) (tags + i)), key));
+        int mask = _mm256_movemask_ps(_mm256_castsi256_ps(hit));
+        if (mask) return i + way_match_lowest((unsigned int) mask);
+    }
+#else
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i key = _mm_set1_epi32((int) tag);
+    for (; i + 4 <= ways; i += 4) {
+        uint32_t v4;
+        memcpy(&v4, valids + i, sizeof(v4));
+        __m128i valid = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128((int) v4), zero), zero);
+        __m128i hit = _mm_andnot_si128(_mm_cmpeq_epi32(valid, zero),
+                      _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*) (tags + i)), key));
+        int mask = _mm_movemask_ps(_mm_castsi128_ps(hit));
+        if (mask) return i + way_match_lowest((unsigned int) mask);
+    }
+#endif
+    *checked = i;
+    return -1;
+}
+
+//=========================================================================
+/**
+ * @brief First invalid way, among the whole steps of 8 ways.
+ * @param valids the valid bytes of the set
+ * @param ways the number of ways
+ * @param checked set to the number of ways checked, when all are valid
+ * @return the way index, -1 if all the checked ways are valid
+ */
+static inline int way_empty(const uint8_t* valids, uint8_t ways, uint8_t* checked) {
+    uint8_t i = 0;
+    const __m128i zero = _mm_setzero_si128();
+    for (; i + 8 <= ways; i += 8) {
+        __m128i valid = _mm_loadl_epi64((const __m128i*) (valids + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(valid, zero)) & 0xFF;
+        if (mask) return i + way_match_lowest((unsigned int) mask);
+    }
+    *checked = i;
+    return -1;
+}
+
+#endif // WAY_MATCH_SIMD